@@ -0,0 +1,491 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Cache building without a display.
+ *
+ * geeqie --cache-build [options] <folder>...
+ *
+ * gtk is never initialized and no window is created, only the image loaders,
+ * the thumbnail writers and the similarity database are used.
+ * Progress is written to stdout, one tab separated record per line:
+ *
+ *   start	<files>
+ *   file	<n>	<files>	done|skipped|failed	<path>
+ *   end	<done>	<skipped>	<failed>	<seconds>
+ */
+
+#include "main.h"
+#include "cache-build.h"
+
+#include "cache.h"
+#include "cache-db.h"
+#include "cache-loader.h"
+#include "cache_maint.h"
+#include "filedata.h"
+#include "filefilter.h"
+#include "thumb.h"
+#include "thumb_standard.h"
+#include "ui_fileops.h"
+#include "ui_tabcomp.h"
+
+
+typedef struct _CacheBuild CacheBuild;
+struct _CacheBuild
+{
+	GMainLoop *loop;
+
+	GList *list;		/* FileData, waiting */
+	GList *list_job;	/* CacheBuildJob, in flight */
+
+	gboolean thumbnails;
+	CacheDataType sim_mask;
+	gboolean local;
+	gboolean recurse;
+	gint threads;
+	guint idle_id;		/* starts the waiting files */
+
+	gint count_total;
+	gint count_started;
+	gint count_done;
+	gint count_skipped;
+	gint count_failed;
+	gint64 time_start;
+};
+
+typedef struct _CacheBuildJob CacheBuildJob;
+struct _CacheBuildJob
+{
+	CacheBuild *cb;
+	FileData *fd;
+	gint index;
+
+	ThumbLoader *tl;
+	CacheLoader *cl;
+
+	gboolean thumb_todo;
+	gboolean sim_todo;
+	gboolean failed;
+};
+
+
+static void cache_build_job_run(CacheBuildJob *job);
+static gboolean cache_build_start_cb(gpointer data);
+
+
+/*
+ *-----------------------------------------------------------------------------
+ * progress output
+ *-----------------------------------------------------------------------------
+ */
+
+static void cache_build_report_file(CacheBuild *cb, gint index, const gchar *status, FileData *fd)
+{
+	printf_term(FALSE, "file\t%d\t%d\t%s\t%s\n", index, cb->count_total, status, fd->path);
+	fflush(stdout);
+}
+
+static void cache_build_report_end(CacheBuild *cb)
+{
+	gdouble seconds;
+
+	seconds = (gdouble)(g_get_monotonic_time() - cb->time_start) / G_USEC_PER_SEC;
+
+	printf_term(FALSE, "end\t%d\t%d\t%d\t%.1f\n", cb->count_done, cb->count_skipped, cb->count_failed, seconds);
+	fflush(stdout);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * per file work
+ *-----------------------------------------------------------------------------
+ */
+
+static gboolean cache_build_sim_is_current(CacheBuild *cb, FileData *fd)
+{
+	CacheData *cd;
+	gboolean current;
+
+	if (cb->sim_mask == CACHE_LOADER_NONE) return TRUE;
+
+	cd = cache_sim_db_load(fd->path);
+	if (!cd) return FALSE;
+
+	current = (!(cb->sim_mask & CACHE_LOADER_SIMILARITY) || cd->similarity) &&
+		  (!(cb->sim_mask & CACHE_LOADER_DIMENSIONS) || cd->dimensions) &&
+		  (!(cb->sim_mask & CACHE_LOADER_DATE) || cd->have_date) &&
+		  (!(cb->sim_mask & CACHE_LOADER_MD5SUM) || cd->have_md5sum);
+
+	cache_sim_data_free(cd);
+
+	return current;
+}
+
+static void cache_build_job_finish(CacheBuildJob *job)
+{
+	CacheBuild *cb = job->cb;
+
+	if (job->failed)
+		{
+		cb->count_failed++;
+		cache_build_report_file(cb, job->index, "failed", job->fd);
+		}
+	else
+		{
+		cb->count_done++;
+		cache_build_report_file(cb, job->index, "done", job->fd);
+		}
+
+	cb->list_job = g_list_remove(cb->list_job, job);
+	file_data_unref(job->fd);
+	g_free(job);
+
+	/* a job may finish inside cache_build_next(), the next files are
+	 * started from the main loop so that failing files do not nest
+	 */
+	if (!cb->idle_id) cb->idle_id = g_idle_add(cache_build_start_cb, cb);
+}
+
+static void cache_build_thumb_done_cb(ThumbLoader *tl, gpointer data)
+{
+	CacheBuildJob *job = data;
+
+	thumb_loader_free(job->tl);
+	job->tl = NULL;
+
+	cache_build_job_run(job);
+}
+
+static void cache_build_thumb_error_cb(ThumbLoader *tl, gpointer data)
+{
+	CacheBuildJob *job = data;
+
+	job->failed = TRUE;
+	cache_build_thumb_done_cb(tl, data);
+}
+
+static void cache_build_sim_done_cb(CacheLoader *cl, gint error, gpointer data)
+{
+	CacheBuildJob *job = data;
+
+	cache_loader_free(job->cl);
+	job->cl = NULL;
+
+	if (error) job->failed = TRUE;
+	cache_build_job_run(job);
+}
+
+/* runs the next step of the job, the thumbnail first and then the similarity data */
+static void cache_build_job_run(CacheBuildJob *job)
+{
+	CacheBuild *cb = job->cb;
+
+	if (job->thumb_todo)
+		{
+		job->thumb_todo = FALSE;
+
+		job->tl = thumb_loader_new(options->thumbnails.max_width, options->thumbnails.max_height);
+		thumb_loader_set_callbacks(job->tl,
+					   cache_build_thumb_done_cb,
+					   cache_build_thumb_error_cb,
+					   NULL, job);
+		thumb_loader_set_cache(job->tl, TRUE, cb->local, TRUE);
+
+		if (thumb_loader_start(job->tl, job->fd)) return;
+
+		thumb_loader_free(job->tl);
+		job->tl = NULL;
+		job->failed = TRUE;
+		}
+
+	if (job->sim_todo)
+		{
+		job->sim_todo = FALSE;
+
+		job->cl = cache_loader_new(job->fd, cb->sim_mask, cache_build_sim_done_cb, job);
+		if (job->cl) return;
+
+		job->failed = TRUE;
+		}
+
+	cache_build_job_finish(job);
+}
+
+/* starts the next file, returns TRUE if another one can be started now */
+static gboolean cache_build_next(CacheBuild *cb)
+{
+	CacheBuildJob *job;
+	FileData *fd;
+	gboolean thumb_todo;
+	gboolean sim_todo;
+
+	if (!cb->list)
+		{
+		if (!cb->list_job) g_main_loop_quit(cb->loop);
+		return FALSE;
+		}
+
+	if ((gint)g_list_length(cb->list_job) >= cb->threads) return FALSE;
+
+	fd = cb->list->data;
+	cb->list = g_list_remove(cb->list, fd);
+	cb->count_started++;
+
+	thumb_todo = cb->thumbnails && !cache_manager_render_is_current(fd, cb->local);
+	sim_todo = !cache_build_sim_is_current(cb, fd);
+
+	if (!thumb_todo && !sim_todo)
+		{
+		cb->count_skipped++;
+		cache_build_report_file(cb, cb->count_started, "skipped", fd);
+		file_data_unref(fd);
+		return TRUE;
+		}
+
+	job = g_new0(CacheBuildJob, 1);
+	job->cb = cb;
+	job->fd = fd;
+	job->index = cb->count_started;
+	job->thumb_todo = thumb_todo;
+	job->sim_todo = sim_todo;
+
+	cb->list_job = g_list_prepend(cb->list_job, job);
+	cache_build_job_run(job);
+
+	return TRUE;
+}
+
+static gboolean cache_build_start_cb(gpointer data)
+{
+	CacheBuild *cb = data;
+
+	cb->idle_id = 0;
+	while (cache_build_next(cb));
+
+	return FALSE;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * setup
+ *-----------------------------------------------------------------------------
+ */
+
+static void cache_build_collect(CacheBuild *cb, FileData *dir_fd)
+{
+	GList *list_f = NULL;
+	GList *list_d = NULL;
+	GList *work;
+
+	filelist_read(dir_fd, &list_f, cb->recurse ? &list_d : NULL);
+
+	list_f = filelist_filter(list_f, FALSE);
+	list_d = filelist_filter(list_d, TRUE);
+
+	list_f = filelist_sort_path(list_f);
+	list_d = filelist_sort_path(list_d);
+
+	cb->list = g_list_concat(cb->list, list_f);
+
+	for (work = list_d; work; work = work->next)
+		{
+		cache_build_collect(cb, work->data);
+		}
+	filelist_free(list_d);
+}
+
+static void cache_build_usage(void)
+{
+	printf_term(FALSE, _("Usage: %s %s [options] <folder>...\n\n"), GQ_APPNAME_LC, CACHE_BUILD_OPTION);
+	print_term(FALSE, _("Builds the caches without a display. When none of --thumbnails,\n"
+			    "--similarity or --metadata is given, all of them are built.\n\n"));
+	print_term(FALSE, _("valid options are:\n"));
+	print_term(FALSE, _("  -R, --recurse                    include subfolders\n"));
+	print_term(FALSE, _("      --thumbnails                 create thumbnails\n"));
+	print_term(FALSE, _("      --similarity                 store image similarity data\n"));
+	print_term(FALSE, _("      --metadata                   store dimensions, date and checksum\n"));
+	print_term(FALSE, _("      --local                      store standard thumbnails local to the images\n"));
+	print_term(FALSE, _("      --threads=<n>                number of files processed at the same time\n"));
+	print_term(FALSE, _("  -h, --help                       show this message\n\n"));
+	print_term(FALSE, _("Exit status is 0 on success, 1 if some files failed, 2 on invalid arguments.\n"));
+}
+
+gint cache_build_main(gint argc, gchar *argv[])
+{
+	CacheBuild *cb;
+	GList *folders = NULL;
+	GList *work;
+	gboolean sim_given = FALSE;
+	gint ret = CACHE_BUILD_EXIT_OK;
+	gint i;
+
+	cb = g_new0(CacheBuild, 1);
+	cb->sim_mask = CACHE_LOADER_NONE;
+
+	for (i = 2; i < argc && ret == CACHE_BUILD_EXIT_OK; i++)
+		{
+		gchar *cmd_line = path_to_utf8(argv[i]);
+
+		if (strcmp(cmd_line, "-R") == 0 ||
+		    strcmp(cmd_line, "--recurse") == 0)
+			{
+			cb->recurse = TRUE;
+			}
+		else if (strcmp(cmd_line, "--thumbnails") == 0)
+			{
+			cb->thumbnails = TRUE;
+			}
+		else if (strcmp(cmd_line, "--similarity") == 0)
+			{
+			cb->sim_mask |= CACHE_LOADER_SIMILARITY;
+			sim_given = TRUE;
+			}
+		else if (strcmp(cmd_line, "--metadata") == 0)
+			{
+			cb->sim_mask |= CACHE_LOADER_DIMENSIONS | CACHE_LOADER_DATE | CACHE_LOADER_MD5SUM;
+			sim_given = TRUE;
+			}
+		else if (strcmp(cmd_line, "--local") == 0)
+			{
+			cb->local = TRUE;
+			}
+		else if (strncmp(cmd_line, "--threads=", 10) == 0)
+			{
+			cb->threads = atoi(cmd_line + 10);
+			if (cb->threads < 1) ret = CACHE_BUILD_EXIT_USAGE;
+			}
+		else if (strncmp(cmd_line, "--debug", 7) == 0 && (cmd_line[7] == '\0' || cmd_line[7] == '='))
+			{
+			/* already handled */
+			}
+		else if (strcmp(cmd_line, "-h") == 0 ||
+			 strcmp(cmd_line, "--help") == 0)
+			{
+			cache_build_usage();
+			g_free(cmd_line);
+			string_list_free(folders);
+			g_free(cb);
+			return CACHE_BUILD_EXIT_OK;
+			}
+		else if (cmd_line[0] != '-')
+			{
+			gchar *path;
+
+			if (g_path_is_absolute(cmd_line))
+				{
+				path = remove_trailing_slash(cmd_line);
+				}
+			else
+				{
+				gchar *base_dir = get_current_dir();
+				gchar *full = g_build_filename(base_dir, cmd_line, NULL);
+
+				path = remove_trailing_slash(full);
+				g_free(full);
+				g_free(base_dir);
+				}
+			parse_out_relatives(path);
+
+			if (isdir(path))
+				{
+				folders = g_list_append(folders, path);
+				}
+			else
+				{
+				printf_term(TRUE, _("The specified folder can not be found: %s\n"), path);
+				g_free(path);
+				ret = CACHE_BUILD_EXIT_USAGE;
+				}
+			}
+		else
+			{
+			printf_term(TRUE, _("invalid option: %s\nUse %s --help for options\n"), cmd_line, CACHE_BUILD_OPTION);
+			ret = CACHE_BUILD_EXIT_USAGE;
+			}
+
+		g_free(cmd_line);
+		}
+
+	if (ret == CACHE_BUILD_EXIT_OK && !folders)
+		{
+		cache_build_usage();
+		ret = CACHE_BUILD_EXIT_USAGE;
+		}
+
+	if (ret != CACHE_BUILD_EXIT_OK)
+		{
+		string_list_free(folders);
+		g_free(cb);
+		return ret;
+		}
+
+	if (!cb->thumbnails && !sim_given)
+		{
+		cb->thumbnails = TRUE;
+		cb->sim_mask = CACHE_LOADER_SIMILARITY | CACHE_LOADER_DIMENSIONS | CACHE_LOADER_DATE | CACHE_LOADER_MD5SUM;
+		}
+
+	options = init_options(NULL);
+	setup_default_options(options);
+
+	recursive_mkdir_if_not_exists(get_thumbnails_cache_dir(), 0755);
+	recursive_mkdir_if_not_exists(get_metadata_cache_dir(), 0755);
+
+	if (!load_global_options(options))
+		{
+		filter_add_defaults();
+		filter_rebuild();
+		}
+
+	/* building the caches is the whole point, whatever the interactive setting is */
+	options->thumbnails.enable_caching = TRUE;
+
+	if (cb->threads < 1) cb->threads = cache_manager_render_threads();
+
+	for (work = folders; work; work = work->next)
+		{
+		FileData *dir_fd;
+
+		dir_fd = file_data_new_dir(work->data);
+		cache_build_collect(cb, dir_fd);
+		file_data_unref(dir_fd);
+		}
+	string_list_free(folders);
+
+	cb->count_total = g_list_length(cb->list);
+	cb->time_start = g_get_monotonic_time();
+
+	printf_term(FALSE, "start\t%d\n", cb->count_total);
+	fflush(stdout);
+
+	cb->loop = g_main_loop_new(NULL, FALSE);
+	cb->idle_id = g_idle_add(cache_build_start_cb, cb);
+	g_main_loop_run(cb->loop);
+	g_main_loop_unref(cb->loop);
+	if (cb->idle_id) g_source_remove(cb->idle_id);
+
+	cache_sim_db_flush();
+	thumb_std_save_flush();
+
+	cache_build_report_end(cb);
+
+	ret = (cb->count_failed > 0) ? CACHE_BUILD_EXIT_FAILED : CACHE_BUILD_EXIT_OK;
+	g_free(cb);
+
+	return ret;
+}
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
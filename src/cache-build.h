@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CACHE_BUILD_H
+#define CACHE_BUILD_H
+
+
+#define CACHE_BUILD_OPTION "--cache-build"
+
+typedef enum {
+	CACHE_BUILD_EXIT_OK	= 0,	/* every file is cached */
+	CACHE_BUILD_EXIT_FAILED	= 1,	/* some files could not be read */
+	CACHE_BUILD_EXIT_USAGE	= 2	/* invalid arguments or folder */
+} CacheBuildExit;
+
+/* builds the caches of the folders given on the command line, without a display,
+ * argv[1] is CACHE_BUILD_OPTION, returns a CacheBuildExit code
+ */
+gint cache_build_main(gint argc, gchar *argv[]);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -0,0 +1,1114 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "cache-db.h"
+
+#include "secure_save.h"
+#include "ui_fileops.h"
+
+#include <errno.h>
+#include <sys/file.h>
+
+
+/*
+ *-------------------------------------------------------------------
+ * Similarity cache database format:
+ *-------------------------------------------------------------------
+ *
+ * All similarity cache data of a directory is stored in one file, GQ_CACHE_SIM_DB,
+ * in the cache directory of the thumbnails of that directory. The file is mapped
+ * and indexed when the directory is first used, changes are kept in memory and
+ * appended to the file in batches. A later record of a name replaces the earlier
+ * ones, a record with the removed flag deletes the name. The file is rewritten
+ * without the replaced records when they are more than half of it, and when
+ * the databases are closed by cache_sim_db_flush().
+ *
+ * Other processes (another window, --cache-build) may map and write the same
+ * file. It is mapped under a shared flock() and written under an exclusive one.
+ * A file is never truncated: records are only appended when the file is still
+ * the one that was indexed, otherwise it is mapped again, and it is rewritten
+ * through secure_save (a new file renamed over the old one) when it has data
+ * after its valid records.
+ *
+ * All numbers are little endian.
+ *
+ * header: "GQSIMDB\0", guint32 version, guint32 record count
+ * record: guint32 record size, guint16 name length, guint16 flags,
+ *         gint64 file mtime, gint64 file size,
+ *         gint32 width, gint32 height, gint64 date, 16 bytes MD5 digest,
+ *         guint16 checksum length,
+ *         name (not terminated), checksum text (not terminated),
+ *         SimilarityGrid 32 x 32 RGB (3072 bytes, only if the flag is set)
+ *
+ * A record is only valid while the mtime and size of the file are unchanged.
+ *
+ * When a directory has no database yet, the old per file .sim files of the
+ * directory are imported.
+ */
+
+#define CACHE_SIM_DB_MAGIC		"GQSIMDB"
+#define CACHE_SIM_DB_VERSION		2	/* 1 is the same without removed records */
+#define CACHE_SIM_DB_HEADER_SIZE	16
+#define CACHE_SIM_DB_RECORD_SIZE	58	/* without name, checksum and grid */
+#define CACHE_SIM_DB_GRID_SIZE		(32 * 32 * 3)
+
+#define CACHE_SIM_DB_MAX_OPEN		8	/* databases kept mapped */
+#define CACHE_SIM_DB_FLUSH_DELAY	5000	/* ms */
+#define CACHE_SIM_DB_MAX_CHANGES	1000	/* per database, written early when more */
+#define CACHE_SIM_DB_MAX_DEAD		50	/* percent of replaced records, compacted when more */
+
+enum {
+	CACHE_SIM_DB_DIMENSIONS	= 1 << 0,
+	CACHE_SIM_DB_DATE	= 1 << 1,
+	CACHE_SIM_DB_MD5SUM	= 1 << 2,
+	CACHE_SIM_DB_SIMILARITY	= 1 << 3,
+	CACHE_SIM_DB_REMOVED	= 1 << 4
+};
+
+typedef struct _CacheSimDbEntry CacheSimDbEntry;
+struct _CacheSimDbEntry
+{
+	gint64 mtime;
+	gint64 size;
+	CacheData *cd;			/* NULL if removed */
+};
+
+typedef struct _CacheSimDb CacheSimDb;
+struct _CacheSimDb
+{
+	gchar *dir;			/* of the source files */
+	gchar *path;			/* of the database file */
+	gboolean local;			/* path is in dir */
+
+	GMappedFile *mapped;
+	GHashTable *index;		/* name -> offset of the record in mapped */
+	guint32 records;		/* in the file, including the replaced ones */
+	gsize end;			/* of the valid records, 0 if there is no valid file */
+	dev_t dev;			/* of the mapped file */
+	ino_t ino;
+	GHashTable *changes;		/* name -> CacheSimDbEntry, not written yet */
+};
+
+/* the databases may be used by any thread */
+static GMutex cache_sim_db_mutex;
+
+static GList *cache_sim_db_list = NULL;	/* most recently used first */
+static guint cache_sim_db_timer_id = 0;
+
+static void cache_sim_db_write(CacheSimDb *db, gboolean compact);
+
+
+/*
+ *-------------------------------------------------------------------
+ * records
+ *-------------------------------------------------------------------
+ */
+
+static guint16 cache_sim_db_get_u16(const guchar *p)
+{
+	guint16 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT16_FROM_LE(v);
+}
+
+static guint32 cache_sim_db_get_u32(const guchar *p)
+{
+	guint32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT32_FROM_LE(v);
+}
+
+static guint64 cache_sim_db_get_u64(const guchar *p)
+{
+	guint64 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT64_FROM_LE(v);
+}
+
+static void cache_sim_db_put_u16(GByteArray *buf, guint16 v)
+{
+	v = GUINT16_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+static void cache_sim_db_put_u32(GByteArray *buf, guint32 v)
+{
+	v = GUINT32_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+static void cache_sim_db_put_u64(GByteArray *buf, guint64 v)
+{
+	v = GUINT64_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+/* returns the size of the record at p, 0 if it is not valid */
+static gsize cache_sim_db_record_check(const guchar *p, gsize len)
+{
+	guint32 size;
+	guint16 name_len;
+	guint16 flags;
+	guint16 checksum_len;
+
+	if (len < CACHE_SIM_DB_RECORD_SIZE) return 0;
+
+	size = cache_sim_db_get_u32(p);
+	name_len = cache_sim_db_get_u16(p + 4);
+	flags = cache_sim_db_get_u16(p + 6);
+	checksum_len = cache_sim_db_get_u16(p + 56);
+
+	if (name_len == 0 || size > len) return 0;
+	if (size != CACHE_SIM_DB_RECORD_SIZE + name_len + checksum_len +
+		    ((flags & CACHE_SIM_DB_SIMILARITY) ? CACHE_SIM_DB_GRID_SIZE : 0)) return 0;
+
+	return size;
+}
+
+static CacheSimDbEntry *cache_sim_db_record_decode(const guchar *p)
+{
+	CacheSimDbEntry *entry;
+	CacheData *cd;
+	guint16 name_len = cache_sim_db_get_u16(p + 4);
+	guint16 flags = cache_sim_db_get_u16(p + 6);
+	guint16 checksum_len = cache_sim_db_get_u16(p + 56);
+	const guchar *data = p + CACHE_SIM_DB_RECORD_SIZE + name_len;
+
+	entry = g_new0(CacheSimDbEntry, 1);
+	entry->mtime = (gint64)cache_sim_db_get_u64(p + 8);
+	entry->size = (gint64)cache_sim_db_get_u64(p + 16);
+
+	cd = cache_sim_data_new();
+	if (flags & CACHE_SIM_DB_DIMENSIONS)
+		{
+		cache_sim_data_set_dimensions(cd, (gint32)cache_sim_db_get_u32(p + 24),
+						  (gint32)cache_sim_db_get_u32(p + 28));
+		}
+	if (flags & CACHE_SIM_DB_DATE)
+		{
+		cache_sim_data_set_date(cd, (time_t)cache_sim_db_get_u64(p + 32));
+		}
+	if (flags & CACHE_SIM_DB_MD5SUM)
+		{
+		memcpy(cd->md5sum, p + 40, 16);
+		cd->have_md5sum = TRUE;
+		}
+	if (checksum_len > 0)
+		{
+		cd->checksum = g_strndup((const gchar *)data, checksum_len);
+		}
+	data += checksum_len;
+
+	if (flags & CACHE_SIM_DB_SIMILARITY)
+		{
+		gint i;
+
+		cd->sim = image_sim_new();
+		for (i = 0; i < 1024; i++)
+			{
+			cd->sim->avg_r[i] = data[i * 3];
+			cd->sim->avg_g[i] = data[i * 3 + 1];
+			cd->sim->avg_b[i] = data[i * 3 + 2];
+			}
+		cd->sim->filled = TRUE;
+		cd->similarity = TRUE;
+		}
+
+	entry->cd = cd;
+
+	return entry;
+}
+
+static void cache_sim_db_put_header(GByteArray *buf, guint32 count)
+{
+	g_byte_array_append(buf, (const guint8 *)CACHE_SIM_DB_MAGIC, sizeof(CACHE_SIM_DB_MAGIC));
+	cache_sim_db_put_u32(buf, CACHE_SIM_DB_VERSION);
+	cache_sim_db_put_u32(buf, count);
+}
+
+/* a NULL entry or entry data writes a removed record */
+static void cache_sim_db_record_encode(GByteArray *buf, const gchar *name, CacheSimDbEntry *entry)
+{
+	CacheData *cd = entry ? entry->cd : NULL;
+	guint16 name_len = strlen(name);
+	guint16 checksum_len = (cd && cd->checksum) ? strlen(cd->checksum) : 0;
+	guint16 flags = 0;
+	guint8 md5sum[16];
+	gboolean similarity = (cd && cd->similarity && cd->sim && cd->sim->filled);
+
+	if (!cd) flags |= CACHE_SIM_DB_REMOVED;
+	if (cd && cd->dimensions) flags |= CACHE_SIM_DB_DIMENSIONS;
+	if (cd && cd->have_date) flags |= CACHE_SIM_DB_DATE;
+	if (cd && cd->have_md5sum) flags |= CACHE_SIM_DB_MD5SUM;
+	if (similarity) flags |= CACHE_SIM_DB_SIMILARITY;
+
+	cache_sim_db_put_u32(buf, CACHE_SIM_DB_RECORD_SIZE + name_len + checksum_len +
+				  (similarity ? CACHE_SIM_DB_GRID_SIZE : 0));
+	cache_sim_db_put_u16(buf, name_len);
+	cache_sim_db_put_u16(buf, flags);
+	cache_sim_db_put_u64(buf, (guint64)(cd ? entry->mtime : 0));
+	cache_sim_db_put_u64(buf, (guint64)(cd ? entry->size : 0));
+	cache_sim_db_put_u32(buf, (guint32)((cd && cd->dimensions) ? cd->width : 0));
+	cache_sim_db_put_u32(buf, (guint32)((cd && cd->dimensions) ? cd->height : 0));
+	cache_sim_db_put_u64(buf, (guint64)((cd && cd->have_date) ? (gint64)cd->date : -1));
+
+	memset(md5sum, 0, sizeof(md5sum));
+	if (cd && cd->have_md5sum) memcpy(md5sum, cd->md5sum, sizeof(md5sum));
+	g_byte_array_append(buf, md5sum, sizeof(md5sum));
+
+	cache_sim_db_put_u16(buf, checksum_len);
+	g_byte_array_append(buf, (const guint8 *)name, name_len);
+	if (checksum_len > 0) g_byte_array_append(buf, (const guint8 *)cd->checksum, checksum_len);
+
+	if (similarity)
+		{
+		guint8 grid[CACHE_SIM_DB_GRID_SIZE];
+		gint i;
+
+		for (i = 0; i < 1024; i++)
+			{
+			grid[i * 3] = cd->sim->avg_r[i];
+			grid[i * 3 + 1] = cd->sim->avg_g[i];
+			grid[i * 3 + 2] = cd->sim->avg_b[i];
+			}
+		g_byte_array_append(buf, grid, sizeof(grid));
+		}
+}
+
+static void cache_sim_db_entry_free(gpointer data)
+{
+	CacheSimDbEntry *entry = data;
+
+	if (!entry) return;
+
+	cache_sim_data_free(entry->cd);
+	g_free(entry);
+}
+
+/* copies the data set in src to dest */
+static void cache_sim_db_data_merge(CacheData *dest, CacheData *src)
+{
+	if (src->dimensions) cache_sim_data_set_dimensions(dest, src->width, src->height);
+	if (src->have_date) cache_sim_data_set_date(dest, src->date);
+	if (src->have_md5sum) cache_sim_data_set_md5sum(dest, src->md5sum);
+	if (src->checksum) cache_sim_data_set_checksum(dest, src->checksum);
+	if (src->similarity) cache_sim_data_set_similarity(dest, src->sim);
+}
+
+/*
+ *-------------------------------------------------------------------
+ * database
+ *-------------------------------------------------------------------
+ */
+
+static void cache_sim_db_index(CacheSimDb *db)
+{
+	const guchar *data;
+	gsize len;
+	gsize offset;
+	guint32 count;
+	guint32 i;
+
+	db->index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	db->records = 0;
+	db->end = 0;
+
+	if (!db->mapped) return;
+
+	data = (const guchar *)g_mapped_file_get_contents(db->mapped);
+	len = g_mapped_file_get_length(db->mapped);
+
+	if (len < CACHE_SIM_DB_HEADER_SIZE ||
+	    memcmp(data, CACHE_SIM_DB_MAGIC, sizeof(CACHE_SIM_DB_MAGIC)) != 0 ||
+	    (cache_sim_db_get_u32(data + 8) != CACHE_SIM_DB_VERSION && cache_sim_db_get_u32(data + 8) != 1))
+		{
+		log_printf("Ignoring invalid similarity cache database: %s\n", db->path);
+		return;
+		}
+
+	count = cache_sim_db_get_u32(data + 12);
+	offset = CACHE_SIM_DB_HEADER_SIZE;
+	for (i = 0; i < count; i++)
+		{
+		gsize size = cache_sim_db_record_check(data + offset, len - offset);
+		gchar *name;
+
+		if (size == 0)
+			{
+			log_printf("Similarity cache database is truncated: %s\n", db->path);
+			break;
+			}
+
+		name = g_strndup((const gchar *)data + offset + CACHE_SIM_DB_RECORD_SIZE,
+				 cache_sim_db_get_u16(data + offset + 4));
+		if (cache_sim_db_get_u16(data + offset + 6) & CACHE_SIM_DB_REMOVED)
+			{
+			g_hash_table_remove(db->index, name);
+			g_free(name);
+			}
+		else
+			{
+			g_hash_table_replace(db->index, name, GSIZE_TO_POINTER(offset));
+			}
+		offset += size;
+		}
+
+	/* a file with data after the valid records is rewritten by the next write */
+	db->records = i;
+	db->end = offset;
+}
+
+/* maps and indexes the open file fd, -1 if there is none */
+static void cache_sim_db_map_fd(CacheSimDb *db, gint fd)
+{
+	GError *error = NULL;
+	struct stat st;
+
+	if (db->mapped) g_mapped_file_unref(db->mapped);
+	db->mapped = NULL;
+	if (db->index) g_hash_table_destroy(db->index);
+	db->index = NULL;
+
+	if (fd >= 0 && fstat(fd, &st) == 0)
+		{
+		db->dev = st.st_dev;
+		db->ino = st.st_ino;
+
+		db->mapped = g_mapped_file_new_from_fd(fd, FALSE, &error);
+		if (error)
+			{
+			log_printf("Unable to read similarity cache database %s: %s\n", db->path, error->message);
+			g_error_free(error);
+			}
+		}
+
+	cache_sim_db_index(db);
+}
+
+/* opens the file and locks it with operation, the file may have been replaced
+ * while waiting for the lock, then the new one is opened
+ */
+static gint cache_sim_db_lock(CacheSimDb *db, gint flags, gint operation)
+{
+	gchar *pathl;
+	gint fd = -1;
+
+	pathl = path_from_utf8(db->path);
+	while (TRUE)
+		{
+		struct stat st_fd;
+		struct stat st_path;
+
+		fd = open(pathl, flags);
+		if (fd < 0)
+			{
+			if (errno != ENOENT)
+				{
+				log_printf("Unable to open similarity cache database %s: %s\n", db->path, g_strerror(errno));
+				}
+			break;
+			}
+
+		if (flock(fd, operation) != 0 || fstat(fd, &st_fd) != 0)
+			{
+			close(fd);
+			fd = -1;
+			break;
+			}
+
+		if (stat(pathl, &st_path) == 0 &&
+		    st_path.st_dev == st_fd.st_dev && st_path.st_ino == st_fd.st_ino) break;
+
+		close(fd);
+		}
+	g_free(pathl);
+
+	return fd;
+}
+
+/* the lock is released explicitly, a mapping of fd keeps it until unmapped */
+static void cache_sim_db_unlock(gint fd)
+{
+	if (fd < 0) return;
+
+	flock(fd, LOCK_UN);
+	close(fd);
+}
+
+static void cache_sim_db_map(CacheSimDb *db)
+{
+	gint fd;
+
+	fd = cache_sim_db_lock(db, O_RDONLY, LOCK_SH);
+	cache_sim_db_map_fd(db, fd);
+	cache_sim_db_unlock(fd);
+}
+
+static void cache_sim_db_change(CacheSimDb *db, const gchar *name, CacheSimDbEntry *entry)
+{
+	g_hash_table_replace(db->changes, g_strdup(name), entry);
+
+	if (g_hash_table_size(db->changes) >= CACHE_SIM_DB_MAX_CHANGES)
+		{
+		cache_sim_db_write(db, FALSE);
+		}
+}
+
+static void cache_sim_db_import_dir(CacheSimDb *db, const gchar *sim_dir)
+{
+	GDir *gdir;
+	gchar *pathl;
+	const gchar *namel;
+	gint count = 0;
+
+	pathl = path_from_utf8(sim_dir);
+	gdir = g_dir_open(pathl, 0, NULL);
+	g_free(pathl);
+	if (!gdir) return;
+
+	while ((namel = g_dir_read_name(gdir)) != NULL)
+		{
+		gchar *name;
+		gchar *source;
+		gchar *sim_path;
+		struct stat st;
+
+		if (!g_str_has_suffix(namel, GQ_CACHE_EXT_SIM)) continue;
+
+		name = path_to_utf8(namel);
+		name[strlen(name) - strlen(GQ_CACHE_EXT_SIM)] = '\0';
+
+		source = g_build_filename(db->dir, name, NULL);
+		sim_path = g_build_filename(sim_dir, namel, NULL);
+
+		if (!g_hash_table_lookup(db->changes, name) &&
+		    stat_utf8(source, &st) && S_ISREG(st.st_mode) &&
+		    filetime(sim_path) == st.st_mtime)
+			{
+			CacheData *cd = cache_sim_data_load(sim_path);
+
+			if (cd)
+				{
+				CacheSimDbEntry *entry = g_new0(CacheSimDbEntry, 1);
+
+				entry->mtime = st.st_mtime;
+				entry->size = st.st_size;
+				entry->cd = cd;
+				g_hash_table_replace(db->changes, g_strdup(name), entry);
+				count++;
+				}
+			}
+
+		g_free(sim_path);
+		g_free(source);
+		g_free(name);
+		}
+
+	g_dir_close(gdir);
+
+	if (count > 0) DEBUG_1("Imported %d .sim files from %s", count, sim_dir);
+}
+
+static CacheSimDb *cache_sim_db_new(const gchar *dir)
+{
+	CacheSimDb *db;
+
+	db = g_new0(CacheSimDb, 1);
+	db->dir = g_strdup(dir);
+	db->changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, cache_sim_db_entry_free);
+
+	return db;
+}
+
+static CacheSimDb *cache_sim_db_open(const gchar *dir)
+{
+	CacheSimDb *db;
+	gchar *local;
+	gchar *rc;
+
+	db = cache_sim_db_new(dir);
+
+	local = g_build_filename(dir, GQ_CACHE_LOCAL_THUMB, GQ_CACHE_SIM_DB, NULL);
+	rc = g_build_filename(get_thumbnails_cache_dir(), dir, GQ_CACHE_SIM_DB, NULL);
+
+	/* same choice as cache_get_location(), but use an existing database */
+	db->local = (options->thumbnails.cache_into_dirs && access_file(dir, W_OK));
+	if (!isfile(db->local ? local : rc) && isfile(db->local ? rc : local)) db->local = !db->local;
+	db->path = g_strdup(db->local ? local : rc);
+
+	cache_sim_db_map(db);
+
+	if (!db->mapped)
+		{
+		gchar *sim_dir;
+
+		sim_dir = remove_level_from_path(local);
+		cache_sim_db_import_dir(db, sim_dir);
+		g_free(sim_dir);
+
+		sim_dir = remove_level_from_path(rc);
+		cache_sim_db_import_dir(db, sim_dir);
+		g_free(sim_dir);
+		}
+
+	g_free(local);
+	g_free(rc);
+
+	return db;
+}
+
+static void cache_sim_db_close(CacheSimDb *db, gboolean compact)
+{
+	cache_sim_db_write(db, compact);
+
+	if (db->mapped) g_mapped_file_unref(db->mapped);
+	if (db->index) g_hash_table_destroy(db->index);
+	g_hash_table_destroy(db->changes);
+	g_free(db->dir);
+	g_free(db->path);
+	g_free(db);
+}
+
+static gboolean cache_sim_db_timer_cb(gpointer data)
+{
+	GList *work;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	cache_sim_db_timer_id = 0;
+	for (work = cache_sim_db_list; work; work = work->next)
+		{
+		cache_sim_db_write(work->data, FALSE);
+		}
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+
+	return FALSE;
+}
+
+/* returns the database of the directory of path, and the file name in it */
+static CacheSimDb *cache_sim_db_get(const gchar *path, const gchar **name)
+{
+	CacheSimDb *db = NULL;
+	gchar *dir;
+	GList *work;
+
+	if (!path) return NULL;
+
+	*name = filename_from_path(path);
+	if (!(*name)[0]) return NULL;
+
+	dir = remove_level_from_path(path);
+
+	for (work = cache_sim_db_list; work; work = work->next)
+		{
+		CacheSimDb *db_list = work->data;
+
+		if (strcmp(db_list->dir, dir) == 0)
+			{
+			db = db_list;
+			cache_sim_db_list = g_list_remove_link(cache_sim_db_list, work);
+			cache_sim_db_list = g_list_concat(work, cache_sim_db_list);
+			break;
+			}
+		}
+
+	if (!db)
+		{
+		db = cache_sim_db_open(dir);
+		cache_sim_db_list = g_list_prepend(cache_sim_db_list, db);
+
+		if (g_list_length(cache_sim_db_list) > CACHE_SIM_DB_MAX_OPEN)
+			{
+			work = g_list_last(cache_sim_db_list);
+			cache_sim_db_close(work->data, FALSE);
+			cache_sim_db_list = g_list_delete_link(cache_sim_db_list, work);
+			}
+		}
+
+	g_free(dir);
+
+	if (!cache_sim_db_timer_id)
+		{
+		cache_sim_db_timer_id = g_timeout_add(CACHE_SIM_DB_FLUSH_DELAY, cache_sim_db_timer_cb, NULL);
+		}
+
+	return db;
+}
+
+/* returns the stored entry of name, it must be freed if owned is set */
+static CacheSimDbEntry *cache_sim_db_find(CacheSimDb *db, const gchar *name, gboolean *owned)
+{
+	gpointer value;
+
+	*owned = FALSE;
+	if (g_hash_table_lookup_extended(db->changes, name, NULL, &value)) return value;
+
+	if (db->mapped && g_hash_table_lookup_extended(db->index, name, NULL, &value))
+		{
+		const guchar *data = (const guchar *)g_mapped_file_get_contents(db->mapped);
+
+		*owned = TRUE;
+		return cache_sim_db_record_decode(data + GPOINTER_TO_SIZE(value));
+		}
+
+	return NULL;
+}
+
+/* returns TRUE if the locked file fd is still the indexed one, without anything after its records */
+static gboolean cache_sim_db_is_current(CacheSimDb *db, gint fd)
+{
+	guchar header[CACHE_SIM_DB_HEADER_SIZE];
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) return FALSE;
+	if (st.st_dev != db->dev || st.st_ino != db->ino || (gsize)st.st_size != db->end) return FALSE;
+
+	return (pread(fd, header, sizeof(header), 0) == sizeof(header) &&
+		cache_sim_db_get_u32(header + 12) == db->records);
+}
+
+/* writes the records in buf after the valid records of the locked file fd */
+static gboolean cache_sim_db_append(CacheSimDb *db, gint fd, GByteArray *buf, guint32 count)
+{
+	GByteArray *header;
+	gboolean ret = FALSE;
+
+	header = g_byte_array_new();
+	cache_sim_db_put_header(header, db->records + count);
+
+	/* the header is updated last, the records are ignored if that fails */
+	if (pwrite(fd, buf->data, buf->len, db->end) == (gssize)buf->len &&
+	    pwrite(fd, header->data, header->len, 0) == (gssize)header->len)
+		{
+		ret = TRUE;
+		}
+
+	g_byte_array_free(header, TRUE);
+
+	return ret;
+}
+
+/* rewrites the file with only the current records */
+static void cache_sim_db_compact(CacheSimDb *db)
+{
+	GByteArray *buf;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	guint32 count = 0;
+	SecureSaveInfo *ssi;
+	gchar *pathl;
+	gchar *base;
+
+	buf = g_byte_array_new();
+	cache_sim_db_put_header(buf, 0);
+
+	if (db->mapped)
+		{
+		const guchar *data = (const guchar *)g_mapped_file_get_contents(db->mapped);
+
+		g_hash_table_iter_init(&iter, db->index);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+			{
+			const guchar *record = data + GPOINTER_TO_SIZE(value);
+
+			if (g_hash_table_contains(db->changes, key)) continue;
+
+			g_byte_array_append(buf, record, cache_sim_db_get_u32(record));
+			count++;
+			}
+		}
+
+	g_hash_table_iter_init(&iter, db->changes);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		{
+		CacheSimDbEntry *entry = value;
+
+		if (!entry || !entry->cd) continue;
+
+		cache_sim_db_record_encode(buf, key, entry);
+		count++;
+		}
+
+	count = GUINT32_TO_LE(count);
+	memcpy(buf->data + 12, &count, sizeof(count));
+
+	DEBUG_1("Writing similarity cache database %s, %d changes, %d replaced records", db->path,
+		g_hash_table_size(db->changes), db->records - g_hash_table_size(db->index));
+
+	pathl = path_from_utf8(db->path);
+	if (count == 0)
+		{
+		if (unlink(pathl) != 0 && errno != ENOENT)
+			{
+			log_printf("Unable to delete similarity cache database: %s\n", db->path);
+			}
+		}
+	else
+		{
+		base = remove_level_from_path(db->path);
+		if (recursive_mkdir_if_not_exists(base, db->local ? 0775 : 0755))
+			{
+			ssi = secure_open(pathl);
+			if (ssi)
+				{
+				secure_fwrite(buf->data, buf->len, 1, ssi);
+				if (secure_close(ssi))
+					{
+					log_printf(_("error saving sim cache data: %s\nerror: %s\n"), db->path,
+						   secsave_strerror(secsave_errno));
+					}
+				}
+			else
+				{
+				log_printf("Unable to save sim cache data: %s\n", db->path);
+				}
+			}
+		g_free(base);
+		}
+	g_free(pathl);
+
+	g_byte_array_free(buf, TRUE);
+}
+
+/* appends the changes to the file, or rewrites it if compact is set or too
+ * many of its records would be replaced ones
+ */
+static void cache_sim_db_write(CacheSimDb *db, gboolean compact)
+{
+	gint fd;
+
+	if (g_hash_table_size(db->changes) == 0 && (!compact || db->records == g_hash_table_size(db->index))) return;
+
+	/* the other processes wait until the file is appended or replaced */
+	fd = cache_sim_db_lock(db, O_RDWR, LOCK_EX);
+
+	/* another process changed the file since it was indexed */
+	if (fd >= 0 && !cache_sim_db_is_current(db, fd)) cache_sim_db_map_fd(db, fd);
+
+	if (!compact && fd >= 0 && cache_sim_db_is_current(db, fd))
+		{
+		GByteArray *buf;
+		GHashTableIter iter;
+		gpointer key;
+		gpointer value;
+		guint32 live = g_hash_table_size(db->index);
+		guint32 count = 0;
+		guint32 dead;
+
+		buf = g_byte_array_new();
+
+		g_hash_table_iter_init(&iter, db->changes);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+			{
+			CacheSimDbEntry *entry = value;
+			gboolean indexed = g_hash_table_contains(db->index, key);
+
+			if (entry && entry->cd)
+				{
+				cache_sim_db_record_encode(buf, key, entry);
+				count++;
+				if (!indexed) live++;
+				}
+			else if (indexed)
+				{
+				cache_sim_db_record_encode(buf, key, NULL);
+				count++;
+				live--;
+				}
+			}
+
+		dead = db->records + count - live;
+		if ((guint64)dead * 100 <= (guint64)(db->records + count) * CACHE_SIM_DB_MAX_DEAD)
+			{
+			DEBUG_1("Appending to similarity cache database %s, %d records", db->path, count);
+
+			if (count > 0 && !cache_sim_db_append(db, fd, buf, count))
+				{
+				log_printf("Unable to append to similarity cache database: %s\n", db->path);
+				}
+			}
+		else
+			{
+			compact = TRUE;
+			}
+
+		g_byte_array_free(buf, TRUE);
+		}
+	else
+		{
+		compact = TRUE;
+		}
+
+	if (compact) cache_sim_db_compact(db);
+
+	cache_sim_db_unlock(fd);
+
+	/* changes that could not be written are dropped, it is only a cache */
+	g_hash_table_remove_all(db->changes);
+	cache_sim_db_map(db);
+}
+
+/*
+ *-------------------------------------------------------------------
+ * public
+ *-------------------------------------------------------------------
+ */
+
+CacheData *cache_sim_db_load(const gchar *path)
+{
+	CacheSimDb *db;
+	CacheSimDbEntry *entry;
+	CacheData *cd = NULL;
+	const gchar *name;
+	gboolean owned;
+	struct stat st;
+
+	if (!stat_utf8(path, &st)) return NULL;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	db = cache_sim_db_get(path, &name);
+	entry = db ? cache_sim_db_find(db, name, &owned) : NULL;
+	if (entry && entry->cd && entry->mtime == st.st_mtime && entry->size == st.st_size)
+		{
+		if (owned)
+			{
+			cd = entry->cd;
+			entry->cd = NULL;
+			}
+		else
+			{
+			cd = cache_sim_data_new();
+			cache_sim_db_data_merge(cd, entry->cd);
+			}
+		cd->path = g_strdup(db->path);
+		}
+	if (entry && owned) cache_sim_db_entry_free(entry);
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+
+	return cd;
+}
+
+gboolean cache_sim_db_save(const gchar *path, CacheData *cd)
+{
+	CacheSimDb *db;
+	CacheSimDbEntry *entry;
+	CacheSimDbEntry *found;
+	const gchar *name;
+	gboolean owned;
+	struct stat st;
+
+	if (!cd || !stat_utf8(path, &st)) return FALSE;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	db = cache_sim_db_get(path, &name);
+	if (!db)
+		{
+		g_mutex_unlock(&cache_sim_db_mutex);
+		return FALSE;
+		}
+
+	entry = g_new0(CacheSimDbEntry, 1);
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	entry->cd = cache_sim_data_new();
+
+	/* keep the data that is still valid and not replaced */
+	found = cache_sim_db_find(db, name, &owned);
+	if (found && found->cd && found->mtime == st.st_mtime && found->size == st.st_size)
+		{
+		cache_sim_db_data_merge(entry->cd, found->cd);
+		}
+	if (found && owned) cache_sim_db_entry_free(found);
+
+	cache_sim_db_data_merge(entry->cd, cd);
+	cache_sim_db_change(db, name, entry);
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+
+	return TRUE;
+}
+
+void cache_sim_db_remove(const gchar *path)
+{
+	CacheSimDb *db;
+	const gchar *name;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	db = cache_sim_db_get(path, &name);
+	if (db && (g_hash_table_contains(db->changes, name) || g_hash_table_contains(db->index, name)))
+		{
+		cache_sim_db_change(db, name, NULL);
+		}
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+}
+
+void cache_sim_db_move(const gchar *src, const gchar *dest)
+{
+	CacheSimDb *db;
+	CacheSimDbEntry *entry;
+	const gchar *name;
+	gboolean owned;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	db = cache_sim_db_get(src, &name);
+	entry = db ? cache_sim_db_find(db, name, &owned) : NULL;
+	if (entry && entry->cd)
+		{
+		CacheSimDbEntry *moved = g_new0(CacheSimDbEntry, 1);
+
+		/* the file is the same, mtime and size do not change */
+		moved->mtime = entry->mtime;
+		moved->size = entry->size;
+		if (owned)
+			{
+			moved->cd = entry->cd;
+			entry->cd = NULL;
+			}
+		else
+			{
+			moved->cd = cache_sim_data_new();
+			cache_sim_db_data_merge(moved->cd, entry->cd);
+			}
+
+		cache_sim_db_change(db, name, NULL);
+
+		db = cache_sim_db_get(dest, &name);
+		if (db)
+			{
+			cache_sim_db_change(db, name, moved);
+			}
+		else
+			{
+			cache_sim_db_entry_free(moved);
+			}
+		}
+	if (entry && owned) cache_sim_db_entry_free(entry);
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+}
+
+void cache_sim_db_flush(void)
+{
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	if (cache_sim_db_timer_id)
+		{
+		g_source_remove(cache_sim_db_timer_id);
+		cache_sim_db_timer_id = 0;
+		}
+
+	while (cache_sim_db_list)
+		{
+		cache_sim_db_close(cache_sim_db_list->data, TRUE);
+		cache_sim_db_list = g_list_delete_link(cache_sim_db_list, cache_sim_db_list);
+		}
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+}
+
+gboolean cache_sim_db_maint(const gchar *path, gboolean clear)
+{
+	CacheSimDb *db = NULL;
+	GHashTableIter iter;
+	gpointer key;
+	gboolean exists;
+	GList *work;
+
+	g_mutex_lock(&cache_sim_db_mutex);
+
+	for (work = cache_sim_db_list; work; work = work->next)
+		{
+		CacheSimDb *db_list = work->data;
+
+		if (strcmp(db_list->path, path) == 0) db = db_list;
+		}
+
+	if (!db)
+		{
+		gchar *base = remove_level_from_path(path);
+		const gchar *cache_dir = get_thumbnails_cache_dir();
+
+		/* the source directory is the cache directory without the cache location */
+		if (g_str_has_suffix(base, G_DIR_SEPARATOR_S GQ_CACHE_LOCAL_THUMB))
+			{
+			db = cache_sim_db_new(NULL);
+			db->dir = remove_level_from_path(base);
+			db->local = TRUE;
+			}
+		else if (g_str_has_prefix(base, cache_dir))
+			{
+			db = cache_sim_db_new(base + strlen(cache_dir));
+			}
+		g_free(base);
+
+		if (!db)
+			{
+			g_mutex_unlock(&cache_sim_db_mutex);
+			return isfile(path);
+			}
+
+		db->path = g_strdup(path);
+		cache_sim_db_map(db);
+		}
+
+	g_hash_table_iter_init(&iter, db->index);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		{
+		gchar *source = g_build_filename(db->dir, key, NULL);
+
+		if ((clear || !isfile(source)) && !g_hash_table_contains(db->changes, key))
+			{
+			g_hash_table_replace(db->changes, g_strdup(key), NULL);
+			}
+		g_free(source);
+		}
+	if (clear)
+		{
+		/* pending changes are dropped too */
+		g_hash_table_iter_init(&iter, db->changes);
+		while (g_hash_table_iter_next(&iter, &key, NULL))
+			{
+			g_hash_table_iter_replace(&iter, NULL);
+			}
+		}
+
+	cache_sim_db_write(db, TRUE);
+	exists = (db->mapped != NULL);
+
+	if (!g_list_find(cache_sim_db_list, db))
+		{
+		cache_sim_db_close(db, FALSE);
+		}
+
+	g_mutex_unlock(&cache_sim_db_mutex);
+
+	return exists;
+}
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CACHE_DB_H
+#define CACHE_DB_H
+
+
+#include "cache.h"
+
+
+#define GQ_CACHE_SIM_DB		"geeqie.simdb"
+
+/* returns the cached data of the file path, NULL if none or if the file changed */
+CacheData *cache_sim_db_load(const gchar *path);
+
+/* stores the data set in cd for the file path, other stored data is kept */
+gboolean cache_sim_db_save(const gchar *path, CacheData *cd);
+
+void cache_sim_db_remove(const gchar *path);
+void cache_sim_db_move(const gchar *src, const gchar *dest);
+
+/* writes all pending changes */
+void cache_sim_db_flush(void);
+
+/* removes the data of missing files from the database file path, or all data if clear,
+ * returns TRUE if the database file still exists
+ */
+gboolean cache_sim_db_maint(const gchar *path, gboolean clear);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "cache-dirlist.h"
+
+#include "cache.h"
+#include "md5-util.h"
+#include "secure_save.h"
+#include "ui_fileops.h"
+
+#include <errno.h>
+
+
+/*
+ *-------------------------------------------------------------------
+ * Directory listing snapshot format:
+ *-------------------------------------------------------------------
+ *
+ * The entries of a folder are stored when it is read, in one file per folder
+ * in get_dir_list_cache_dir(), named after the MD5 digest of the folder path.
+ * When the folder is entered again and its mtime did not change, the view is
+ * filled from the snapshot and the folder is read again in the background.
+ *
+ * All numbers are little endian.
+ *
+ * header: "GQDIRL\0\0", guint32 version, guint32 entry count,
+ *         gint64 folder mtime, guint32 path length, folder path (utf8, not terminated)
+ * entry:  guint16 name length, guint32 mode, guint32 uid, guint32 gid,
+ *         gint64 size, gint64 mtime, gint64 ctime,
+ *         gint64 exif date, gint64 exif date digitized,
+ *         name (file system encoding, not terminated)
+ *
+ * The sidecars are stored as separate entries, they are grouped again when
+ * the snapshot is used.
+ */
+
+#define CACHE_DIR_LIST_MAGIC		"GQDIRL"
+#define CACHE_DIR_LIST_MAGIC_SIZE	8
+#define CACHE_DIR_LIST_VERSION		1
+#define CACHE_DIR_LIST_HEADER_SIZE	28	/* without path */
+#define CACHE_DIR_LIST_ENTRY_SIZE	54	/* without name */
+#define CACHE_DIR_LIST_EXT		".dirlist"
+
+
+static guint16 cache_dir_list_get_u16(const guchar *p)
+{
+	guint16 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT16_FROM_LE(v);
+}
+
+static guint32 cache_dir_list_get_u32(const guchar *p)
+{
+	guint32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT32_FROM_LE(v);
+}
+
+static guint64 cache_dir_list_get_u64(const guchar *p)
+{
+	guint64 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT64_FROM_LE(v);
+}
+
+static void cache_dir_list_put_u16(GByteArray *buf, guint16 v)
+{
+	v = GUINT16_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+static void cache_dir_list_put_u32(GByteArray *buf, guint32 v)
+{
+	v = GUINT32_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+static void cache_dir_list_put_u64(GByteArray *buf, guint64 v)
+{
+	v = GUINT64_TO_LE(v);
+	g_byte_array_append(buf, (guchar *)&v, sizeof(v));
+}
+
+static gchar *cache_dir_list_path(const gchar *dir_path)
+{
+	guchar digest[16];
+	gchar *text;
+	gchar *name;
+	gchar *path;
+
+	md5_get_digest((const guchar *)dir_path, strlen(dir_path), digest);
+	text = md5_digest_to_text(digest);
+	name = g_strconcat(text, CACHE_DIR_LIST_EXT, NULL);
+	path = g_build_filename(get_dir_list_cache_dir(), name, NULL);
+
+	g_free(name);
+	g_free(text);
+
+	return path;
+}
+
+/* returns the contents of the snapshot at path if its header is valid, dir_path and dir_mtime are optional */
+static gchar *cache_dir_list_read(const gchar *path, gsize *len, gchar **dir_path, gint64 *dir_mtime)
+{
+	gchar *pathl;
+	gchar *data = NULL;
+	guint32 path_len;
+
+	pathl = path_from_utf8(path);
+	if (!g_file_get_contents(pathl, &data, len, NULL))
+		{
+		g_free(pathl);
+		return NULL;
+		}
+	g_free(pathl);
+
+	if (*len < CACHE_DIR_LIST_HEADER_SIZE ||
+	    memcmp(data, CACHE_DIR_LIST_MAGIC, strlen(CACHE_DIR_LIST_MAGIC)) != 0 ||
+	    cache_dir_list_get_u32((guchar *)data + 8) != CACHE_DIR_LIST_VERSION)
+		{
+		g_free(data);
+		return NULL;
+		}
+
+	path_len = cache_dir_list_get_u32((guchar *)data + 24);
+	if (path_len > *len - CACHE_DIR_LIST_HEADER_SIZE)
+		{
+		g_free(data);
+		return NULL;
+		}
+
+	if (dir_path) *dir_path = g_strndup(data + CACHE_DIR_LIST_HEADER_SIZE, path_len);
+	if (dir_mtime) *dir_mtime = (gint64)cache_dir_list_get_u64((guchar *)data + 16);
+
+	return data;
+}
+
+gboolean cache_dir_list_load(const gchar *dir_path, time_t dir_mtime, GList **entries)
+{
+	gchar *path;
+	gchar *data;
+	gchar *stored_path = NULL;
+	gint64 stored_mtime = 0;
+	gsize len;
+	gsize offset;
+	guint32 count;
+	guint32 i;
+	GList *list = NULL;
+
+	*entries = NULL;
+
+	path = cache_dir_list_path(dir_path);
+	data = cache_dir_list_read(path, &len, &stored_path, &stored_mtime);
+	g_free(path);
+	if (!data) return FALSE;
+
+	if (stored_mtime != (gint64)dir_mtime || strcmp(stored_path, dir_path) != 0)
+		{
+		g_free(stored_path);
+		g_free(data);
+		return FALSE;
+		}
+
+	count = cache_dir_list_get_u32((guchar *)data + 12);
+	offset = CACHE_DIR_LIST_HEADER_SIZE + strlen(stored_path);
+	g_free(stored_path);
+
+	for (i = 0; i < count; i++)
+		{
+		const guchar *p = (guchar *)data + offset;
+		CacheDirListEntry *entry;
+		guint16 name_len;
+
+		if (len - offset < CACHE_DIR_LIST_ENTRY_SIZE) break;
+		name_len = cache_dir_list_get_u16(p);
+		if (name_len == 0 || len - offset - CACHE_DIR_LIST_ENTRY_SIZE < name_len) break;
+
+		entry = g_new0(CacheDirListEntry, 1);
+		entry->mode = cache_dir_list_get_u32(p + 2);
+		entry->uid = cache_dir_list_get_u32(p + 6);
+		entry->gid = cache_dir_list_get_u32(p + 10);
+		entry->size = (gint64)cache_dir_list_get_u64(p + 14);
+		entry->mtime = (gint64)cache_dir_list_get_u64(p + 22);
+		entry->ctime = (gint64)cache_dir_list_get_u64(p + 30);
+		entry->exifdate = (gint64)cache_dir_list_get_u64(p + 38);
+		entry->exifdate_digitized = (gint64)cache_dir_list_get_u64(p + 46);
+		entry->name = g_strndup((const gchar *)p + CACHE_DIR_LIST_ENTRY_SIZE, name_len);
+
+		list = g_list_prepend(list, entry);
+		offset += CACHE_DIR_LIST_ENTRY_SIZE + name_len;
+		}
+
+	g_free(data);
+
+	if (i < count)
+		{
+		DEBUG_1("Damaged folder snapshot of %s", dir_path);
+		cache_dir_list_free(list);
+		return FALSE;
+		}
+
+	*entries = g_list_reverse(list);
+	return TRUE;
+}
+
+static void cache_dir_list_entry_free(gpointer data)
+{
+	CacheDirListEntry *entry = data;
+
+	g_free(entry->name);
+	g_free(entry);
+}
+
+void cache_dir_list_free(GList *entries)
+{
+	g_list_free_full(entries, cache_dir_list_entry_free);
+}
+
+static void cache_dir_list_encode(GByteArray *buf, FileData *fd, guint32 *count)
+{
+	gchar *name;
+	gsize name_len;
+
+	name = path_from_utf8(fd->name);
+	name_len = name ? strlen(name) : 0;
+	if (name_len > 0 && name_len <= G_MAXUINT16)
+		{
+		cache_dir_list_put_u16(buf, name_len);
+		cache_dir_list_put_u32(buf, (guint32)fd->mode);
+		cache_dir_list_put_u32(buf, (guint32)fd->uid);
+		cache_dir_list_put_u32(buf, (guint32)fd->gid);
+		cache_dir_list_put_u64(buf, (guint64)fd->size);
+		cache_dir_list_put_u64(buf, (guint64)fd->date);
+		cache_dir_list_put_u64(buf, (guint64)fd->cdate);
+		cache_dir_list_put_u64(buf, (guint64)fd->exifdate);
+		cache_dir_list_put_u64(buf, (guint64)fd->exifdate_digitized);
+		g_byte_array_append(buf, (const guint8 *)name, name_len);
+		(*count)++;
+		}
+	g_free(name);
+}
+
+void cache_dir_list_save(const gchar *dir_path, time_t dir_mtime, GList *files)
+{
+	GByteArray *buf;
+	gchar *path;
+	gchar *pathl;
+	gchar *old;
+	gsize old_len;
+	guint32 count = 0;
+	GList *work;
+
+	buf = g_byte_array_new();
+
+	g_byte_array_append(buf, (const guint8 *)CACHE_DIR_LIST_MAGIC "\0\0", CACHE_DIR_LIST_MAGIC_SIZE);
+	cache_dir_list_put_u32(buf, CACHE_DIR_LIST_VERSION);
+	cache_dir_list_put_u32(buf, 0); /* count, set below */
+	cache_dir_list_put_u64(buf, (guint64)dir_mtime);
+	cache_dir_list_put_u32(buf, strlen(dir_path));
+	g_byte_array_append(buf, (const guint8 *)dir_path, strlen(dir_path));
+
+	for (work = files; work; work = work->next)
+		{
+		FileData *fd = work->data;
+		GList *sidecars;
+
+		cache_dir_list_encode(buf, fd, &count);
+		for (sidecars = fd->sidecar_files; sidecars; sidecars = sidecars->next)
+			{
+			cache_dir_list_encode(buf, sidecars->data, &count);
+			}
+		}
+
+	count = GUINT32_TO_LE(count);
+	memcpy(buf->data + 12, &count, sizeof(count));
+
+	path = cache_dir_list_path(dir_path);
+
+	/* most folders are unchanged when they are read again */
+	old = cache_dir_list_read(path, &old_len, NULL, NULL);
+	if (old && old_len == buf->len && memcmp(old, buf->data, old_len) == 0)
+		{
+		g_free(old);
+		g_free(path);
+		g_byte_array_free(buf, TRUE);
+		return;
+		}
+	g_free(old);
+
+	DEBUG_1("Writing folder snapshot of %s", dir_path);
+
+	pathl = path_from_utf8(path);
+	if (recursive_mkdir_if_not_exists(get_dir_list_cache_dir(), 0755))
+		{
+		SecureSaveInfo *ssi;
+
+		ssi = secure_open(pathl);
+		if (ssi)
+			{
+			secure_fwrite(buf->data, buf->len, 1, ssi);
+			if (secure_close(ssi))
+				{
+				log_printf(_("error saving folder snapshot: %s\nerror: %s\n"), path,
+					   secsave_strerror(secsave_errno));
+				}
+			}
+		else
+			{
+			log_printf("Unable to save folder snapshot: %s\n", path);
+			}
+		}
+	g_free(pathl);
+	g_free(path);
+
+	g_byte_array_free(buf, TRUE);
+}
+
+void cache_dir_list_maint(gboolean clear)
+{
+	const gchar *cache_dir = get_dir_list_cache_dir();
+	gchar *cache_dirl;
+	GDir *dir;
+	const gchar *name;
+
+	cache_dirl = path_from_utf8(cache_dir);
+	dir = g_dir_open(cache_dirl, 0, NULL);
+	g_free(cache_dirl);
+	if (!dir) return;
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+		{
+		gchar *path;
+		gchar *data;
+		gchar *dir_path = NULL;
+		gsize len;
+
+		if (!g_str_has_suffix(name, CACHE_DIR_LIST_EXT)) continue;
+
+		path = g_build_filename(cache_dir, name, NULL);
+		data = cache_dir_list_read(path, &len, &dir_path, NULL);
+
+		if (clear || !data || !isdir(dir_path))
+			{
+			DEBUG_1("Removing folder snapshot %s", path);
+			if (!unlink_file(path))
+				{
+				log_printf("Unable to delete folder snapshot: %s\n", path);
+				}
+			}
+
+		g_free(dir_path);
+		g_free(data);
+		g_free(path);
+		}
+
+	g_dir_close(dir);
+}
+
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
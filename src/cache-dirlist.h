@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CACHE_DIRLIST_H
+#define CACHE_DIRLIST_H
+
+
+typedef struct _CacheDirListEntry CacheDirListEntry;
+struct _CacheDirListEntry
+{
+	gchar *name;			/* in the file system encoding */
+	mode_t mode;
+	uid_t uid;
+	gid_t gid;
+	gint64 size;
+	gint64 mtime;
+	gint64 ctime;
+	gint64 exifdate;		/* 0 if not read */
+	gint64 exifdate_digitized;	/* 0 if not read */
+};
+
+/* reads the snapshot of dir_path, it is only valid while the mtime of the directory is dir_mtime,
+ * returns FALSE if there is no valid snapshot, entries is a list of CacheDirListEntry
+ */
+gboolean cache_dir_list_load(const gchar *dir_path, time_t dir_mtime, GList **entries);
+void cache_dir_list_free(GList *entries);
+
+/* stores files, a list of FileData with their sidecars, as the snapshot of dir_path */
+void cache_dir_list_save(const gchar *dir_path, time_t dir_mtime, GList *files);
+
+/* removes the snapshots of folders which do not exist anymore, or all of them */
+void cache_dir_list_maint(gboolean clear);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -22,6 +22,7 @@
 #include "main.h"
 #include "cache-loader.h"
 #include "cache.h"
+#include "cache-db.h"
 
 #include "filedata.h"
 #include "exif.h"
@@ -31,13 +32,15 @@
 
 
 static gboolean cache_loader_process(CacheLoader *cl);
+static gboolean cache_loader_idle_cb(gpointer data);
 
 
 static void cache_loader_done_cb(ImageLoader *il, gpointer data)
 {
 	CacheLoader *cl = data;
 
-	cache_loader_process(cl);
+	/* continue from idle, the loader can not be freed within its own signal */
+	if (!cl->idle_id) cl->idle_id = g_idle_add(cache_loader_idle_cb, cl);
 }
 
 static void cache_loader_error_cb(ImageLoader *il, gpointer data)
@@ -62,6 +65,7 @@ static gboolean cache_loader_process(CacheLoader *cl)
 			g_signal_connect(G_OBJECT(cl->il), "done", (GCallback)cache_loader_done_cb, cl);
 			if (image_loader_start(cl->il))
 				{
+				cl->idle_id = 0;
 				return FALSE;
 				}
 
@@ -167,20 +171,7 @@ static gboolean cache_loader_process(CacheLoader *cl)
 		if (options->thumbnails.enable_caching &&
 		    cl->done_mask != CACHE_LOADER_NONE)
 			{
-			gchar *base;
-			mode_t mode = 0755;
-
-			base = cache_get_location(CACHE_TYPE_SIM, cl->fd->path, FALSE, &mode);
-			if (recursive_mkdir_if_not_exists(base, mode))
-				{
-				g_free(cl->cd->path);
-				cl->cd->path = cache_get_location(CACHE_TYPE_SIM, cl->fd->path, TRUE, NULL);
-				if (cache_sim_data_save(cl->cd))
-					{
-					filetime_set(cl->cd->path, filetime(cl->fd->path));
-					}
-				}
-			g_free(base);
+			cache_sim_db_save(cl->fd->path, cl->cd);
 			}
 
 		cl->idle_id = 0;
@@ -207,8 +198,6 @@ CacheLoader *cache_loader_new(FileData *fd, CacheDataType load_mask,
 			      CacheLoaderDoneFunc done_func, gpointer done_data)
 {
 	CacheLoader *cl;
-	gchar *found;
-
 	if (!fd || !isfile(fd->path)) return NULL;
 
 	cl = g_new0(CacheLoader, 1);
@@ -217,13 +206,7 @@ CacheLoader *cache_loader_new(FileData *fd, CacheDataType load_mask,
 	cl->done_func = done_func;
 	cl->done_data = done_data;
 
-	found = cache_find_location(CACHE_TYPE_SIM, cl->fd->path);
-	if (found && filetime(found) == filetime(cl->fd->path))
-		{
-		cl->cd = cache_sim_data_load(found);
-		}
-	g_free(found);
-
+	cl->cd = cache_sim_db_load(cl->fd->path);
 	if (!cl->cd) cl->cd = cache_sim_data_new();
 
 	cl->todo_mask = load_mask;
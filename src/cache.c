@@ -41,6 +41,7 @@
  * Dimensions=[<width> x <height>]
  * Date=[<value in time_t format, or -1 if no embedded date>]
  * MD5sum=[<32 character ascii text digest>]
+ * Checksum=[<type tagged text digest, see checksum-util.h>]
  * SimilarityGrid[32 x 32]=<3072 bytes of data (1024 pixels in RGB format, 1 pixel is 24bits)>
  *
  *
@@ -73,6 +74,7 @@ void cache_sim_data_free(CacheData *cd)
 	if (!cd) return;
 
 	g_free(cd->path);
+	g_free(cd->checksum);
 	image_sim_free(cd->sim);
 	g_free(cd);
 }
@@ -114,6 +116,15 @@ static gboolean cache_sim_write_md5sum(SecureSaveInfo *ssi, CacheData *cd)
 	return TRUE;
 }
 
+static gboolean cache_sim_write_checksum(SecureSaveInfo *ssi, CacheData *cd)
+{
+	if (!cd || !cd->checksum) return FALSE;
+
+	secure_fprintf(ssi, "Checksum=[%s]\n", cd->checksum);
+
+	return TRUE;
+}
+
 static gboolean cache_sim_write_similarity(SecureSaveInfo *ssi, CacheData *cd)
 {
 	guint x, y;
@@ -166,6 +177,7 @@ gboolean cache_sim_data_save(CacheData *cd)
 	cache_sim_write_dimensions(ssi, cd);
 	cache_sim_write_date(ssi, cd);
 	cache_sim_write_md5sum(ssi, cd);
+	cache_sim_write_checksum(ssi, cd);
 	cache_sim_write_similarity(ssi, cd);
 
 	if (secure_close(ssi))
@@ -330,6 +342,45 @@ static gboolean cache_sim_read_md5sum(FILE *f, gchar *buf, gint s, CacheData *cd
 	return FALSE;
 }
 
+static gboolean cache_sim_read_checksum(FILE *f, gchar *buf, gint s, CacheData *cd)
+{
+	if (!f || !buf || !cd) return FALSE;
+
+	if (s < 10 || strncmp("Checksum", buf, 8) != 0) return FALSE;
+
+	if (fseek(f, - s, SEEK_CUR) == 0)
+		{
+		gchar b;
+		gchar buf[128];
+		gsize p = 0;
+
+		b = 'X';
+		while (b != '[')
+			{
+			if (fread(&b, sizeof(b), 1, f) != 1) return FALSE;
+			}
+		while (p < sizeof(buf) - 1)
+			{
+			if (fread(&b, sizeof(b), 1, f) != 1) return FALSE;
+			if (b == ']') break;
+			buf[p] = b;
+			p++;
+			}
+		while (b != '\n')
+			{
+			if (fread(&b, sizeof(b), 1, f) != 1) break;
+			}
+
+		buf[p] = '\0';
+		g_free(cd->checksum);
+		cd->checksum = (p > 0) ? g_strdup(buf) : NULL;
+
+		return TRUE;
+		}
+
+	return FALSE;
+}
+
 static gboolean cache_sim_read_similarity(FILE *f, gchar *buf, gint s, CacheData *cd)
 {
 	if (!f || !buf || !cd) return FALSE;
@@ -437,6 +488,7 @@ CacheData *cache_sim_data_load(const gchar *path)
 			    !cache_sim_read_dimensions(f, buf, s, cd) &&
 			    !cache_sim_read_date(f, buf, s, cd) &&
 			    !cache_sim_read_md5sum(f, buf, s, cd) &&
+			    !cache_sim_read_checksum(f, buf, s, cd) &&
 			    !cache_sim_read_similarity(f, buf, s, cd))
 				{
 				if (!cache_sim_read_skipline(f, s))
@@ -460,6 +512,7 @@ CacheData *cache_sim_data_load(const gchar *path)
 	if (!cd->dimensions &&
 	    !cd->have_date &&
 	    !cd->have_md5sum &&
+	    !cd->checksum &&
 	    !cd->similarity)
 		{
 		cache_sim_data_free(cd);
@@ -505,6 +558,14 @@ void cache_sim_data_set_md5sum(CacheData *cd, guchar digest[16])
 	cd->have_md5sum = TRUE;
 }
 
+void cache_sim_data_set_checksum(CacheData *cd, const gchar *text)
+{
+	if (!cd) return;
+
+	g_free(cd->checksum);
+	cd->checksum = g_strdup(text);
+}
+
 void cache_sim_data_set_similarity(CacheData *cd, ImageSimilarityData *sd)
 {
 	if (!cd || !sd || !sd->filled) return;
@@ -515,6 +576,7 @@ void cache_sim_data_set_similarity(CacheData *cd, ImageSimilarityData *sd)
 	memcpy(cd->sim->avg_g, sd->avg_g, 1024);
 	memcpy(cd->sim->avg_b, sd->avg_b, 1024);
 	cd->sim->filled = TRUE;
+	image_sim_changed(cd->sim);
 
 	cd->similarity = TRUE;
 }
@@ -768,4 +830,23 @@ const gchar *get_metadata_cache_dir(void)
 	return metadata_cache_dir;
 }
 
+const gchar *get_dir_list_cache_dir(void)
+{
+	static gchar *dir_list_cache_dir = NULL;
+
+	if (dir_list_cache_dir) return dir_list_cache_dir;
+
+	if (USE_XDG)
+		{
+		dir_list_cache_dir = g_build_filename(xdg_cache_home_get(),
+							GQ_APPNAME_LC, GQ_CACHE_DIR_LIST, NULL);
+		}
+	else
+		{
+		dir_list_cache_dir = g_build_filename(get_rc_dir(), GQ_CACHE_DIR_LIST, NULL);
+		}
+
+	return dir_list_cache_dir;
+}
+
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -28,6 +28,7 @@
 
 #define GQ_CACHE_THUMB		"thumbnails"
 #define GQ_CACHE_METADATA    	"metadata"
+#define GQ_CACHE_DIR_LIST	"dirlists"
 
 #define GQ_CACHE_LOCAL_THUMB    ".thumbnails"
 #define GQ_CACHE_LOCAL_METADATA ".metadata"
@@ -53,6 +54,7 @@ struct _CacheData
 	gint height;
 	time_t date;
 	guchar md5sum[16];
+	gchar *checksum;		/* other than MD5, see checksum-util.h */
 	ImageSimilarityData *sim;
 
 	gboolean dimensions;
@@ -73,6 +75,7 @@ CacheData *cache_sim_data_load(const gchar *path);
 void cache_sim_data_set_dimensions(CacheData *cd, gint w, gint h);
 void cache_sim_data_set_date(CacheData *cd, time_t date);
 void cache_sim_data_set_md5sum(CacheData *cd, guchar digest[16]);
+void cache_sim_data_set_checksum(CacheData *cd, const gchar *text);
 void cache_sim_data_set_similarity(CacheData *cd, ImageSimilarityData *sd);
 gint cache_sim_data_filled(ImageSimilarityData *sd);
 
@@ -82,6 +85,7 @@ gchar *cache_find_location(CacheType type, const gchar *source);
 const gchar *get_thumbnails_cache_dir(void);
 const gchar *get_thumbnails_standard_cache_dir(void);
 const gchar *get_metadata_cache_dir(void);
+const gchar *get_dir_list_cache_dir(void);
 
 #endif
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
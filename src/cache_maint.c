@@ -23,8 +23,11 @@
 #include "cache_maint.h"
 
 #include "cache.h"
+#include "cache-db.h"
+#include "cache-dirlist.h"
 #include "filedata.h"
 #include "layout.h"
+#include "misc.h"
 #include "thumb.h"
 #include "thumb_standard.h"
 #include "ui_fileops.h"
@@ -191,7 +194,12 @@ static gboolean cache_maintain_home_cb(gpointer data)
 				dot = extension_find_dot(path_buf);
 
 				if (dot) *dot = '\0';
-				if ((!cm->metadata && cm->clear) ||
+				if (!cm->metadata && strcmp(fd_list->name, GQ_CACHE_SIM_DB) == 0)
+					{
+					/* the database holds the data of a whole directory */
+					if (cache_sim_db_maint(fd_list->path, cm->clear)) still_have_a_file = TRUE;
+					}
+				else if ((!cm->metadata && cm->clear) ||
 				    (strlen(path_buf) > base_length && !isfile(path_buf + base_length)) )
 					{
 					if (dot) *dot = '.';
@@ -290,6 +298,7 @@ void cache_maintain_home(gboolean metadata, gboolean clear, GtkWidget *parent)
 	else
 		{
 		cache_folder = get_thumbnails_cache_dir();
+		cache_dir_list_maint(clear);
 		}
 
 	dir_fd = file_data_new_dir(cache_folder);
@@ -368,6 +377,7 @@ void cache_maintain_home_remote(gboolean metadata, gboolean clear)
 	else
 		{
 		cache_folder = get_thumbnails_cache_dir();
+		cache_dir_list_maint(clear);
 		}
 
 	dir_fd = file_data_new_dir(cache_folder);
@@ -422,11 +432,7 @@ static void cache_maint_moved(FileData *fd)
 		g_free(d);
 		g_free(buf);
 
-		buf = cache_find_location(CACHE_TYPE_SIM, src);
-		d = cache_get_location(CACHE_TYPE_SIM, dest, TRUE, NULL);
-		cache_file_move(buf, d);
-		g_free(d);
-		g_free(buf);
+		cache_sim_db_move(src, dest);
 		}
 	else
 		{
@@ -468,9 +474,7 @@ static void cache_maint_removed(FileData *fd)
 	cache_file_remove(buf);
 	g_free(buf);
 
-	buf = cache_find_location(CACHE_TYPE_SIM, fd->path);
-	cache_file_remove(buf);
-	g_free(buf);
+	cache_sim_db_remove(fd->path);
 
 	buf = cache_find_location(CACHE_TYPE_METADATA, fd->path);
 	cache_file_remove(buf);
@@ -579,18 +583,46 @@ struct _CleanData
 	gboolean remote;
 
 	guint idle_id; /* event source id */
+
+	/* thumbnail rendering */
+	GList *list_render; /* CacheRenderJob, in flight */
+	gint count_skipped;
+	gint count_failed;
+	guint64 bytes_done;
+	gint64 time_start;
 };
 
+typedef struct _CacheRenderJob CacheRenderJob;
+struct _CacheRenderJob
+{
+	CleanData *cd;
+	ThumbLoader *tl;
+	FileData *fd;
+};
+
+static void cache_manager_render_job_free(CacheRenderJob *job)
+{
+	thumb_loader_free(job->tl);
+	file_data_unref(job->fd);
+	g_free(job);
+}
+
 static void cache_manager_render_reset(CleanData *cd)
 {
+	GList *work;
+
 	filelist_free(cd->list);
 	cd->list = NULL;
 
 	filelist_free(cd->list_dir);
 	cd->list_dir = NULL;
 
-	thumb_loader_free((ThumbLoader *)cd->tl);
-	cd->tl = NULL;
+	for (work = cd->list_render; work; work = work->next)
+		{
+		cache_manager_render_job_free(work->data);
+		}
+	g_list_free(cd->list_render);
+	cd->list_render = NULL;
 }
 
 static void cache_manager_render_close_cb(GenericDialog *fd, gpointer data)
@@ -606,7 +638,25 @@ static void cache_manager_render_close_cb(GenericDialog *fd, gpointer data)
 
 static void cache_manager_render_finish(CleanData *cd)
 {
+	gdouble seconds;
+	gchar *text;
+
 	cache_manager_render_reset(cd);
+
+	seconds = (gdouble)(g_get_monotonic_time() - cd->time_start) / G_USEC_PER_SEC;
+	if (seconds <= 0.0) seconds = 1.0 / G_USEC_PER_SEC;
+
+	text = g_strdup_printf(_("done, %d thumbnails created, %d up to date, %d failed, %.1f files/s, %.1f MB/s"),
+			       cd->count_done, cd->count_skipped, cd->count_failed,
+			       cd->count_done / seconds, cd->bytes_done / seconds / 1048576.0);
+	DEBUG_1("render thumbnails: %s in %.1f s", text, seconds);
+
+	if (cd->remote)
+		{
+		log_printf("%s\n", text);
+		}
+	g_free(text);
+
 	if (!cd->remote)
 		{
 		gtk_entry_set_text(GTK_ENTRY(cd->progress), _("done"));
@@ -647,69 +697,136 @@ static void cache_manager_render_folder(CleanData *cd, FileData *dir_fd)
 	cd->list_dir = g_list_concat(list_d, cd->list_dir);
 }
 
+/* read the whole folder tree first, so the work is known before rendering starts */
+static void cache_manager_render_collect(CleanData *cd, FileData *dir_fd)
+{
+	cache_manager_render_folder(cd, dir_fd);
+
+	while (cd->list_dir)
+		{
+		FileData *fd;
+
+		fd = cd->list_dir->data;
+		cd->list_dir = g_list_remove(cd->list_dir, fd);
+
+		cache_manager_render_folder(cd, fd);
+
+		file_data_unref(fd);
+		}
+
+	cd->count_total = g_list_length(cd->list);
+	cd->count_done = 0;
+	cd->count_skipped = 0;
+	cd->count_failed = 0;
+	cd->bytes_done = 0;
+	cd->time_start = g_get_monotonic_time();
+}
+
+gint cache_manager_render_threads(void)
+{
+	return (options->threads.cache_render > 0) ? options->threads.cache_render : get_cpu_cores();
+}
+
+/* checks the thumbnail file dates only, nothing is decoded */
+gboolean cache_manager_render_is_current(FileData *fd, gboolean local)
+{
+	gchar *cache_path;
+	gboolean current;
+
+	if (options->thumbnails.spec_standard)
+		{
+		return thumb_std_thumb_file_is_current(fd->path, options->thumbnails.max_width,
+						       options->thumbnails.max_height, local);
+		}
+
+	cache_path = cache_find_location(CACHE_TYPE_THUMB, fd->path);
+	current = (cache_path && cache_time_valid(cache_path, fd->path));
+	g_free(cache_path);
+
+	return current;
+}
+
 static gboolean cache_manager_render_file(CleanData *cd);
 
-static void cache_manager_render_thumb_done_cb(ThumbLoader *tl, gpointer data)
+static void cache_manager_render_job_finish(CacheRenderJob *job, gboolean success)
 {
-	CleanData *cd = data;
+	CleanData *cd = job->cd;
 
-	thumb_loader_free((ThumbLoader *)cd->tl);
-	cd->tl = NULL;
+	if (success)
+		{
+		cd->count_done++;
+		cd->bytes_done += job->fd->size;
+		}
+	else
+		{
+		cd->count_failed++;
+		}
+
+	cd->list_render = g_list_remove(cd->list_render, job);
+	cache_manager_render_job_free(job);
 
 	while (cache_manager_render_file(cd));
 }
 
-static gboolean cache_manager_render_file(CleanData *cd)
+static void cache_manager_render_thumb_done_cb(ThumbLoader *tl, gpointer data)
 {
-	if (cd->list)
-		{
-		FileData *fd;
-		gint success;
-
-		fd = cd->list->data;
-		cd->list = g_list_remove(cd->list, fd);
-
-		cd->tl = (ThumbLoaderStd *)thumb_loader_new(options->thumbnails.max_width, options->thumbnails.max_height);
-		thumb_loader_set_callbacks((ThumbLoader *)cd->tl,
-					   cache_manager_render_thumb_done_cb,
-					   cache_manager_render_thumb_done_cb,
-					   NULL, cd);
-		thumb_loader_set_cache((ThumbLoader *)cd->tl, TRUE, cd->local, TRUE);
-		success = thumb_loader_start((ThumbLoader *)cd->tl, fd);
-		if (success)
-			{
-			if (!cd->remote)
-				{
-				gtk_entry_set_text(GTK_ENTRY(cd->progress), fd->path);
-				}
-			}
-		else
-			{
-			thumb_loader_free((ThumbLoader *)cd->tl);
-			cd->tl = NULL;
-			}
+	cache_manager_render_job_finish(data, TRUE);
+}
 
-		file_data_unref(fd);
+static void cache_manager_render_thumb_error_cb(ThumbLoader *tl, gpointer data)
+{
+	cache_manager_render_job_finish(data, FALSE);
+}
 
-		return (!success);
-		}
-	else if (cd->list_dir)
+/* starts rendering the next file, returns TRUE if another one can be started now */
+static gboolean cache_manager_render_file(CleanData *cd)
+{
+	FileData *fd;
+	CacheRenderJob *job;
+
+	if (!cd->list)
 		{
-		FileData *fd;
+		if (!cd->list_render) cache_manager_render_finish(cd);
+		return FALSE;
+		}
 
-		fd = cd->list_dir->data;
-		cd->list_dir = g_list_remove(cd->list_dir, fd);
+	if ((gint)g_list_length(cd->list_render) >= cache_manager_render_threads()) return FALSE;
 
-		cache_manager_render_folder(cd, fd);
+	fd = cd->list->data;
+	cd->list = g_list_remove(cd->list, fd);
 
+	if (cache_manager_render_is_current(fd, cd->local))
+		{
+		cd->count_skipped++;
 		file_data_unref(fd);
-
 		return TRUE;
 		}
 
-	cache_manager_render_finish(cd);
+	job = g_new0(CacheRenderJob, 1);
+	job->cd = cd;
+	job->fd = fd;
+	job->tl = thumb_loader_new(options->thumbnails.max_width, options->thumbnails.max_height);
+	thumb_loader_set_callbacks(job->tl,
+				   cache_manager_render_thumb_done_cb,
+				   cache_manager_render_thumb_error_cb,
+				   NULL, job);
+	thumb_loader_set_cache(job->tl, TRUE, cd->local, TRUE);
+
+	if (thumb_loader_start(job->tl, fd))
+		{
+		cd->list_render = g_list_prepend(cd->list_render, job);
+		if (!cd->remote)
+			{
+			gtk_entry_set_text(GTK_ENTRY(cd->progress), fd->path);
+			}
+		}
+	else
+		{
+		cd->count_failed++;
+		cache_manager_render_job_free(job);
+		}
 
-	return FALSE;
+	return TRUE;
 }
 
 static void cache_manager_render_start_cb(GenericDialog *fd, gpointer data)
@@ -751,7 +868,7 @@ static void cache_manager_render_start_cb(GenericDialog *fd, gpointer data)
 			spinner_set_interval(cd->spinner, SPINNER_SPEED);
 			}
 		dir_fd = file_data_new_dir(path);
-		cache_manager_render_folder(cd, dir_fd);
+		cache_manager_render_collect(cd, dir_fd);
 		file_data_unref(dir_fd);
 		while (cache_manager_render_file(cd));
 		}
@@ -775,7 +892,7 @@ static void cache_manager_render_start_render_remote(CleanData *cd, const gchar
 		FileData *dir_fd;
 
 		dir_fd = file_data_new_dir(path);
-		cache_manager_render_folder(cd, dir_fd);
+		cache_manager_render_collect(cd, dir_fd);
 		file_data_unref(dir_fd);
 		while (cache_manager_render_file(cd));
 		}
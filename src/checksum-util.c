@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "checksum-util.h"
+
+#include "md5-util.h"
+#include "ui_fileops.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/* files are read in large blocks, so that reading is not limited by syscalls */
+#define CHECKSUM_READ_SIZE (256 * 1024)
+
+#define CHECKSUM_XXH64_TAG "xxh64:"
+
+/*
+ *-------------------------------------------------------------------
+ * XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ *-------------------------------------------------------------------
+ */
+
+#define XXH64_PRIME_1 G_GUINT64_CONSTANT(0x9E3779B185EBCA87)
+#define XXH64_PRIME_2 G_GUINT64_CONSTANT(0xC2B2AE3D27D4EB4F)
+#define XXH64_PRIME_3 G_GUINT64_CONSTANT(0x165667B19E3779F9)
+#define XXH64_PRIME_4 G_GUINT64_CONSTANT(0x85EBCA77C2B2AE63)
+#define XXH64_PRIME_5 G_GUINT64_CONSTANT(0x27D4EB2F165667C5)
+
+typedef struct _XXH64Context XXH64Context;
+struct _XXH64Context
+{
+	guint64 acc[4];
+	guint64 total_len;
+	guchar buf[32];
+	gsize buf_len;
+};
+
+static inline guint64 xxh64_rotl(guint64 x, gint r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64 xxh64_read64(const guchar *p)
+{
+	guint64 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT64_FROM_LE(v);
+}
+
+static inline guint32 xxh64_read32(const guchar *p)
+{
+	guint32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return GUINT32_FROM_LE(v);
+}
+
+static inline guint64 xxh64_round(guint64 acc, guint64 input)
+{
+	acc += input * XXH64_PRIME_2;
+	acc = xxh64_rotl(acc, 31);
+	return acc * XXH64_PRIME_1;
+}
+
+static inline guint64 xxh64_merge_round(guint64 acc, guint64 val)
+{
+	acc ^= xxh64_round(0, val);
+	return acc * XXH64_PRIME_1 + XXH64_PRIME_4;
+}
+
+static void xxh64_init(XXH64Context *ctx)
+{
+	ctx->acc[0] = XXH64_PRIME_1 + XXH64_PRIME_2;
+	ctx->acc[1] = XXH64_PRIME_2;
+	ctx->acc[2] = 0;
+	ctx->acc[3] = -XXH64_PRIME_1;
+	ctx->total_len = 0;
+	ctx->buf_len = 0;
+}
+
+static void xxh64_stripe(XXH64Context *ctx, const guchar *p)
+{
+	ctx->acc[0] = xxh64_round(ctx->acc[0], xxh64_read64(p));
+	ctx->acc[1] = xxh64_round(ctx->acc[1], xxh64_read64(p + 8));
+	ctx->acc[2] = xxh64_round(ctx->acc[2], xxh64_read64(p + 16));
+	ctx->acc[3] = xxh64_round(ctx->acc[3], xxh64_read64(p + 24));
+}
+
+static void xxh64_update(XXH64Context *ctx, const guchar *buf, gsize len)
+{
+	ctx->total_len += len;
+
+	if (ctx->buf_len > 0)
+		{
+		gsize n = MIN(len, sizeof(ctx->buf) - ctx->buf_len);
+
+		memcpy(ctx->buf + ctx->buf_len, buf, n);
+		ctx->buf_len += n;
+		buf += n;
+		len -= n;
+
+		if (ctx->buf_len < sizeof(ctx->buf)) return;
+
+		xxh64_stripe(ctx, ctx->buf);
+		ctx->buf_len = 0;
+		}
+
+	while (len >= 32)
+		{
+		xxh64_stripe(ctx, buf);
+		buf += 32;
+		len -= 32;
+		}
+
+	memcpy(ctx->buf, buf, len);
+	ctx->buf_len = len;
+}
+
+static guint64 xxh64_final(XXH64Context *ctx)
+{
+	const guchar *p = ctx->buf;
+	gsize len = ctx->buf_len;
+	guint64 h;
+
+	if (ctx->total_len >= 32)
+		{
+		h = xxh64_rotl(ctx->acc[0], 1) + xxh64_rotl(ctx->acc[1], 7) +
+		    xxh64_rotl(ctx->acc[2], 12) + xxh64_rotl(ctx->acc[3], 18);
+		h = xxh64_merge_round(h, ctx->acc[0]);
+		h = xxh64_merge_round(h, ctx->acc[1]);
+		h = xxh64_merge_round(h, ctx->acc[2]);
+		h = xxh64_merge_round(h, ctx->acc[3]);
+		}
+	else
+		{
+		h = XXH64_PRIME_5;
+		}
+
+	h += ctx->total_len;
+
+	while (len >= 8)
+		{
+		h ^= xxh64_round(0, xxh64_read64(p));
+		h = xxh64_rotl(h, 27) * XXH64_PRIME_1 + XXH64_PRIME_4;
+		p += 8;
+		len -= 8;
+		}
+	if (len >= 4)
+		{
+		h ^= (guint64)xxh64_read32(p) * XXH64_PRIME_1;
+		h = xxh64_rotl(h, 23) * XXH64_PRIME_2 + XXH64_PRIME_3;
+		p += 4;
+		len -= 4;
+		}
+	while (len > 0)
+		{
+		h ^= (guint64)(*p) * XXH64_PRIME_5;
+		h = xxh64_rotl(h, 11) * XXH64_PRIME_1;
+		p++;
+		len--;
+		}
+
+	h ^= h >> 33;
+	h *= XXH64_PRIME_2;
+	h ^= h >> 29;
+	h *= XXH64_PRIME_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/*
+ *-------------------------------------------------------------------
+ * checksum
+ *-------------------------------------------------------------------
+ */
+
+struct _ChecksumContext
+{
+	ChecksumType type;
+	union {
+		MD5Context md5;
+		XXH64Context xxh64;
+	} ctx;
+};
+
+ChecksumContext *checksum_new(ChecksumType type)
+{
+	ChecksumContext *ctx;
+
+	ctx = g_new0(ChecksumContext, 1);
+	ctx->type = type;
+
+	switch (type)
+		{
+		case CHECKSUM_XXH64:
+			xxh64_init(&ctx->ctx.xxh64);
+			break;
+		case CHECKSUM_MD5:
+		default:
+			ctx->type = CHECKSUM_MD5;
+			md5_init(&ctx->ctx.md5);
+			break;
+		}
+
+	return ctx;
+}
+
+void checksum_update(ChecksumContext *ctx, const guchar *buf, gsize len)
+{
+	switch (ctx->type)
+		{
+		case CHECKSUM_XXH64:
+			xxh64_update(&ctx->ctx.xxh64, buf, len);
+			break;
+		case CHECKSUM_MD5:
+		default:
+			while (len > 0)
+				{
+				guint32 n = (guint32)MIN(len, G_MAXUINT32);
+
+				md5_update(&ctx->ctx.md5, buf, n);
+				buf += n;
+				len -= n;
+				}
+			break;
+		}
+}
+
+gchar *checksum_finish_text(ChecksumContext *ctx)
+{
+	gchar *text;
+
+	switch (ctx->type)
+		{
+		case CHECKSUM_XXH64:
+			text = g_strdup_printf(CHECKSUM_XXH64_TAG "%016" G_GINT64_MODIFIER "x", xxh64_final(&ctx->ctx.xxh64));
+			break;
+		case CHECKSUM_MD5:
+		default:
+			{
+			guchar digest[16];
+
+			md5_final(&ctx->ctx.md5, digest);
+			text = md5_digest_to_text(digest);
+			}
+			break;
+		}
+
+	g_free(ctx);
+
+	return text;
+}
+
+gchar *checksum_text_from_file_utf8(ChecksumType type, const gchar *path, const gchar *error_text)
+{
+	ChecksumContext *ctx;
+	guchar *buf;
+	gchar *pathl;
+	FILE *fp;
+	gsize n;
+	gboolean success;
+
+	pathl = path_from_utf8(path);
+	fp = fopen(pathl, "rb");
+	g_free(pathl);
+	if (!fp) return g_strdup(error_text);
+
+	ctx = checksum_new(type);
+	buf = g_malloc(CHECKSUM_READ_SIZE);
+
+	while ((n = fread(buf, 1, CHECKSUM_READ_SIZE, fp)) > 0)
+		{
+		checksum_update(ctx, buf, n);
+		}
+
+	success = (ferror(fp) == 0);
+	fclose(fp);
+	g_free(buf);
+
+	if (!success)
+		{
+		g_free(checksum_finish_text(ctx));
+		return g_strdup(error_text);
+		}
+
+	return checksum_finish_text(ctx);
+}
+
+gboolean checksum_text_is_type(const gchar *text, ChecksumType type)
+{
+	if (!text) return FALSE;
+
+	switch (type)
+		{
+		case CHECKSUM_XXH64:
+			return g_str_has_prefix(text, CHECKSUM_XXH64_TAG);
+		case CHECKSUM_MD5:
+		default:
+			return (strlen(text) == 32 && !strchr(text, ':'));
+		}
+}
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CHECKSUM_UTIL_H
+#define CHECKSUM_UTIL_H
+
+#include <glib.h>
+
+
+/* file content checksums, the text of a checksum is tagged with its type,
+ * except for MD5 which is the plain 32 character digest for compatibility
+ */
+typedef enum {
+	CHECKSUM_MD5,		/* cryptographic, slow */
+	CHECKSUM_XXH64		/* non-cryptographic, fast */
+} ChecksumType;
+
+typedef struct _ChecksumContext ChecksumContext;
+
+ChecksumContext *checksum_new(ChecksumType type);
+void checksum_update(ChecksumContext *ctx, const guchar *buf, gsize len);
+/* frees ctx */
+gchar *checksum_finish_text(ChecksumContext *ctx);
+
+gchar *checksum_text_from_file_utf8(ChecksumType type, const gchar *path, const gchar *error_text);
+
+/* returns TRUE if text is a checksum of type */
+gboolean checksum_text_is_type(const gchar *text, ChecksumType type);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
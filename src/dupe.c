@@ -23,6 +23,7 @@
 #include "dupe.h"
 
 #include "cache.h"
+#include "cache-db.h"
 #include "collect.h"
 #include "collect-table.h"
 #include "dnd.h"
@@ -56,6 +57,12 @@
 #define DUPE_DEF_WIDTH 800
 #define DUPE_DEF_HEIGHT 400
 
+/* similarity data is only a 32x32 grid, images are decoded at reduced size */
+#define DUPE_SIM_LOAD_SIZE 256
+
+/* bytes read at the start and at the end of a file for the partial checksum */
+#define DUPE_SUM_PARTIAL_SIZE 65536
+
 /* column assignment order (simply change them here) */
 enum {
 	DUPE_COLUMN_POINTER = 0,
@@ -73,6 +80,10 @@ enum {
 
 static GList *dupe_window_list = NULL;	/* list of open DupeWindow *s */
 
+#ifdef HAVE_GTHREAD
+static GThreadPool *dupe_sim_thread_pool = NULL;
+#endif
+
 /*
  * Well, after adding the 'compare two sets' option things got a little sloppy in here
  * because we have to account for two 'modes' everywhere. (be careful).
@@ -81,7 +92,7 @@ static GList *dupe_window_list = NULL;	/* list of open DupeWindow *s */
 static void dupe_match_unlink(DupeItem *a, DupeItem *b);
 static DupeItem *dupe_match_find_parent(DupeWindow *dw, DupeItem *child);
 
-static gint dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble *rank, gint fast);
+static gint dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble *rank, gint fast, gboolean read_only);
 
 static void dupe_thumb_step(DupeWindow *dw);
 static gint dupe_check_cb(gpointer data);
@@ -307,7 +318,8 @@ static void dupe_item_free(DupeItem *di)
 {
 	file_data_unref(di->fd);
 	image_sim_free(di->simd);
-	g_free(di->md5sum);
+	g_free(di->checksum);
+	g_free(di->partial_checksum);
 	if (di->pixbuf) g_object_unref(di->pixbuf);
 
 	g_free(di);
@@ -385,22 +397,11 @@ static DupeItem *dupe_item_find_path(DupeWindow *dw, const gchar *path)
 
 static void dupe_item_read_cache(DupeItem *di)
 {
-	gchar *path;
 	CacheData *cd;
 
 	if (!di) return;
 
-	path = cache_find_location(CACHE_TYPE_SIM, di->fd->path);
-	if (!path) return;
-
-	if (filetime(di->fd->path) != filetime(path))
-		{
-		g_free(path);
-		return;
-		}
-
-	cd = cache_sim_data_load(path);
-	g_free(path);
+	cd = cache_sim_db_load(di->fd->path);
 
 	if (cd)
 		{
@@ -414,9 +415,17 @@ static void dupe_item_read_cache(DupeItem *di)
 			di->width = cd->width;
 			di->height = cd->height;
 			}
-		if (!di->md5sum && cd->have_md5sum)
+		if (!di->checksum)
 			{
-			di->md5sum = md5_digest_to_text(cd->md5sum);
+			if (options->duplicates_checksum == CHECKSUM_MD5 && cd->have_md5sum)
+				{
+				di->checksum = md5_digest_to_text(cd->md5sum);
+				}
+			else if (checksum_text_is_type(cd->checksum, options->duplicates_checksum))
+				{
+				di->checksum = cd->checksum;
+				cd->checksum = NULL;
+				}
 			}
 		cache_sim_data_free(cd);
 		}
@@ -424,34 +433,79 @@ static void dupe_item_read_cache(DupeItem *di)
 
 static void dupe_item_write_cache(DupeItem *di)
 {
-	gchar *base;
-	mode_t mode = 0755;
+	CacheData *cd;
 
 	if (!di) return;
 
-	base = cache_get_location(CACHE_TYPE_SIM, di->fd->path, FALSE, &mode);
-	if (recursive_mkdir_if_not_exists(base, mode))
+	cd = cache_sim_data_new();
+
+	if (di->width != 0) cache_sim_data_set_dimensions(cd, di->width, di->height);
+	if (checksum_text_is_type(di->checksum, CHECKSUM_MD5))
 		{
-		CacheData *cd;
+		guchar digest[16];
+		if (md5_digest_from_text(di->checksum, digest)) cache_sim_data_set_md5sum(cd, digest);
+		}
+	else if (di->checksum && di->checksum[0] != '\0')
+		{
+		cache_sim_data_set_checksum(cd, di->checksum);
+		}
+	if (di->simd) cache_sim_data_set_similarity(cd, di->simd);
 
-		cd = cache_sim_data_new();
-		cd->path = cache_get_location(CACHE_TYPE_SIM, di->fd->path, TRUE, NULL);
+	cache_sim_db_save(di->fd->path, cd);
+	cache_sim_data_free(cd);
+}
 
-		if (di->width != 0) cache_sim_data_set_dimensions(cd, di->width, di->height);
-		if (di->md5sum)
-			{
-			guchar digest[16];
-			if (md5_digest_from_text(di->md5sum, digest)) cache_sim_data_set_md5sum(cd, digest);
-			}
-		if (di->simd) cache_sim_data_set_similarity(cd, di->simd);
+/* reads the partial checksum, or the checksum if the file is not larger than the
+ * partial blocks. On a read error the checksum is set to the empty string, as
+ * checksum_text_from_file_utf8() does, so the item does not match.
+ */
+static void dupe_item_read_partial_checksum(DupeItem *di)
+{
+	ChecksumContext *ctx;
+	guchar *buf;
+	gchar *pathl;
+	FILE *fp;
+	gsize n;
+	gboolean success;
 
-		if (cache_sim_data_save(cd))
-			{
-			filetime_set(cd->path, filetime(di->fd->path));
-			}
-		cache_sim_data_free(cd);
+	if (di->fd->size <= 2 * DUPE_SUM_PARTIAL_SIZE)
+		{
+		di->checksum = checksum_text_from_file_utf8(options->duplicates_checksum, di->fd->path, "");
+		return;
+		}
+
+	pathl = path_from_utf8(di->fd->path);
+	fp = fopen(pathl, "rb");
+	g_free(pathl);
+	if (!fp)
+		{
+		di->checksum = g_strdup("");
+		return;
+		}
+
+	buf = g_malloc(DUPE_SUM_PARTIAL_SIZE);
+	ctx = checksum_new(options->duplicates_checksum);
+
+	n = fread(buf, 1, DUPE_SUM_PARTIAL_SIZE, fp);
+	checksum_update(ctx, buf, n);
+	success = (n == DUPE_SUM_PARTIAL_SIZE && fseek(fp, -DUPE_SUM_PARTIAL_SIZE, SEEK_END) == 0);
+	if (success)
+		{
+		n = fread(buf, 1, DUPE_SUM_PARTIAL_SIZE, fp);
+		checksum_update(ctx, buf, n);
+		success = (n == DUPE_SUM_PARTIAL_SIZE);
+		}
+
+	fclose(fp);
+	g_free(buf);
+
+	di->partial_checksum = checksum_finish_text(ctx);
+	if (!success)
+		{
+		g_free(di->partial_checksum);
+		di->partial_checksum = NULL;
+		di->checksum = g_strdup("");
 		}
-	g_free(base);
 }
 
 /*
@@ -990,7 +1044,7 @@ static GList *dupe_match_unlink_by_rank(DupeItem *child, DupeItem *parent, GList
 				dupe_match_link_clear(orphan, TRUE);
 				if (!dw->second_set || orphan->second)
 					{
-					dupe_match(orphan, child, dw->match_mask, &rank, FALSE);
+					dupe_match(orphan, child, dw->match_mask, &rank, FALSE, FALSE);
 					dupe_match_link(orphan, child, rank);
 					}
 				list = g_list_remove(list, orphan);
@@ -1157,7 +1211,21 @@ static void dupe_match_rank(DupeWindow *dw)
  * ------------------------------------------------------------------
  */
 
-static gboolean dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble *rank, gint fast)
+/* returns the minimum similarity for mask, 0.0 if mask does not compare similarity */
+static gdouble dupe_match_sim_threshold(DupeMatchType mask)
+{
+	if (mask & DUPE_MATCH_SIM_HIGH) return 0.95;
+	if (mask & DUPE_MATCH_SIM_MED) return 0.90;
+	if (mask & DUPE_MATCH_SIM_CUSTOM) return (gdouble)options->duplicates_similarity_threshold / 100.0;
+	if (mask & DUPE_MATCH_SIM_LOW) return 0.85;
+
+	return 0.0;
+}
+
+/* with read_only set the items are not modified, as needed in the comparison threads:
+ * a checksum or the dimensions not read during the setup do not match
+ */
+static gboolean dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble *rank, gint fast, gboolean read_only)
 {
 	*rank = 0.0;
 
@@ -1185,16 +1253,25 @@ static gboolean dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble
 		}
 	if (mask & DUPE_MATCH_SUM)
 		{
-		if (!a->md5sum) a->md5sum = md5_text_from_file_utf8(a->fd->path, "");
-		if (!b->md5sum) b->md5sum = md5_text_from_file_utf8(b->fd->path, "");
-		if (a->md5sum[0] == '\0' ||
-		    b->md5sum[0] == '\0' ||
-		    strcmp(a->md5sum, b->md5sum) != 0) return FALSE;
+		if (a->fd->size != b->fd->size) return FALSE;
+		if ((a->checksum && a->checksum[0] == '\0') ||
+		    (b->checksum && b->checksum[0] == '\0')) return FALSE;
+		if (a->partial_checksum && b->partial_checksum &&
+		    strcmp(a->partial_checksum, b->partial_checksum) != 0) return FALSE;
+		if (read_only && (!a->checksum || !b->checksum)) return FALSE;
+		if (!a->checksum) a->checksum = checksum_text_from_file_utf8(options->duplicates_checksum, a->fd->path, "");
+		if (!b->checksum) b->checksum = checksum_text_from_file_utf8(options->duplicates_checksum, b->fd->path, "");
+		if (a->checksum[0] == '\0' ||
+		    b->checksum[0] == '\0' ||
+		    strcmp(a->checksum, b->checksum) != 0) return FALSE;
 		}
 	if (mask & DUPE_MATCH_DIM)
 		{
-		if (a->width == 0) image_load_dimensions(a->fd, &a->width, &a->height);
-		if (b->width == 0) image_load_dimensions(b->fd, &b->width, &b->height);
+		if (!read_only)
+			{
+			if (a->width == 0) image_load_dimensions(a->fd, &a->width, &a->height);
+			if (b->width == 0) image_load_dimensions(b->fd, &b->width, &b->height);
+			}
 		if (a->width != b->width || a->height != b->height) return FALSE;
 		}
 	if (mask & DUPE_MATCH_SIM_HIGH ||
@@ -1203,12 +1280,7 @@ static gboolean dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble
 	    mask & DUPE_MATCH_SIM_CUSTOM)
 		{
 		gdouble f;
-		gdouble m;
-
-		if (mask & DUPE_MATCH_SIM_HIGH) m = 0.95;
-		else if (mask & DUPE_MATCH_SIM_MED) m = 0.90;
-		else if (mask & DUPE_MATCH_SIM_CUSTOM) m = (gdouble)options->duplicates_similarity_threshold / 100.0;
-		else m = 0.85;
+		gdouble m = dupe_match_sim_threshold(mask);
 
 		if (fast)
 			{
@@ -1229,43 +1301,314 @@ static gboolean dupe_match(DupeItem *a, DupeItem *b, DupeMatchType mask, gdouble
 	return TRUE;
 }
 
-static void dupe_list_check_match(DupeWindow *dw, DupeItem *needle, GList *start)
+/*
+ * ------------------------------------------------------------------
+ * Comparison engine
+ * ------------------------------------------------------------------
+ */
+
+/* The needles are split into blocks of roughly DUPE_COMPARE_BLOCK_PAIRS
+ * comparisons, each block is compared by a thread of the pool. The matches
+ * are linked in the main thread in block order, so the result does not
+ * depend on the order in which the threads finish.
+ *
+ * For a similarity match the compared items are indexed by their
+ * similarity data, each needle is only compared with the candidates
+ * returned by the index instead of all items.
+ */
+
+#define DUPE_COMPARE_BLOCK_PAIRS 32768
+
+typedef struct _DupeCompareMatch DupeCompareMatch;
+struct _DupeCompareMatch
+{
+	DupeItem *a;
+	DupeItem *b;
+	gdouble rank;
+};
+
+typedef struct _DupeCompareBlock DupeCompareBlock;
+struct _DupeCompareBlock
+{
+	DupeCompare *dc;
+
+	gint start;			/* range of needles */
+	gint end;
+
+	GArray *matches;		/* DupeCompareMatch, filled by the thread */
+	gboolean finished;		/* main thread only */
+};
+
+struct _DupeCompare
+{
+	gint ref;
+	DupeWindow *dw;			/* NULL if the comparison was cancelled */
+
+	DupeItem **needles;		/* reverse order of dw->list */
+	gint needle_count;
+	DupeItem **haystack;		/* second set, NULL for a simple compare */
+	gint haystack_count;
+	DupeMatchType mask;
+
+	ImageSimilarityIndex *index;	/* of haystack, or of needles for a simple compare, NULL if not used */
+	gdouble sim_min;
+
+	DupeCompareBlock *blocks;
+	gint block_count;
+	gint block_merged;
+
+	GThreadPool *pool;
+};
+
+static void dupe_compare_unref(DupeCompare *dc)
+{
+	gint i;
+
+	if (!g_atomic_int_dec_and_test(&dc->ref)) return;
+
+	if (dc->pool) g_thread_pool_free(dc->pool, FALSE, TRUE);
+
+	for (i = 0; i < dc->block_count; i++)
+		{
+		if (dc->blocks[i].matches) g_array_free(dc->blocks[i].matches, TRUE);
+		}
+	image_sim_index_free(dc->index);
+	g_free(dc->blocks);
+	g_free(dc->needles);
+	g_free(dc->haystack);
+	g_free(dc);
+}
+
+static void dupe_compare_pair(DupeCompareBlock *block, DupeItem *a, DupeItem *b)
 {
-	GList *work;
+	DupeCompareMatch match;
 
-	if (dw->second_set)
+	if (dupe_match(a, b, block->dc->mask, &match.rank, TRUE, TRUE))
 		{
-		work = dw->second_list;
+		match.a = a;
+		match.b = b;
+		g_array_append_val(block->matches, match);
 		}
-	else if (start)
+}
+
+/* this function may be executed in a separate thread */
+static void dupe_compare_block_run(DupeCompareBlock *block)
+{
+	DupeCompare *dc = block->dc;
+	GArray *found = NULL;
+	gint i;
+	gint j;
+
+	block->matches = g_array_new(FALSE, FALSE, sizeof(DupeCompareMatch));
+	if (dc->index) found = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	for (i = block->start; i < block->end; i++)
 		{
-		work = start;
+		DupeItem *needle = dc->needles[i];
+
+		if (found)
+			{
+			guint n;
+
+			/* candidates are sorted, same order as the full compare */
+			image_sim_index_find(dc->index, needle->simd, dc->sim_min, found);
+			for (n = 0; n < found->len; n++)
+				{
+				j = g_array_index(found, gint, n);
+				if (dc->haystack)
+					{
+					dupe_compare_pair(block, dc->haystack[j], needle);
+					}
+				else if (j >= i)
+					{
+					dupe_compare_pair(block, dc->needles[j], needle);
+					}
+				}
+			}
+		else if (dc->haystack)
+			{
+			for (j = 0; j < dc->haystack_count; j++)
+				{
+				dupe_compare_pair(block, dc->haystack[j], needle);
+				}
+			}
+		else
+			{
+			/* the needle itself and all items before it in dw->list */
+			for (j = i; j < dc->needle_count; j++)
+				{
+				dupe_compare_pair(block, dc->needles[j], needle);
+				}
+			}
 		}
-	else
+
+	if (found) g_array_free(found, TRUE);
+}
+
+static gboolean dupe_compare_block_done_cb(gpointer data)
+{
+	DupeCompareBlock *block = data;
+	DupeCompare *dc = block->dc;
+	DupeWindow *dw = dc->dw;
+
+	block->finished = TRUE;
+
+	if (dw)
 		{
-		work = g_list_last(dw->list);
+		while (dc->block_merged < dc->block_count && dc->blocks[dc->block_merged].finished)
+			{
+			DupeCompareBlock *merge = &dc->blocks[dc->block_merged];
+			guint i;
+
+			for (i = 0; i < merge->matches->len; i++)
+				{
+				DupeCompareMatch *match = &g_array_index(merge->matches, DupeCompareMatch, i);
+
+				if (!dupe_match_link_exists(match->b, match->a))
+					{
+					dupe_match_link(match->a, match->b, match->rank);
+					}
+				}
+
+			dw->setup_n += merge->end - merge->start;
+			dc->block_merged++;
+			}
+
+		dupe_window_update_progress(dw, _("Comparing..."), dw->setup_count == 0 ? 0.0 : (gdouble) dw->setup_n / dw->setup_count, FALSE);
+
+		if (dc->block_merged == dc->block_count)
+			{
+			dw->compare = NULL;
+			dw->working = NULL;
+			dupe_compare_unref(dc);
+
+			if (!dw->idle_id) dw->idle_id = g_idle_add(dupe_check_cb, dw);
+			}
 		}
 
+	dupe_compare_unref(dc);
+
+	return FALSE;
+}
+
+#ifdef HAVE_GTHREAD
+static void dupe_compare_thread_run(gpointer data, gpointer user_data)
+{
+	DupeCompareBlock *block = data;
+
+	dupe_compare_block_run(block);
+
+	g_atomic_int_inc(&block->dc->ref);
+	g_idle_add(dupe_compare_block_done_cb, block);
+}
+#endif
+
+static void dupe_compare_start(DupeWindow *dw)
+{
+	DupeCompare *dc;
+	GList *work;
+	gint i;
+
+	dc = g_new0(DupeCompare, 1);
+	dc->ref = 1;
+	dc->dw = dw;
+	dc->mask = dw->match_mask;
+
+	dc->needles = g_new(DupeItem *, g_list_length(dw->list));
+	work = dw->working;
 	while (work)
 		{
-		DupeItem *di = work->data;
+		dc->needles[dc->needle_count++] = work->data;
+		work = work->prev;
+		}
 
-		/* speed opt: forward for second set, back for simple compare */
-		if (dw->second_set)
+	if (dw->second_set)
+		{
+		dc->haystack = g_new(DupeItem *, g_list_length(dw->second_list) + 1);
+		work = dw->second_list;
+		while (work)
+			{
+			dc->haystack[dc->haystack_count++] = work->data;
 			work = work->next;
-		else
-			work = work->prev;
+			}
+		}
+
+	dc->sim_min = dupe_match_sim_threshold(dc->mask);
+	if (dc->sim_min > 0.0)
+		{
+		DupeItem **items = dc->haystack ? dc->haystack : dc->needles;
+		gint count = dc->haystack ? dc->haystack_count : dc->needle_count;
+		ImageSimilarityData **data;
 
-		if (!dupe_match_link_exists(needle, di))
+		data = g_new(ImageSimilarityData *, count + 1);
+		for (i = 0; i < count; i++)
 			{
-			gdouble rank;
+			data[i] = items[i]->simd;
+			}
+		dc->index = image_sim_index_new(data, count);
+		g_free(data);
+		}
 
-			if (dupe_match(di, needle, dw->match_mask, &rank, TRUE))
-				{
-				dupe_match_link(di, needle, rank);
-				}
+	dc->blocks = g_new0(DupeCompareBlock, dc->needle_count);
+	i = 0;
+	while (i < dc->needle_count)
+		{
+		DupeCompareBlock *block = &dc->blocks[dc->block_count++];
+		gint pairs = 0;
+
+		block->dc = dc;
+		block->start = i;
+		while (i < dc->needle_count && pairs < DUPE_COMPARE_BLOCK_PAIRS)
+			{
+			pairs += dc->haystack ? dc->haystack_count : dc->needle_count - i;
+			i++;
 			}
+		block->end = i;
 		}
+
+	DEBUG_1("Comparing %d items in %d blocks", dc->needle_count, dc->block_count);
+
+#ifdef HAVE_GTHREAD
+	/* the checksums and dimensions of all candidates were read during the setup,
+	 * the threads only compare them
+	 */
+	dc->pool = g_thread_pool_new(dupe_compare_thread_run, NULL, dw->sim_jobs_max, FALSE, NULL);
+	for (i = 0; i < dc->block_count; i++)
+		{
+		g_thread_pool_push(dc->pool, &dc->blocks[i], NULL);
+		}
+#endif
+
+	dw->compare = dc;
+}
+
+#ifndef HAVE_GTHREAD
+static void dupe_compare_step(DupeWindow *dw)
+{
+	DupeCompare *dc = dw->compare;
+	DupeCompareBlock *block = &dc->blocks[dc->block_merged];
+
+	dupe_compare_block_run(block);
+
+	dc->ref++;
+	dupe_compare_block_done_cb(block);
+}
+#endif
+
+static void dupe_compare_cancel(DupeWindow *dw)
+{
+	DupeCompare *dc = dw->compare;
+
+	if (!dc) return;
+
+	dw->compare = NULL;
+	dc->dw = NULL;
+
+	/* drop the blocks not started yet, wait for the running ones */
+	if (dc->pool) g_thread_pool_free(dc->pool, TRUE, TRUE);
+	dc->pool = NULL;
+
+	dupe_compare_unref(dc);
 }
 
 /*
@@ -1384,17 +1727,204 @@ static void dupe_thumb_step(DupeWindow *dw)
 		}
 }
 
+/*
+ * ------------------------------------------------------------------
+ * Similarity data jobs
+ * ------------------------------------------------------------------
+ */
+
+/* The image is decoded by the image loader thread, the similarity data
+ * is computed by dupe_sim_thread_pool, both results are merged into the
+ * DupeItem in the main thread. At most dw->sim_jobs_max are in progress.
+ */
+
+typedef struct _DupeSimJob DupeSimJob;
+struct _DupeSimJob
+{
+	DupeWindow *dw;			/* NULL if the job was cancelled */
+	DupeItem *di;
+
+	ImageLoader *il;		/* NULL after the image is loaded */
+	GdkPixbuf *pixbuf;
+	gint width;			/* 0 if the image was loaded at reduced size */
+	gint height;
+
+	ImageSimilarityData *simd;
+};
+
+static void dupe_sim_job_free(DupeSimJob *job)
+{
+	image_loader_free(job->il);
+	if (job->pixbuf) g_object_unref(job->pixbuf);
+	image_sim_free(job->simd);
+	g_free(job);
+}
+
+static gboolean dupe_sim_job_done_cb(gpointer data)
+{
+	DupeSimJob *job = data;
+	DupeWindow *dw = job->dw;
+
+	if (dw)
+		{
+		DupeItem *di = job->di;
+
+		dw->sim_jobs = g_list_remove(dw->sim_jobs, job);
+
+		image_sim_free(di->simd);
+		di->simd = job->simd;
+		job->simd = NULL;
+
+		if (di->width == 0 && di->height == 0 && job->width > 0)
+			{
+			di->width = job->width;
+			di->height = job->height;
+			}
+		if (options->thumbnails.enable_caching)
+			{
+			dupe_item_write_cache(di);
+			}
+
+		image_sim_alternate_processing(di->simd);
+
+		if (!dw->idle_id) dw->idle_id = g_idle_add(dupe_check_cb, dw);
+		}
+
+	dupe_sim_job_free(job);
+
+	return FALSE;
+}
+
+#ifdef HAVE_GTHREAD
+static void dupe_sim_job_thread_run(gpointer data, gpointer user_data)
+{
+	DupeSimJob *job = data;
+
+	job->simd = image_sim_new_from_pixbuf(job->pixbuf);
+
+	g_idle_add(dupe_sim_job_done_cb, job);
+}
+#endif
+
+static void dupe_sim_job_loader_done_cb(ImageLoader *il, gpointer data)
+{
+	DupeSimJob *job = data;
+	GdkPixbuf *pixbuf;
+
+	pixbuf = image_loader_get_pixbuf(il);
+	if (pixbuf)
+		{
+		job->pixbuf = g_object_ref(pixbuf);
+		if (!image_loader_get_shrunk(il))
+			{
+			job->width = gdk_pixbuf_get_width(pixbuf);
+			job->height = gdk_pixbuf_get_height(pixbuf);
+			}
+		}
+
+	image_loader_free(job->il);
+	job->il = NULL;
+
+#ifdef HAVE_GTHREAD
+	g_thread_pool_push(dupe_sim_thread_pool, job, NULL);
+#else
+	job->simd = image_sim_new_from_pixbuf(job->pixbuf);
+	dupe_sim_job_done_cb(job);
+#endif
+}
+
+static gboolean dupe_sim_job_start(DupeWindow *dw, DupeItem *di)
+{
+	DupeSimJob *job;
+
+	job = g_new0(DupeSimJob, 1);
+	job->dw = dw;
+	job->di = di;
+
+	job->il = image_loader_new(di->fd);
+	image_loader_set_buffer_size(job->il, 8);
+	image_loader_set_requested_size(job->il, DUPE_SIM_LOAD_SIZE, DUPE_SIM_LOAD_SIZE);
+	g_signal_connect(G_OBJECT(job->il), "error", (GCallback)dupe_sim_job_loader_done_cb, job);
+	g_signal_connect(G_OBJECT(job->il), "done", (GCallback)dupe_sim_job_loader_done_cb, job);
+
+	if (!image_loader_start(job->il))
+		{
+		dupe_sim_job_free(job);
+		return FALSE;
+		}
+
+	dw->sim_jobs = g_list_prepend(dw->sim_jobs, job);
+
+	return TRUE;
+}
+
+/* cancels the jobs of di, or all jobs if di is NULL, returns TRUE if any was found */
+static gboolean dupe_sim_job_cancel(DupeWindow *dw, DupeItem *di)
+{
+	GList *work;
+	gboolean found = FALSE;
+
+	work = dw->sim_jobs;
+	while (work)
+		{
+		DupeSimJob *job = work->data;
+		work = work->next;
+
+		if (di && job->di != di) continue;
+
+		dw->sim_jobs = g_list_remove(dw->sim_jobs, job);
+		found = TRUE;
+
+		if (job->il)
+			{
+			dupe_sim_job_free(job);
+			}
+		else
+			{
+			/* still computed by a thread, freed by dupe_sim_job_done_cb() */
+			job->dw = NULL;
+			}
+		}
+
+	return found;
+}
+
+static void dupe_sim_job_setup(DupeWindow *dw)
+{
+	dw->sim_jobs_max = (options->threads.duplicates > 0) ? options->threads.duplicates : get_cpu_cores();
+	if (dw->sim_jobs_max < 1) dw->sim_jobs_max = 1;
+
+#ifdef HAVE_GTHREAD
+	if (!dupe_sim_thread_pool)
+		{
+		dupe_sim_thread_pool = g_thread_pool_new(dupe_sim_job_thread_run, NULL, dw->sim_jobs_max, FALSE, NULL);
+		}
+	else
+		{
+		g_thread_pool_set_max_threads(dupe_sim_thread_pool, dw->sim_jobs_max, NULL);
+		}
+#endif
+}
+
 /*
  * ------------------------------------------------------------------
  * Dupe checking loop
  * ------------------------------------------------------------------
  */
 
+static void dupe_sum_reset(DupeWindow *dw)
+{
+	g_list_free(dw->sum_list);
+	dw->sum_list = NULL;
+	dw->sum_count = 0;
+	dw->sum_stage = 0;
+}
+
 static void dupe_check_stop(DupeWindow *dw)
 {
-	if (dw->idle_id || dw->img_loader || dw->thumb_loader)
+	if (dw->idle_id || dw->sim_jobs || dw->compare || dw->thumb_loader)
 		{
-		g_source_remove(dw->idle_id);
+		if (dw->idle_id) g_source_remove(dw->idle_id);
 		dw->idle_id = 0;
 		dupe_window_update_progress(dw, NULL, 0.0, FALSE);
 		widget_set_cursor(dw->listview, -1);
@@ -1403,55 +1933,201 @@ static void dupe_check_stop(DupeWindow *dw)
 	thumb_loader_free(dw->thumb_loader);
 	dw->thumb_loader = NULL;
 
-	image_loader_free(dw->img_loader);
-	dw->img_loader = NULL;
+	dupe_sim_job_cancel(dw, NULL);
+	dupe_compare_cancel(dw);
+	dupe_sum_reset(dw);
 }
 
-static void dupe_loader_done_cb(ImageLoader *il, gpointer data)
+static void dupe_setup_reset(DupeWindow *dw)
 {
-	DupeWindow *dw = data;
-	GdkPixbuf *pixbuf;
+	dw->setup_point = NULL;
+	dw->setup_n = 0;
+	dw->setup_time = msec_time();
+	dw->setup_time_count = 0;
+}
 
-	pixbuf = image_loader_get_pixbuf(il);
+/*
+ * The checksum is only read for the items that can match: first the items are
+ * grouped by file size, then the partial checksum is read for the items that
+ * share their size, and the checksum only for those that share both.
+ */
+
+static gint dupe_sum_size_sort_cb(gconstpointer a, gconstpointer b)
+{
+	const DupeItem *da = a;
+	const DupeItem *db = b;
 
-	if (dw->setup_point)
+	if (da->fd->size < db->fd->size) return -1;
+	if (da->fd->size > db->fd->size) return 1;
+	return 0;
+}
+
+/* sorts by size, then by partial checksum with the items without one first */
+static gint dupe_sum_partial_sort_cb(gconstpointer a, gconstpointer b)
+{
+	const DupeItem *da = a;
+	const DupeItem *db = b;
+
+	if (da->fd->size < db->fd->size) return -1;
+	if (da->fd->size > db->fd->size) return 1;
+	return g_strcmp0(da->partial_checksum, db->partial_checksum);
+}
+
+/* keeps the items of list selected by keep, list is sorted by size and keep
+ * is given each group of items of the same size, from start up to end
+ */
+static GList *dupe_sum_filter(GList *list, GList *(*keep)(GList *start, GList *end, GList *result))
+{
+	GList *result = NULL;
+	GList *start = list;
+
+	while (start)
 		{
-		DupeItem *di = dw->setup_point->data;
+		DupeItem *first = start->data;
+		GList *end = start->next;
+
+		while (end && ((DupeItem *)end->data)->fd->size == first->fd->size) end = end->next;
+
+		result = keep(start, end, result);
+
+		start = end;
+		}
+
+	g_list_free(list);
+
+	return g_list_reverse(result);
+}
+
+static GList *dupe_sum_keep_size(GList *start, GList *end, GList *result)
+{
+	GList *work;
+
+	/* another item of the same size */
+	if (start->next == end) return result;
+
+	for (work = start; work != end; work = work->next)
+		{
+		result = g_list_prepend(result, work->data);
+		}
+
+	return result;
+}
+
+static gboolean dupe_sum_partial_equal(GList *a, GList *b)
+{
+	const gchar *pa = ((DupeItem *)a->data)->partial_checksum;
+	const gchar *pb = ((DupeItem *)b->data)->partial_checksum;
+
+	return (pa && pb && strcmp(pa, pb) == 0);
+}
+
+/* the group is sorted by partial checksum, see dupe_sum_partial_sort_cb(), so the
+ * items that share their partial checksum are next to each other
+ */
+static GList *dupe_sum_keep_partial(GList *start, GList *end, GList *result)
+{
+	GList *work;
+	gboolean full = FALSE;
+
+	/* an item with a checksum can match any other item of the group */
+	for (work = start; work != end && !full; work = work->next)
+		{
+		DupeItem *di = work->data;
+
+		full = (di->checksum && di->checksum[0] != '\0');
+		}
+
+	for (work = start; work != end; work = work->next)
+		{
+		DupeItem *di = work->data;
 
-		if (!di->simd)
+		if (di->checksum) continue;
+
+		if (full ||
+		    (work != start && dupe_sum_partial_equal(work->prev, work)) ||
+		    (work->next != end && dupe_sum_partial_equal(work, work->next)))
 			{
-			di->simd = image_sim_new_from_pixbuf(pixbuf);
+			result = g_list_prepend(result, di);
 			}
-		else
+		}
+
+	return result;
+}
+
+/* returns TRUE when done, stage 0 groups the items by size, stage 1 reads the
+ * partial checksums and stage 2 the checksums of the remaining candidates
+ */
+static gboolean dupe_sum_step(DupeWindow *dw)
+{
+	if (dw->sum_stage == 0)
+		{
+		GList *list;
+
+		list = g_list_copy(dw->list);
+		if (dw->second_set) list = g_list_concat(list, g_list_copy(dw->second_list));
+		list = g_list_sort(list, dupe_sum_size_sort_cb);
+
+		dw->sum_list = dupe_sum_filter(list, dupe_sum_keep_size);
+		dw->sum_count = g_list_length(dw->sum_list);
+		dw->sum_stage = 1;
+		dupe_setup_reset(dw);
+		dw->setup_point = dw->sum_list;
+
+		DEBUG_1("Checksum candidates: %d of %d", dw->sum_count, dw->setup_count);
+		}
+
+	while (dw->setup_point)
+		{
+		DupeItem *di = dw->setup_point->data;
+
+		dw->setup_point = dw->setup_point->next;
+		dw->setup_n++;
+
+		if (di->checksum) continue;
+		if (dw->sum_stage == 1 && di->partial_checksum) continue;
+
+		dupe_window_update_progress(dw, _("Reading checksums..."),
+			dw->sum_count == 0 ? 0.0 : (gdouble)(dw->setup_n - 1) / dw->sum_count, FALSE);
+
+		if (options->thumbnails.enable_caching && dw->sum_stage == 1)
 			{
-			image_sim_fill_data(di->simd, pixbuf);
+			dupe_item_read_cache(di);
+			if (di->checksum) return FALSE;
 			}
 
-		if (di->width == 0 && di->height == 0)
+		if (dw->sum_stage == 1)
 			{
-			di->width = gdk_pixbuf_get_width(pixbuf);
-			di->height = gdk_pixbuf_get_height(pixbuf);
+			dupe_item_read_partial_checksum(di);
 			}
-		if (options->thumbnails.enable_caching)
+		else
 			{
-			dupe_item_write_cache(di);
+			di->checksum = checksum_text_from_file_utf8(options->duplicates_checksum, di->fd->path, "");
 			}
 
-		image_sim_alternate_processing(di->simd);
+		if (options->thumbnails.enable_caching && di->checksum)
+			{
+			dupe_item_write_cache(di);
+			}
+		return FALSE;
 		}
 
-	image_loader_free(dw->img_loader);
-	dw->img_loader = NULL;
+	if (dw->sum_stage == 1)
+		{
+		dw->sum_list = g_list_sort(dw->sum_list, dupe_sum_partial_sort_cb);
+		dw->sum_list = dupe_sum_filter(dw->sum_list, dupe_sum_keep_partial);
+		dw->sum_count = g_list_length(dw->sum_list);
+		dw->sum_stage = 2;
+		dupe_setup_reset(dw);
+		dw->setup_point = dw->sum_list;
 
-	dw->idle_id = g_idle_add(dupe_check_cb, dw);
-}
+		DEBUG_1("Checksum collisions after partial checksum: %d", dw->sum_count);
 
-static void dupe_setup_reset(DupeWindow *dw)
-{
-	dw->setup_point = NULL;
-	dw->setup_n = 0;
-	dw->setup_time = msec_time();
-	dw->setup_time_count = 0;
+		return FALSE;
+		}
+
+	dupe_sum_reset(dw);
+
+	return TRUE;
 }
 
 static GList *dupe_setup_point_step(DupeWindow *dw, GList *p)
@@ -1476,34 +2152,8 @@ static gboolean dupe_check_cb(gpointer data)
 		if ((dw->match_mask & DUPE_MATCH_SUM) &&
 		    !(dw->setup_mask & DUPE_MATCH_SUM) )
 			{
-			if (!dw->setup_point) dw->setup_point = dw->list;
-
-			while (dw->setup_point)
-				{
-				DupeItem *di = dw->setup_point->data;
-
-				dw->setup_point = dupe_setup_point_step(dw, dw->setup_point);
-				dw->setup_n++;
-
-				if (!di->md5sum)
-					{
-					dupe_window_update_progress(dw, _("Reading checksums..."),
-						dw->setup_count == 0 ? 0.0 : (gdouble)(dw->setup_n - 1) / dw->setup_count, FALSE);
+			if (!dupe_sum_step(dw)) return TRUE;
 
-					if (options->thumbnails.enable_caching)
-						{
-						dupe_item_read_cache(di);
-						if (di->md5sum) return TRUE;
-						}
-
-					di->md5sum = md5_text_from_file_utf8(di->fd->path, "");
-					if (options->thumbnails.enable_caching)
-						{
-						dupe_item_write_cache(di);
-						}
-					return TRUE;
-					}
-				}
 			dw->setup_mask |= DUPE_MATCH_SUM;
 			dupe_setup_reset(dw);
 			}
@@ -1546,7 +2196,8 @@ static gboolean dupe_check_cb(gpointer data)
 		     dw->match_mask & DUPE_MATCH_SIM_CUSTOM) &&
 		    !(dw->setup_mask & DUPE_MATCH_SIM_MED) )
 			{
-			if (!dw->setup_point) dw->setup_point = dw->list;
+			/* setup_n is non zero once the list was walked and only jobs are left */
+			if (!dw->setup_point && dw->setup_n == 0) dw->setup_point = dw->list;
 
 			while (dw->setup_point)
 				{
@@ -1554,6 +2205,13 @@ static gboolean dupe_check_cb(gpointer data)
 
 				if (!di->simd)
 					{
+					if ((gint)g_list_length(dw->sim_jobs) >= dw->sim_jobs_max)
+						{
+						/* wait, restarted by dupe_sim_job_done_cb() */
+						dw->idle_id = 0;
+						return FALSE;
+						}
+
 					dupe_window_update_progress(dw, _("Reading similarity data..."),
 						dw->setup_count == 0 ? 0.0 : (gdouble)dw->setup_n / dw->setup_count, FALSE);
 
@@ -1567,26 +2225,26 @@ static gboolean dupe_check_cb(gpointer data)
 							}
 						}
 
-					dw->img_loader = image_loader_new(di->fd);
-					image_loader_set_buffer_size(dw->img_loader, 8);
-					g_signal_connect(G_OBJECT(dw->img_loader), "error", (GCallback)dupe_loader_done_cb, dw);
-					g_signal_connect(G_OBJECT(dw->img_loader), "done", (GCallback)dupe_loader_done_cb, dw);
-
-					if (!image_loader_start(dw->img_loader))
+					if (!dupe_sim_job_start(dw, di))
 						{
 						image_sim_free(di->simd);
 						di->simd = image_sim_new();
-						image_loader_free(dw->img_loader);
-						dw->img_loader = NULL;
-						return TRUE;
 						}
-					dw->idle_id = 0;
-					return FALSE;
+
+					dw->setup_point = dupe_setup_point_step(dw, dw->setup_point);
+					dw->setup_n++;
+					return TRUE;
 					}
 
 				dw->setup_point = dupe_setup_point_step(dw, dw->setup_point);
 				dw->setup_n++;
 				}
+			if (dw->sim_jobs)
+				{
+				/* wait, restarted by dupe_sim_job_done_cb() */
+				dw->idle_id = 0;
+				return FALSE;
+				}
 			dw->setup_mask |= DUPE_MATCH_SIM_MED;
 			dupe_setup_reset(dw);
 			}
@@ -1620,17 +2278,27 @@ static gboolean dupe_check_cb(gpointer data)
 		return FALSE;
 		}
 
-	dupe_list_check_match(dw, (DupeItem *)dw->working->data, dw->working);
-	dupe_window_update_progress(dw, _("Comparing..."), dw->setup_count == 0 ? 0.0 : (gdouble) dw->setup_n / dw->setup_count, FALSE);
-	dw->setup_n++;
+	if (!dw->compare)
+		{
+		dupe_compare_start(dw);
+#ifdef HAVE_GTHREAD
+		/* wait, restarted by dupe_compare_block_done_cb() */
+		dw->idle_id = 0;
+		return FALSE;
+#endif
+		}
 
-	dw->working = dw->working->prev;
+#ifndef HAVE_GTHREAD
+	dupe_compare_step(dw);
+#endif
 
 	return TRUE;
 }
 
 static void dupe_check_start(DupeWindow *dw)
 {
+	dupe_compare_cancel(dw);
+
 	dw->setup_done = FALSE;
 
 	dw->setup_count = g_list_length(dw->list);
@@ -1638,6 +2306,8 @@ static void dupe_check_start(DupeWindow *dw)
 
 	dw->setup_mask = 0;
 	dupe_setup_reset(dw);
+	dupe_sum_reset(dw);
+	dupe_sim_job_setup(dw);
 
 	dw->working = g_list_last(dw->list);
 
@@ -1657,9 +2327,19 @@ static void dupe_check_start(DupeWindow *dw)
 
 static void dupe_item_remove(DupeWindow *dw, DupeItem *di)
 {
+	gboolean compare_restart = FALSE;
+
 	if (!di) return;
 
 	/* handle things that may be in progress... */
+	if (dw->compare)
+		{
+		/* the comparison threads may use di, start over without it */
+		dupe_compare_cancel(dw);
+		dupe_match_reset_list(dw->list);
+		dupe_match_reset_list(dw->second_list);
+		compare_restart = TRUE;
+		}
 	if (dw->working && dw->working->data == di)
 		{
 		dw->working = dw->working->prev;
@@ -1671,12 +2351,15 @@ static void dupe_item_remove(DupeWindow *dw, DupeItem *di)
 	if (dw->setup_point && dw->setup_point->data == di)
 		{
 		dw->setup_point = dupe_setup_point_step(dw, dw->setup_point);
-		if (dw->img_loader)
-			{
-			image_loader_free(dw->img_loader);
-			dw->img_loader = NULL;
-			dw->idle_id = g_idle_add(dupe_check_cb, dw);
-			}
+		}
+	if (dw->sum_list && g_list_find(dw->sum_list, di))
+		{
+		dw->sum_list = g_list_remove(dw->sum_list, di);
+		dw->sum_count--;
+		}
+	if (dupe_sim_job_cancel(dw, di) && !dw->idle_id)
+		{
+		dw->idle_id = g_idle_add(dupe_check_cb, dw);
 		}
 
 	if (di->group && dw->dupes)
@@ -1738,6 +2421,13 @@ static void dupe_item_remove(DupeWindow *dw, DupeItem *di)
 		}
 	dupe_item_free(di);
 
+	if (compare_restart)
+		{
+		dw->working = g_list_last(dw->list);
+		dupe_setup_reset(dw);
+		if (!dw->idle_id) dw->idle_id = g_idle_add(dupe_check_cb, dw);
+		}
+
 	dupe_window_update_count(dw, FALSE);
 }
 
@@ -1988,7 +2678,7 @@ static void dupe_display_stats(DupeWindow *dw, DupeItem *di)
 	buf = g_strdup_printf("%d x %d", di->width, di->height);
 	dupe_display_label(gd->vbox, "dimensions:", buf);
 	g_free(buf);
-	dupe_display_label(gd->vbox, "md5sum:", (di->md5sum) ? di->md5sum : "not generated");
+	dupe_display_label(gd->vbox, "checksum:", (di->checksum) ? di->checksum : "not generated");
 
 	dupe_display_label(gd->vbox, "thumbprint:", (di->simd) ? "" : "not generated");
 	if (di->simd)
@@ -2964,6 +3654,32 @@ static void dupe_window_rotation_invariant_cb(GtkWidget *widget, gpointer data)
 	dupe_window_recompare(dw);
 }
 
+static void dupe_window_fast_checksum_cb(GtkWidget *widget, gpointer data)
+{
+	DupeWindow *dw = data;
+	GList *work;
+
+	options->duplicates_checksum = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ? CHECKSUM_XXH64 : CHECKSUM_MD5;
+
+	if (dw->match_mask & DUPE_MATCH_SUM) dupe_check_stop(dw);
+
+	/* checksums of the other type never match */
+	work = g_list_concat(g_list_copy(dw->list), g_list_copy(dw->second_list));
+	while (work)
+		{
+		DupeItem *di = work->data;
+
+		g_free(di->checksum);
+		di->checksum = NULL;
+		g_free(di->partial_checksum);
+		di->partial_checksum = NULL;
+
+		work = g_list_delete_link(work, work);
+		}
+
+	if (dw->match_mask & DUPE_MATCH_SUM) dupe_window_recompare(dw);
+}
+
 static void dupe_window_custom_threshold_cb(GtkWidget *widget, gpointer data)
 {
 	DupeWindow *dw = data;
@@ -3397,6 +4113,14 @@ DupeWindow *dupe_window_new()
 	gtk_box_pack_start(GTK_BOX(status_box), dw->button_rotation_invariant, FALSE, FALSE, PREF_PAD_SPACE);
 	gtk_widget_show(dw->button_rotation_invariant);
 
+	dw->button_fast_checksum = gtk_check_button_new_with_label(_("Fast Checksum"));
+	gtk_widget_set_tooltip_text(GTK_WIDGET(dw->button_fast_checksum), "Compare checksums with XXH64 instead of MD5");
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(dw->button_fast_checksum), options->duplicates_checksum == CHECKSUM_XXH64);
+	g_signal_connect(G_OBJECT(dw->button_fast_checksum), "toggled",
+			 G_CALLBACK(dupe_window_fast_checksum_cb), dw);
+	gtk_box_pack_start(GTK_BOX(status_box), dw->button_fast_checksum, FALSE, FALSE, PREF_PAD_SPACE);
+	gtk_widget_show(dw->button_fast_checksum);
+
 	button = gtk_check_button_new_with_label(_("Compare two file sets"));
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), dw->second_set);
 	g_signal_connect(G_OBJECT(button), "toggled",
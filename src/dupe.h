@@ -22,6 +22,7 @@
 #ifndef DUPE_H
 #define DUPE_H
 
+#include "checksum-util.h"
 #include "similar.h"
 
 /* match methods */
@@ -32,7 +33,7 @@ typedef enum
 	DUPE_MATCH_SIZE = 1 << 1,
 	DUPE_MATCH_DATE = 1 << 2,
 	DUPE_MATCH_DIM  = 1 << 3,	/* image dimensions */
-	DUPE_MATCH_SUM  = 1 << 4,	/* MD5sum */
+	DUPE_MATCH_SUM  = 1 << 4,	/* checksum */
 	DUPE_MATCH_PATH = 1 << 5,
 	DUPE_MATCH_SIM_HIGH = 1 << 6,	/* similarity */
 	DUPE_MATCH_SIM_MED  = 1 << 7,
@@ -56,7 +57,8 @@ struct _DupeItem
 
 	FileData *fd;
 
-	gchar *md5sum;
+	gchar *checksum;		/* of type options->duplicates_checksum */
+	gchar *partial_checksum;	/* of the first and last blocks of the file */
 	gint width;
 	gint height;
 
@@ -78,6 +80,8 @@ struct _DupeMatch
 	gdouble rank;
 };
 
+typedef struct _DupeCompare DupeCompare;
+
 typedef struct _DupeWindow DupeWindow;
 struct _DupeWindow
 {
@@ -93,12 +97,14 @@ struct _DupeWindow
 	GtkWidget *extra_label;
 	GtkWidget *button_thumbs;
 	GtkWidget *button_rotation_invariant;
+	GtkWidget *button_fast_checksum;
 	GtkWidget *custom_threshold;
 
 	gboolean show_thumbs;
 
 	guint idle_id; /* event source id */
 	GList *working;
+	DupeCompare *compare;		/* comparison in progress */
 	gint setup_done;
 	gint setup_count;
 	gint setup_n;			/* these are merely for speed optimization */
@@ -107,12 +113,17 @@ struct _DupeWindow
 	guint64 setup_time;
 	guint64 setup_time_count;
 
+	GList *sum_list;		/* items that may have the same checksum, during setup */
+	gint sum_count;
+	gint sum_stage;
+
 	DupeItem *click_item;		/* for popup menu */
 
 	ThumbLoader *thumb_loader;
 	DupeItem *thumb_item;
 
-	ImageLoader *img_loader;
+	GList *sim_jobs;		/* similarity data being loaded or computed */
+	gint sim_jobs_max;
 
 	/* second set comparison stuff */
 
@@ -1017,18 +1017,243 @@ gchar *exif_get_data_as_text(ExifData *exif, const gchar *key)
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ * exif cache
+ *
+ * The parsed ExifData of the recently used files are kept in exif_cache. When
+ * they are evicted, the plain values of their tags are kept in exif_compact_cache
+ * as one ExifCompact block: the keys are interned as GQuarks and sorted for
+ * binary search, the values are packed as NUL separated strings. This is much
+ * smaller than the exiv2 objects, so thousands of files can stay resident and
+ * metadata_read_list() does not have to parse them again.
+ *
+ * Both caches are limited by options->image.exif_cache_max, a quarter of it
+ * goes to the parsed data.
+ *-----------------------------------------------------------------------------
+ */
+
+#define EXIF_CACHE_ITEM_OVERHEAD 128	/* estimated size of one parsed tag besides its data */
+#define EXIF_COMPACT_VALUE_MAX 512	/* longer values are not kept, they are read again */
+
+#define EXIF_COMPACT_SKIPPED 1
+
+typedef struct _ExifCompactEntry ExifCompactEntry;
+struct _ExifCompactEntry
+{
+	GQuark key;
+	guint32 offset;		/* of the first value in ExifCompact data */
+	guint16 count;		/* number of values */
+	guint16 flags;
+};
+
+struct _ExifCompact
+{
+	guint count;
+	gulong size;
+	ExifCompactEntry entries[];	/* followed by the values */
+};
+
 static FileCacheData *exif_cache;
+static FileCacheData *exif_compact_cache;
+static gboolean exif_cache_evicting = FALSE;
+
+static gint exif_compact_entry_cmp(gconstpointer a, gconstpointer b)
+{
+	GQuark ka = ((const ExifCompactEntry *)a)->key;
+	GQuark kb = ((const ExifCompactEntry *)b)->key;
+
+	if (ka < kb) return -1;
+	if (ka > kb) return 1;
+	return 0;
+}
+
+/* the tags are read in one walk over the items: like exif_get_metadata(), the
+ * first item of a key is kept, except for IPTC where the repeated items add values
+ */
+static ExifCompact *exif_compact_new(ExifData *exif)
+{
+	ExifCompact *ec;
+	GArray *entries;
+	GPtrArray *lists;	/* values of each entry, last first */
+	GString *values;
+	GHashTable *index;	/* key -> position in entries + 1 */
+	ExifItem *item;
+	gsize head;
+	guint i;
+
+	entries = g_array_new(FALSE, FALSE, sizeof(ExifCompactEntry));
+	lists = g_ptr_array_new();
+	index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	item = exif_get_first_item(exif);
+	while (item)
+		{
+		gchar *tag = exif_item_get_tag_name(item);
+		GQuark key = tag ? g_quark_from_string(tag) : 0;
+		guint pos = key ? GPOINTER_TO_UINT(g_hash_table_lookup(index, GUINT_TO_POINTER(key))) : 0;
+		ExifCompactEntry *entry = NULL;
+
+		if (!key)
+			{
+			/* no tag name, nothing to look up */
+			}
+		else if (!pos)
+			{
+			ExifCompactEntry new_entry;
+
+			new_entry.key = key;
+			new_entry.offset = 0;
+			new_entry.count = 0;
+			new_entry.flags = 0;
+			g_array_append_val(entries, new_entry);
+			g_ptr_array_add(lists, NULL);
+			pos = entries->len;
+			g_hash_table_insert(index, GUINT_TO_POINTER(key), GUINT_TO_POINTER(pos));
+
+			entry = &g_array_index(entries, ExifCompactEntry, pos - 1);
+			}
+		else if (g_str_has_prefix(tag, "Iptc."))
+			{
+			entry = &g_array_index(entries, ExifCompactEntry, pos - 1);
+			}
+
+		if (entry && !(entry->flags & EXIF_COMPACT_SKIPPED))
+			{
+			GList **list = (GList **)&g_ptr_array_index(lists, pos - 1);
+			GList *item_values = NULL;
+			GList *work;
+
+			if (exif_item_get_size(item) > EXIF_COMPACT_VALUE_MAX)
+				{
+				entry->flags = EXIF_COMPACT_SKIPPED;
+				}
+			else
+				{
+				item_values = exif_item_get_metadata(item, METADATA_PLAIN);
+				}
+
+			for (work = item_values; work && !(entry->flags & EXIF_COMPACT_SKIPPED); work = work->next)
+				{
+				if (strlen(work->data) > EXIF_COMPACT_VALUE_MAX)
+					{
+					entry->flags = EXIF_COMPACT_SKIPPED;
+					}
+				else if (entry->count < G_MAXUINT16)
+					{
+					*list = g_list_prepend(*list, work->data);
+					work->data = NULL;
+					entry->count++;
+					}
+				}
+			string_list_free(item_values);
+
+			if (entry->flags & EXIF_COMPACT_SKIPPED)
+				{
+				string_list_free(*list);
+				*list = NULL;
+				entry->count = 0;
+				}
+			}
+
+		g_free(tag);
+		item = exif_get_next_item(exif);
+		}
+
+	values = g_string_sized_new(4096);
+	for (i = 0; i < entries->len; i++)
+		{
+		ExifCompactEntry *entry = &g_array_index(entries, ExifCompactEntry, i);
+		GList *list = g_list_reverse(g_ptr_array_index(lists, i));
+		GList *work;
+
+		entry->offset = values->len;
+		for (work = list; work; work = work->next)
+			{
+			g_string_append_len(values, work->data, strlen(work->data) + 1);
+			}
+		string_list_free(list);
+		}
+
+	g_array_sort(entries, exif_compact_entry_cmp);
+
+	head = sizeof(ExifCompact) + entries->len * sizeof(ExifCompactEntry);
+	ec = g_malloc(head + values->len);
+	ec->count = entries->len;
+	ec->size = head + values->len;
+	memcpy(ec->entries, entries->data, entries->len * sizeof(ExifCompactEntry));
+	memcpy((gchar *)ec + head, values->str, values->len);
+
+	g_hash_table_destroy(index);
+	g_ptr_array_free(lists, TRUE);
+	g_string_free(values, TRUE);
+	g_array_free(entries, TRUE);
+
+	return ec;
+}
+
+static const ExifCompactEntry *exif_compact_find(ExifCompact *ec, const gchar *key)
+{
+	ExifCompactEntry entry;
+
+	entry.key = g_quark_try_string(key);
+	if (!entry.key) return NULL;
+
+	return bsearch(&entry, ec->entries, ec->count, sizeof(ExifCompactEntry), exif_compact_entry_cmp);
+}
+
+static gulong exif_cache_estimate_size(ExifData *exif)
+{
+	gulong size = sizeof(ExifData *);
+	ExifItem *item;
+
+	item = exif_get_first_item(exif);
+	while (item)
+		{
+		size += EXIF_CACHE_ITEM_OVERHEAD + exif_item_get_size(item);
+		item = exif_get_next_item(exif);
+		}
+	return size;
+}
+
+static void exif_compact_release_cb(FileData *fd)
+{
+	g_free(fd->exif_compact);
+	fd->exif_compact = NULL;
+}
 
 void exif_release_cb(FileData *fd)
 {
+	/* keep the decoded tags only when the data are evicted for space,
+	   an invalidated entry belongs to a changed file, unwritten changes
+	   would have to be merged again */
+	if (exif_cache_evicting && fd->exif && !fd->modified_xmp)
+		{
+		/* a compact copy still in the cache was made from the same data */
+		if (!fd->exif_compact) fd->exif_compact = exif_compact_new(fd->exif);
+		file_cache_put(exif_compact_cache, fd, fd->exif_compact->size);
+		}
+
 	exif_free(fd->exif);
 	fd->exif = NULL;
 }
 
+static void exif_cache_update_size(void)
+{
+	gulong max_size = (gulong)options->image.exif_cache_max * 1048576;
+
+	exif_cache_evicting = TRUE;
+	file_cache_set_max_size(exif_cache, max_size / 4);
+	exif_cache_evicting = FALSE;
+	file_cache_set_max_size(exif_compact_cache, max_size - max_size / 4);
+}
+
 void exif_init_cache(void)
 {
 	g_assert(!exif_cache);
-	exif_cache = file_cache_new(exif_release_cb, 4);
+	exif_cache = file_cache_new(exif_release_cb, 0);
+	exif_compact_cache = file_cache_new(exif_compact_release_cb, 0);
+	exif_cache_update_size();
 }
 
 ExifData *exif_read_fd(FileData *fd)
@@ -1056,10 +1281,73 @@ ExifData *exif_read_fd(FileData *fd)
 	fd->exif = exif_read(fd->path, sidecar_path, fd->modified_xmp);
 
 	g_free(sidecar_path);
-	file_cache_put(exif_cache, fd, 1);
+
+	exif_cache_update_size(); /* update from options */
+	exif_cache_evicting = TRUE;
+	file_cache_put(exif_cache, fd, fd->exif ? exif_cache_estimate_size(fd->exif) : sizeof(ExifData *));
+	exif_cache_evicting = FALSE;
 	return fd->exif;
 }
 
+/* reads the plain values of key from the compact copy of the tags,
+ * returns FALSE if there is none and exif_read_fd() is needed
+ */
+gboolean exif_compact_get_metadata(FileData *fd, const gchar *key, GList **list)
+{
+	ExifCompact *ec;
+	const ExifCompactEntry *entry;
+	const gchar *value;
+	guint i;
+
+	if (!exif_compact_cache || !fd || !key) return FALSE;
+
+	/* the full data are in the cache already, or changes have to be merged */
+	if (fd->exif || fd->modified_xmp) return FALSE;
+	if (!file_cache_get(exif_compact_cache, fd)) return FALSE;
+
+	ec = fd->exif_compact;
+	entry = exif_compact_find(ec, key);
+	if (!entry)
+		{
+		const gchar *alt_key = exif_get_metadata_alt_key(key);
+		if (alt_key) entry = exif_compact_find(ec, alt_key);
+		}
+
+	*list = NULL;
+	if (!entry) return TRUE;
+	if (entry->flags & EXIF_COMPACT_SKIPPED) return FALSE;
+
+	value = (const gchar *)&ec->entries[ec->count] + entry->offset;
+	for (i = 0; i < entry->count; i++)
+		{
+		*list = g_list_prepend(*list, g_strdup(value));
+		value += strlen(value) + 1;
+		}
+	*list = g_list_reverse(*list);
+	return TRUE;
+}
+
+/* as exif_fast_read(), also FALSE when the sidecars or unwritten changes of fd
+ * have to be merged, or when the full exif data are in the cache already
+ */
+gboolean exif_fast_read_fd(FileData *fd, ExifFast *ef)
+{
+	gchar *sidecar_path;
+
+	if (!fd || fd->exif || fd->modified_xmp) return FALSE;
+
+#ifdef HAVE_EXIV2
+	sidecar_path = cache_find_location(CACHE_TYPE_XMP_METADATA, fd->path);
+	if (!sidecar_path) sidecar_path = file_data_get_sidecar_path(fd, TRUE);
+	if (sidecar_path)
+		{
+		g_free(sidecar_path);
+		return FALSE;
+		}
+#endif
+
+	return exif_fast_read(fd->path, ef);
+}
 
 void exif_free_fd(FileData *fd, ExifData *exif)
 {
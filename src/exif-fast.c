@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "exif.h"
+
+#include "ui_fileops.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+
+/*
+ *-------------------------------------------------------------------
+ * Fast path for the few tags needed to sort and list files:
+ *-------------------------------------------------------------------
+ *
+ * Only the start of the file is read and only IFD0, the Exif IFD and the
+ * XMP packet are looked at. JPEG files and TIFF based raw files (CR2, NEF,
+ * ARW, DNG, PEF, ORF, RW2...) are supported, for anything else or anything
+ * unexpected FALSE is returned and the caller uses exif_read().
+ *
+ * The tags that exiv2 may synchronize between Exif and XMP must not be in
+ * the XMP packet, otherwise the values could differ from the full read.
+ */
+
+#define EXIF_FAST_HEAD_SIZE	16384	/* read at once from the start of the file */
+#define EXIF_FAST_SEGMENT_MAX	65537	/* largest JPEG segment, with its marker and length */
+#define EXIF_FAST_TIFF_SIZE	65536	/* the IFDs of raw files must be within this */
+#define EXIF_FAST_IFD_ENTRIES	1024	/* more means the data is damaged */
+
+#define EXIF_FAST_TAG_ORIENTATION	0x0112
+#define EXIF_FAST_TAG_XMP		0x02bc
+#define EXIF_FAST_TAG_RATING		0x4746
+#define EXIF_FAST_TAG_EXIF_IFD		0x8769
+#define EXIF_FAST_TAG_DATE_ORIGINAL	0x9003
+#define EXIF_FAST_TAG_DATE_DIGITIZED	0x9004
+
+#define EXIF_FAST_TYPE_BYTE	1
+#define EXIF_FAST_TYPE_ASCII	2
+#define EXIF_FAST_TYPE_SHORT	3
+#define EXIF_FAST_TYPE_LONG	4
+#define EXIF_FAST_TYPE_UNDEFINED 7
+
+static const gchar exif_fast_jpeg_exif[] = "Exif\0";
+static const gchar exif_fast_jpeg_xmp[] = "http://ns.adobe.com/xap/1.0/";
+
+typedef struct _ExifFastFile ExifFastFile;
+struct _ExifFastFile
+{
+	gint fd;
+	guchar head[EXIF_FAST_HEAD_SIZE];
+	gsize head_len;
+	guchar *buf;			/* for the data after head, EXIF_FAST_SEGMENT_MAX bytes */
+};
+
+/* returns len bytes at offset, valid until the next call, NULL if the file is shorter */
+static const guchar *exif_fast_file_get(ExifFastFile *f, goffset offset, gsize len)
+{
+	gsize done = 0;
+
+	if (offset + len <= f->head_len) return f->head + offset;
+	if (len > EXIF_FAST_SEGMENT_MAX) return NULL;
+
+	if (!f->buf) f->buf = g_malloc(EXIF_FAST_SEGMENT_MAX);
+	while (done < len)
+		{
+		gssize n = pread(f->fd, f->buf + done, len - done, offset + done);
+
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return NULL;
+		done += n;
+		}
+
+	return f->buf;
+}
+
+static guint16 exif_fast_get_u16(const guchar *p, gboolean bigendian)
+{
+	return bigendian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static guint32 exif_fast_get_u32(const guchar *p, gboolean bigendian)
+{
+	return bigendian ? ((guint32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+			 : ((guint32)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+/*
+ *-------------------------------------------------------------------
+ * XMP packet
+ *-------------------------------------------------------------------
+ */
+
+/* returns the value of an XMP property written as attribute or element, NULL if not set */
+static const gchar *exif_fast_xmp_find(const gchar *data, gsize len, const gchar *name, gsize *value_len)
+{
+	const gchar *end = data + len;
+	const gchar *p = data;
+	gsize name_len = strlen(name);
+
+	while ((p = g_strstr_len(p, end - p, name)) != NULL)
+		{
+		const gchar *value = p + name_len;
+		const gchar *value_end;
+		gchar quote;
+
+		p = value;
+		if (value >= end) break;
+
+		if (*value == '>')
+			{
+			/* <xmp:Rating>3</xmp:Rating> */
+			value++;
+			quote = '<';
+			}
+		else
+			{
+			/* xmp:Rating="3" */
+			while (value < end && g_ascii_isspace(*value)) value++;
+			if (value >= end || *value != '=') continue;
+			value++;
+			while (value < end && g_ascii_isspace(*value)) value++;
+			if (value >= end || (*value != '"' && *value != '\'')) continue;
+			quote = *value++;
+			}
+
+		value_end = memchr(value, quote, end - value);
+		if (!value_end) break;
+
+		*value_len = value_end - value;
+		return value;
+		}
+
+	return NULL;
+}
+
+static gboolean exif_fast_xmp_name_char(gchar c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c == '-' || c == '.';
+}
+
+/* returns the prefix declared for the namespace uri as xmlns:prefix="uri", NULL if not declared */
+static gchar *exif_fast_xmp_prefix(const gchar *data, gsize len, const gchar *uri)
+{
+	const gchar *end = data + len;
+	const gchar *p = data;
+	gsize uri_len = strlen(uri);
+
+	while ((p = g_strstr_len(p, end - p, "xmlns:")) != NULL)
+		{
+		const gchar *prefix = p + 6;
+		const gchar *value;
+		gchar quote;
+
+		p = prefix;
+		while (p < end && exif_fast_xmp_name_char(*p)) p++;
+		if (p == prefix) continue;
+
+		value = p;
+		while (value < end && g_ascii_isspace(*value)) value++;
+		if (value >= end || *value != '=') continue;
+		value++;
+		while (value < end && g_ascii_isspace(*value)) value++;
+		if (value >= end || (*value != '"' && *value != '\'')) continue;
+		quote = *value++;
+
+		if ((gsize)(end - value) > uri_len &&
+		    strncmp(value, uri, uri_len) == 0 && value[uri_len] == quote)
+			{
+			return g_strndup(prefix, p - prefix);
+			}
+		}
+
+	return NULL;
+}
+
+/* returns TRUE if property is used under any other prefix than the given one */
+static gboolean exif_fast_xmp_other_prefix(const gchar *data, gsize len, const gchar *prefix, const gchar *property)
+{
+	const gchar *end = data + len;
+	const gchar *p = data;
+	gsize prefix_len = strlen(prefix);
+	gsize property_len = strlen(property);
+
+	while ((p = g_strstr_len(p, end - p, property)) != NULL)
+		{
+		const gchar *colon = p;
+		const gchar *start;
+
+		p += property_len;
+		if (colon == data || *(colon - 1) != ':') continue;
+		if (p < end && exif_fast_xmp_name_char(*p)) continue;
+
+		colon--;
+		start = colon;
+		while (start > data && exif_fast_xmp_name_char(*(start - 1))) start--;
+
+		if ((gsize)(colon - start) != prefix_len || strncmp(start, prefix, prefix_len) != 0) return TRUE;
+		}
+
+	return FALSE;
+}
+
+static gboolean exif_fast_parse_xmp(const guchar *data, gsize len, ExifFast *ef)
+{
+	const gchar *xmp = (const gchar *)data;
+	const gchar *value;
+	gsize value_len;
+	gchar *prefix;
+	gchar *name;
+
+	/* exiv2 would merge these with the Exif tags, whatever prefix they have */
+	if (exif_fast_xmp_other_prefix(xmp, len, "", "Orientation") ||
+	    exif_fast_xmp_other_prefix(xmp, len, "", "DateTimeOriginal") ||
+	    exif_fast_xmp_other_prefix(xmp, len, "", "DateTimeDigitized")) return FALSE;
+
+	/* the rating is read under the prefix declared for the xmp namespace,
+	 * any other Rating (another namespace or an undeclared prefix) is left to exiv2
+	 */
+	prefix = exif_fast_xmp_prefix(xmp, len, exif_fast_jpeg_xmp);
+	if (!prefix) prefix = g_strdup("xmp");
+
+	if (exif_fast_xmp_other_prefix(xmp, len, prefix, "Rating"))
+		{
+		g_free(prefix);
+		return FALSE;
+		}
+
+	name = g_strconcat(prefix, ":Rating", NULL);
+	value = exif_fast_xmp_find(xmp, len, name, &value_len);
+	g_free(name);
+	g_free(prefix);
+	if (value)
+		{
+		gchar *text = g_strndup(value, value_len);
+		gchar *end;
+		gint64 rating = g_ascii_strtoll(text, &end, 10);
+
+		if (end == text || *end != '\0')
+			{
+			g_free(text);
+			return FALSE;
+			}
+		ef->rating = (gint)rating;
+		g_free(text);
+		}
+
+	return TRUE;
+}
+
+/*
+ *-------------------------------------------------------------------
+ * TIFF structure, of the JPEG Exif segment or of a raw file
+ *-------------------------------------------------------------------
+ */
+
+typedef struct _ExifFastTiff ExifFastTiff;
+struct _ExifFastTiff
+{
+	const guchar *data;
+	gsize len;
+	gboolean bigendian;
+};
+
+static gboolean exif_fast_tiff_date(ExifFastTiff *tiff, const guchar *entry, gchar *date)
+{
+	guint16 type = exif_fast_get_u16(entry + 2, tiff->bigendian);
+	guint32 count = exif_fast_get_u32(entry + 4, tiff->bigendian);
+	guint32 offset = exif_fast_get_u32(entry + 8, tiff->bigendian);
+	gsize len;
+
+	if (type != EXIF_FAST_TYPE_ASCII || count <= 4) return FALSE;
+	if (offset > tiff->len || count > tiff->len - offset) return FALSE;
+
+	len = MIN(count, EXIF_FAST_DATE_SIZE - 1);
+	memcpy(date, tiff->data + offset, len);
+	date[len] = '\0';
+
+	return TRUE;
+}
+
+/* calls func for each entry of the IFD at offset */
+static gboolean exif_fast_tiff_ifd(ExifFastTiff *tiff, guint32 offset, ExifFast *ef,
+				   gboolean (*func)(ExifFastTiff *tiff, const guchar *entry, ExifFast *ef))
+{
+	guint16 count;
+	guint i;
+
+	if (offset > tiff->len || tiff->len - offset < 2) return FALSE;
+
+	count = exif_fast_get_u16(tiff->data + offset, tiff->bigendian);
+	if (count > EXIF_FAST_IFD_ENTRIES || (gsize)count * 12 > tiff->len - offset - 2) return FALSE;
+
+	for (i = 0; i < count; i++)
+		{
+		if (!func(tiff, tiff->data + offset + 2 + i * 12, ef)) return FALSE;
+		}
+
+	return TRUE;
+}
+
+static gboolean exif_fast_tiff_exif_entry(ExifFastTiff *tiff, const guchar *entry, ExifFast *ef)
+{
+	switch (exif_fast_get_u16(entry, tiff->bigendian))
+		{
+		case EXIF_FAST_TAG_DATE_ORIGINAL:
+			return exif_fast_tiff_date(tiff, entry, ef->date_time_original);
+		case EXIF_FAST_TAG_DATE_DIGITIZED:
+			return exif_fast_tiff_date(tiff, entry, ef->date_time_digitized);
+		default:
+			break;
+		}
+
+	return TRUE;
+}
+
+static gboolean exif_fast_tiff_ifd0_entry(ExifFastTiff *tiff, const guchar *entry, ExifFast *ef)
+{
+	guint16 type = exif_fast_get_u16(entry + 2, tiff->bigendian);
+	guint32 count = exif_fast_get_u32(entry + 4, tiff->bigendian);
+	guint32 offset = exif_fast_get_u32(entry + 8, tiff->bigendian);
+
+	switch (exif_fast_get_u16(entry, tiff->bigendian))
+		{
+		case EXIF_FAST_TAG_ORIENTATION:
+			if (type != EXIF_FAST_TYPE_SHORT || count != 1) return FALSE;
+			ef->orientation = exif_fast_get_u16(entry + 8, tiff->bigendian);
+			break;
+		case EXIF_FAST_TAG_EXIF_IFD:
+			if (type != EXIF_FAST_TYPE_LONG || count != 1) return FALSE;
+			return exif_fast_tiff_ifd(tiff, offset, ef, exif_fast_tiff_exif_entry);
+		case EXIF_FAST_TAG_XMP:
+			if (type != EXIF_FAST_TYPE_BYTE && type != EXIF_FAST_TYPE_UNDEFINED) return FALSE;
+			if (offset > tiff->len || count > tiff->len - offset) return FALSE;
+			return exif_fast_parse_xmp(tiff->data + offset, count, ef);
+		case EXIF_FAST_TAG_RATING:
+			/* exiv2 may convert it to XMP */
+			return FALSE;
+		default:
+			break;
+		}
+
+	return TRUE;
+}
+
+static gboolean exif_fast_parse_tiff(const guchar *data, gsize len, ExifFast *ef)
+{
+	ExifFastTiff tiff;
+	guint16 magic;
+
+	if (len < 8) return FALSE;
+
+	if (data[0] == 'I' && data[1] == 'I')
+		tiff.bigendian = FALSE;
+	else if (data[0] == 'M' && data[1] == 'M')
+		tiff.bigendian = TRUE;
+	else
+		return FALSE;
+
+	/* TIFF, ORF and RW2 */
+	magic = exif_fast_get_u16(data + 2, tiff.bigendian);
+	if (magic != 0x002a && magic != 0x4f52 && magic != 0x5352 && magic != 0x0055) return FALSE;
+
+	tiff.data = data;
+	tiff.len = len;
+
+	return exif_fast_tiff_ifd(&tiff, exif_fast_get_u32(data + 4, tiff.bigendian), ef, exif_fast_tiff_ifd0_entry);
+}
+
+/*
+ *-------------------------------------------------------------------
+ * JPEG
+ *-------------------------------------------------------------------
+ */
+
+static gboolean exif_fast_parse_jpeg(ExifFastFile *f, ExifFast *ef)
+{
+	goffset offset = 2;
+	gboolean exif_found = FALSE;
+	gboolean xmp_found = FALSE;
+
+	while (!(exif_found && xmp_found))
+		{
+		const guchar *p;
+		guchar marker;
+		guint16 len;
+
+		p = exif_fast_file_get(f, offset, 4);
+		if (!p || p[0] != 0xff) return FALSE;
+
+		marker = p[1];
+		len = (p[2] << 8) | p[3];
+
+		/* the metadata are before the image data */
+		if (marker == 0xda || marker == 0xd9) break;
+		if (marker == 0xff)
+			{
+			offset++;
+			continue;
+			}
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+			{
+			offset += 2;
+			continue;
+			}
+		if (len < 2) return FALSE;
+
+		if (marker == 0xe1)
+			{
+			p = exif_fast_file_get(f, offset + 4, len - 2);
+			if (!p) return FALSE;
+
+			if (!exif_found && len - 2 > sizeof(exif_fast_jpeg_exif) &&
+			    memcmp(p, exif_fast_jpeg_exif, sizeof(exif_fast_jpeg_exif)) == 0)
+				{
+				exif_found = TRUE;
+				if (!exif_fast_parse_tiff(p + sizeof(exif_fast_jpeg_exif), len - 2 - sizeof(exif_fast_jpeg_exif), ef)) return FALSE;
+				}
+			else if (!xmp_found && len - 2 > sizeof(exif_fast_jpeg_xmp) &&
+				 memcmp(p, exif_fast_jpeg_xmp, sizeof(exif_fast_jpeg_xmp)) == 0)
+				{
+				xmp_found = TRUE;
+				if (!exif_fast_parse_xmp(p + sizeof(exif_fast_jpeg_xmp), len - 2 - sizeof(exif_fast_jpeg_xmp), ef)) return FALSE;
+				}
+			}
+
+		offset += 2 + len;
+		}
+
+	return TRUE;
+}
+
+/*
+ *-------------------------------------------------------------------
+ * public
+ *-------------------------------------------------------------------
+ */
+
+gboolean exif_fast_read(const gchar *path, ExifFast *ef)
+{
+	ExifFastFile *f;
+	gchar *pathl;
+	gssize len;
+	gboolean ret = FALSE;
+
+	memset(ef, 0, sizeof(ExifFast));
+	ef->rating = STAR_RATING_NOT_READ;
+
+	pathl = path_from_utf8(path);
+	f = g_new(ExifFastFile, 1);
+	f->buf = NULL;
+	f->fd = open(pathl, O_RDONLY);
+	g_free(pathl);
+
+	if (f->fd < 0)
+		{
+		g_free(f);
+		return FALSE;
+		}
+
+	do
+		{
+		len = read(f->fd, f->head, EXIF_FAST_HEAD_SIZE);
+		}
+	while (len < 0 && errno == EINTR);
+
+	if (len >= 8)
+		{
+		f->head_len = len;
+
+		if (f->head[0] == 0xff && f->head[1] == 0xd8)
+			{
+			ret = exif_fast_parse_jpeg(f, ef);
+			}
+		else
+			{
+			struct stat st;
+			const guchar *data;
+			gsize size;
+
+			size = (fstat(f->fd, &st) == 0) ? MIN(st.st_size, EXIF_FAST_TIFF_SIZE) : f->head_len;
+			data = exif_fast_file_get(f, 0, size);
+			ret = (data && exif_fast_parse_tiff(data, size, ef));
+			}
+		}
+
+	if (!ret)
+		{
+		memset(ef, 0, sizeof(ExifFast));
+		ef->rating = STAR_RATING_NOT_READ;
+		}
+
+	close(f->fd);
+	g_free(f->buf);
+	g_free(f);
+
+	return ret;
+}
+
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
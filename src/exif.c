@@ -582,6 +582,12 @@ guint exif_item_get_elements(ExifItem *item)
 	return item->elements;
 }
 
+guint exif_item_get_size(ExifItem *item)
+{
+	if (!item) return 0;
+	return item->data_len;
+}
+
 gchar *exif_item_get_data(ExifItem *item, guint *data_len)
 {
 	if (data_len)
@@ -1629,6 +1635,22 @@ GList *exif_get_metadata(ExifData *exif, const gchar *key, MetadataFormat format
 	return g_list_append(NULL, str);
 }
 
+GList *exif_item_get_metadata(ExifItem *item, MetadataFormat format)
+{
+	gchar *str;
+
+	str = exif_item_get_data_as_text_full(item, format);
+	if (!str) return NULL;
+
+	return g_list_append(NULL, str);
+}
+
+const gchar *exif_get_metadata_alt_key(const gchar *key)
+{
+	if (strcmp(key, "Xmp.tiff.Orientation") == 0) return "Exif.Image.Orientation";
+	return NULL;
+}
+
 typedef struct _UnmapData UnmapData;
 struct _UnmapData
 {
@@ -108,6 +108,26 @@ ExifData *exif_read(gchar *path, gchar *sidecar_path, GHashTable *modified_xmp);
 ExifData *exif_read_fd(FileData *fd);
 void exif_free_fd(FileData *fd, ExifData *exif);
 
+gboolean exif_compact_get_metadata(FileData *fd, const gchar *key, GList **list);
+
+#define EXIF_FAST_DATE_SIZE 20
+
+/* the tags needed to sort and list files, read by exif_fast_read() */
+typedef struct _ExifFast ExifFast;
+struct _ExifFast
+{
+	gchar date_time_original[EXIF_FAST_DATE_SIZE];	/* as "YYYY:MM:DD HH:MM:SS", empty if not set */
+	gchar date_time_digitized[EXIF_FAST_DATE_SIZE];
+	gint orientation;				/* 0 if not set */
+	gint rating;					/* Xmp.xmp.Rating, STAR_RATING_NOT_READ if not set */
+};
+
+/* reads only the tags of ExifFast from the start of the file,
+ * returns FALSE if that is not possible and exif_read() is needed
+ */
+gboolean exif_fast_read(const gchar *path, ExifFast *ef);
+gboolean exif_fast_read_fd(FileData *fd, ExifFast *ef);
+
 /* exif_read returns processed data (merged from image and sidecar, etc.)
    this function gives access to the original data from the image.
    original data are part of the processed data and should not be freed separately */
@@ -131,6 +151,7 @@ ExifItem *exif_get_next_item(ExifData *exif);
 gchar *exif_item_get_tag_name(ExifItem *item);
 guint exif_item_get_tag_id(ExifItem *item);
 guint exif_item_get_elements(ExifItem *item);
+guint exif_item_get_size(ExifItem *item);
 gchar *exif_item_get_data(ExifItem *item, guint *data_len);
 gchar *exif_item_get_description(ExifItem *item);
 guint exif_item_get_format_id(ExifItem *item);
@@ -148,6 +169,10 @@ gchar *exif_get_formatted_by_key(ExifData *exif, const gchar *key, gboolean *key
 
 gint exif_update_metadata(ExifData *exif, const gchar *key, const GList *values);
 GList *exif_get_metadata(ExifData *exif, const gchar *key, MetadataFormat format);
+/* the values of item, as exif_get_metadata() reads them for a key found once */
+GList *exif_item_get_metadata(ExifItem *item, MetadataFormat format);
+/* the key read by exif_get_metadata() when key itself is not found, or NULL */
+const gchar *exif_get_metadata_alt_key(const gchar *key);
 
 guchar *exif_get_color_profile(ExifData *exif, guint *data_len);
 
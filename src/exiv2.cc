@@ -445,11 +445,27 @@ public:
 extern "C" {
 
 
+#if EXIV2_TEST_VERSION(0,21,0)
+/* the XMP toolkit is not thread safe, exif data are read in worker threads too */
+static GMutex exif_xmp_mutex;
+
+static void exif_xmp_lock(void *data, bool lock)
+{
+	if (lock)
+		g_mutex_lock(&exif_xmp_mutex);
+	else
+		g_mutex_unlock(&exif_xmp_mutex);
+}
+#endif
+
 void exif_init(void)
 {
 #ifdef EXV_ENABLE_NLS
 	bind_textdomain_codeset (EXV_PACKAGE, "UTF-8");
 #endif
+#if EXIV2_TEST_VERSION(0,21,0)
+	Exiv2::XmpParser::initialize(exif_xmp_lock, NULL);
+#endif
 }
 
 
@@ -687,6 +703,18 @@ guint exif_item_get_elements(ExifItem *item)
 	}
 }
 
+guint exif_item_get_size(ExifItem *item)
+{
+	try {
+		if (!item) return 0;
+		return ((Exiv2::Metadatum *)item)->size();
+	}
+	catch (Exiv2::AnyError& e) {
+		debug_exception(e);
+		return 0;
+	}
+}
+
 char *exif_item_get_data(ExifItem *item, guint *data_len)
 {
 	try {
@@ -1138,6 +1166,31 @@ GList *exif_get_metadata(ExifData *exif, const gchar *key, MetadataFormat format
 	return list;
 }
 
+GList *exif_item_get_metadata(ExifItem *item, MetadataFormat format)
+{
+	try {
+		if (!item) return NULL;
+		return exif_add_value_to_glist(NULL, *(Exiv2::Metadatum *)item, format, NULL);
+	}
+	catch (Exiv2::AnyError& e) {
+		debug_exception(e);
+		return NULL;
+	}
+}
+
+
+const gchar *exif_get_metadata_alt_key(const gchar *key)
+{
+	const AltKey *alt_key = find_alt_key(key);
+
+	if (!alt_key) return NULL;
+	if (alt_key->iptc_key) return alt_key->iptc_key;
+#if !EXIV2_TEST_VERSION(0,17,0)
+	return alt_key->exif_key;
+#else
+	return NULL;
+#endif
+}
 
 void exif_add_jpeg_color_profile(ExifData *exif, unsigned char *cp_data, guint cp_length)
 {
@@ -24,19 +24,35 @@
 /* Set to TRUE to add file cache dumps to the debug output */
 const gboolean debug_file_cache = FALSE;
 
-/* this implements a simple LRU algorithm */
+/* this implements a simple LRU algorithm
+ *
+ * entries are kept in a doubly linked list ordered from the most recently
+ * used (head) to the least recently used (tail), and indexed by FileData
+ * in a hash table, so lookup, move to front and removal are all O(1)
+ */
+
+typedef struct _FileCacheEntry FileCacheEntry;
+struct _FileCacheEntry {
+	FileData *fd;
+	gulong size;
+
+	FileCacheEntry *prev;
+	FileCacheEntry *next;
+};
 
 struct _FileCacheData {
 	FileCacheReleaseFunc release;
-	GList *list;
+	GHashTable *table;
+	FileCacheEntry *head;
+	FileCacheEntry *tail;
 	gulong max_size;
 	gulong size;
-};
 
-typedef struct _FileCacheEntry FileCacheEntry;
-struct _FileCacheEntry {
-	FileData *fd;
-	gulong size;
+	/* statistics */
+	gulong hits;
+	gulong misses;
+	gulong evictions;
+	gulong invalidations;
 };
 
 static void file_cache_notify_cb(FileData *fd, NotifyType type, gpointer data);
@@ -44,10 +60,12 @@ static void file_cache_remove_fd(FileCacheData *fc, FileData *fd);
 
 FileCacheData *file_cache_new(FileCacheReleaseFunc release, gulong max_size)
 {
-	FileCacheData *fc = g_new(FileCacheData, 1);
+	FileCacheData *fc = g_new0(FileCacheData, 1);
 
 	fc->release = release;
-	fc->list = NULL;
+	fc->table = g_hash_table_new(g_direct_hash, g_direct_equal);
+	fc->head = NULL;
+	fc->tail = NULL;
 	fc->max_size = max_size;
 	fc->size = 0;
 
@@ -56,61 +74,103 @@ FileCacheData *file_cache_new(FileCacheReleaseFunc release, gulong max_size)
 	return fc;
 }
 
+static void file_cache_unlink(FileCacheData *fc, FileCacheEntry *fe)
+{
+	if (fe->prev)
+		fe->prev->next = fe->next;
+	else
+		fc->head = fe->next;
+
+	if (fe->next)
+		fe->next->prev = fe->prev;
+	else
+		fc->tail = fe->prev;
+
+	fe->prev = NULL;
+	fe->next = NULL;
+}
+
+static void file_cache_link_head(FileCacheData *fc, FileCacheEntry *fe)
+{
+	fe->prev = NULL;
+	fe->next = fc->head;
+	if (fc->head) fc->head->prev = fe;
+	fc->head = fe;
+	if (!fc->tail) fc->tail = fe;
+}
+
+static void file_cache_entry_free(FileCacheData *fc, FileCacheEntry *fe)
+{
+	file_cache_unlink(fc, fe);
+	g_hash_table_remove(fc->table, fe->fd);
+
+	fc->size -= fe->size;
+	fc->release(fe->fd);
+	file_data_unref(fe->fd);
+	g_free(fe);
+}
+
 gboolean file_cache_get(FileCacheData *fc, FileData *fd)
 {
-	GList *work;
+	FileCacheEntry *fe;
 
 	g_assert(fc && fd);
 
-	work = fc->list;
-	while (work)
+	fe = g_hash_table_lookup(fc->table, fd);
+	if (!fe)
 		{
-		FileCacheEntry *fce = work->data;
-		if (fce->fd == fd)
-			{
-			/* entry exists */
-			DEBUG_2("cache hit: fc=%p %s", fc, fd->path);
-			if (work == fc->list) return TRUE; /* already at the beginning */
-			/* move it to the beginning */
-			DEBUG_2("cache move to front: fc=%p %s", fc, fd->path);
-			fc->list = g_list_remove_link(fc->list, work);
-			fc->list = g_list_concat(work, fc->list);
-
-			if (file_data_check_changed_files(fd)) {
-				/* file has been changed, cance entry is no longer valid */
-				file_cache_remove_fd(fc, fd);
-				return FALSE;
-			}
-			if (debug_file_cache) file_cache_dump(fc);
-			return TRUE;
-			}
-		work = work->next;
+		fc->misses++;
+		DEBUG_2("cache miss: fc=%p %s", fc, fd->path);
+		return FALSE;
 		}
-	DEBUG_2("cache miss: fc=%p %s", fc, fd->path);
-	return FALSE;
+
+	/* entry exists */
+	DEBUG_2("cache hit: fc=%p %s", fc, fd->path);
+	if (fe == fc->head)
+		{
+		/* already at the beginning */
+		fc->hits++;
+		return TRUE;
+		}
+
+	/* move it to the beginning */
+	DEBUG_2("cache move to front: fc=%p %s", fc, fd->path);
+	file_cache_unlink(fc, fe);
+	file_cache_link_head(fc, fe);
+
+	if (file_data_check_changed_files(fd))
+		{
+		/* file has been changed, cache entry is no longer valid */
+		file_cache_remove_fd(fc, fd);
+		fc->misses++;
+		return FALSE;
+		}
+
+	fc->hits++;
+	if (debug_file_cache) file_cache_dump(fc);
+	return TRUE;
 }
 
 void file_cache_set_size(FileCacheData *fc, gulong size)
 {
-	GList *work;
-	FileCacheEntry *last_fe;
+	gulong evicted = 0;
 
 	if (debug_file_cache) file_cache_dump(fc);
 
-	work = g_list_last(fc->list);
-	while (fc->size > size && work)
+	while (fc->size > size && fc->tail)
+		{
+		FileCacheEntry *last_fe = fc->tail;
+
+		DEBUG_2("cache evict: fc=%p %s", fc, last_fe->fd->path);
+		file_cache_entry_free(fc, last_fe);
+		evicted++;
+		}
+
+	if (evicted)
 		{
-		GList *prev;
-		last_fe = work->data;
-		prev = work->prev;
-		fc->list = g_list_delete_link(fc->list, work);
-		work = prev;
-
-		DEBUG_2("file changed - cache remove: fc=%p %s", fc, last_fe->fd->path);
-		fc->size -= last_fe->size;
-		fc->release(last_fe->fd);
-		file_data_unref(last_fe->fd);
-		g_free(last_fe);
+		fc->evictions += evicted;
+		DEBUG_1("cache evicted %lu: fc=%p size:%lu max size:%lu hits:%lu misses:%lu evictions:%lu",
+			evicted, fc, fc->size, fc->max_size, fc->hits, fc->misses, fc->evictions);
 		}
 }
 
@@ -118,13 +178,28 @@ void file_cache_put(FileCacheData *fc, FileData *fd, gulong size)
 {
 	FileCacheEntry *fe;
 
-	if (file_cache_get(fc, fd)) return;
+	fe = g_hash_table_lookup(fc->table, fd);
+	if (fe)
+		{
+		/* the data was put again, it may have another size */
+		if (fe != fc->head)
+			{
+			file_cache_unlink(fc, fe);
+			file_cache_link_head(fc, fe);
+			}
+		fc->size += size - fe->size;
+		fe->size = size;
+
+		file_cache_set_size(fc, fc->max_size);
+		return;
+		}
 
 	DEBUG_2("cache add: fc=%p %s", fc, fd->path);
-	fe = g_new(FileCacheEntry, 1);
+	fe = g_new0(FileCacheEntry, 1);
 	fe->fd = file_data_ref(fd);
 	fe->size = size;
-	fc->list = g_list_prepend(fc->list, fe);
+	file_cache_link_head(fc, fe);
+	g_hash_table_insert(fc->table, fd, fe);
 	fc->size += size;
 
 	file_cache_set_size(fc, fc->max_size);
@@ -148,43 +223,32 @@ void file_cache_set_max_size(FileCacheData *fc, gulong size)
 
 static void file_cache_remove_fd(FileCacheData *fc, FileData *fd)
 {
-	GList *work;
 	FileCacheEntry *fe;
 
 	if (debug_file_cache) file_cache_dump(fc);
 
-	work = fc->list;
-	while (work)
-		{
-		GList *current = work;
-		fe = work->data;
-		work = work->next;
-
-		if (fe->fd == fd)
-			{
-			fc->list = g_list_delete_link(fc->list, current);
+	fe = g_hash_table_lookup(fc->table, fd);
+	if (!fe) return;
 
-			DEBUG_1("cache remove: fc=%p %s", fc, fe->fd->path);
-			fc->size -= fe->size;
-			fc->release(fe->fd);
-			file_data_unref(fe->fd);
-			g_free(fe);
-			}
-		}
+	DEBUG_1("cache remove: fc=%p %s", fc, fe->fd->path);
+	fc->invalidations++;
+	file_cache_entry_free(fc, fe);
 }
 
 void file_cache_dump(FileCacheData *fc)
 {
-	GList *work = fc->list;
+	FileCacheEntry *fe = fc->head;
 	gulong n = 0;
+	gulong lookups = fc->hits + fc->misses;
 
-	DEBUG_1("cache dump: fc=%p max size:%ld size:%ld", fc, fc->max_size, fc->size);
+	DEBUG_1("cache dump: fc=%p max size:%ld size:%ld entries:%u", fc, fc->max_size, fc->size, g_hash_table_size(fc->table));
+	DEBUG_1("cache stats: fc=%p hits:%lu misses:%lu (%.1f%% hit rate) evictions:%lu invalidations:%lu",
+		fc, fc->hits, fc->misses, lookups ? 100.0 * fc->hits / lookups : 0.0, fc->evictions, fc->invalidations);
 
-	while (work)
+	while (fe)
 		{
-		FileCacheEntry *fe = work->data;
-		work = work->next;
 		DEBUG_1("cache entry: fc=%p [%lu] %s %ld", fc, ++n, fe->fd->path, fe->size);
+		fe = fe->next;
 		}
 }
 
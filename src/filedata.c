@@ -24,6 +24,7 @@
 
 #include "filefilter.h"
 #include "cache.h"
+#include "cache-dirlist.h"
 #include "thumb_standard.h"
 #include "ui_fileops.h"
 #include "metadata.h"
@@ -178,6 +179,8 @@ static gboolean file_data_check_changed_single_file(FileData *fd, struct stat *s
 		fd->date = st->st_mtime;
 		fd->cdate = st->st_ctime;
 		fd->mode = st->st_mode;
+		fd->exifdate = 0;
+		fd->exifdate_digitized = 0;
 		if (fd->thumb_pixbuf) g_object_unref(fd->thumb_pixbuf);
 		fd->thumb_pixbuf = NULL;
 		file_data_increment_version(fd);
@@ -430,6 +433,8 @@ static FileData *file_data_new(const gchar *path_utf8, struct stat *st, gboolean
 	fd->date = st->st_mtime;
 	fd->cdate = st->st_ctime;
 	fd->mode = st->st_mode;
+	fd->uid = st->st_uid;
+	fd->gid = st->st_gid;
 	fd->ref = 1;
 	fd->magick = FD_MAGICK;
 	fd->exifdate = 0;
@@ -497,6 +502,26 @@ FileData *file_data_new_simple(const gchar *path_utf8)
 	return fd;
 }
 
+/* converts an exif date as "YYYY:MM:DD HH:MM:SS" to local time, 0 if it is not valid */
+time_t exif_time_data_parse(const gchar *text)
+{
+	struct tm time_str;
+	gint year, month, day, hour, min, sec;
+
+	if (sscanf(text, "%4d:%2d:%2d %2d:%2d:%2d", &year, &month, &day, &hour, &min, &sec) != 6) return 0;
+
+	memset(&time_str, 0, sizeof(time_str));
+	time_str.tm_year  = year - 1900;
+	time_str.tm_mon   = month - 1;
+	time_str.tm_mday  = day;
+	time_str.tm_hour  = hour;
+	time_str.tm_min   = min;
+	time_str.tm_sec   = sec;
+	time_str.tm_isdst = 0;
+
+	return mktime(&time_str);
+}
+
 void read_exif_time_data(FileData *file)
 {
 	if (file->exifdate > 0)
@@ -507,6 +532,14 @@ void read_exif_time_data(FileData *file)
 
 	if (!file->exif)
 		{
+		ExifFast ef;
+
+		if (exif_fast_read_fd(file, &ef))
+			{
+			if (ef.date_time_original[0]) file->exifdate = exif_time_data_parse(ef.date_time_original);
+			return;
+			}
+
 		exif_read_fd(file);
 		}
 
@@ -517,19 +550,7 @@ void read_exif_time_data(FileData *file)
 
 		if (tmp)
 			{
-			struct tm time_str;
-			uint year, month, day, hour, min, sec;
-
-			sscanf(tmp, "%4d:%2d:%2d %2d:%2d:%2d", &year, &month, &day, &hour, &min, &sec);
-			time_str.tm_year  = year - 1900;
-			time_str.tm_mon   = month - 1;
-			time_str.tm_mday  = day;
-			time_str.tm_hour  = hour;
-			time_str.tm_min   = min;
-			time_str.tm_sec   = sec;
-			time_str.tm_isdst = 0;
-
-			file->exifdate = mktime(&time_str);
+			file->exifdate = exif_time_data_parse(tmp);
 			g_free(tmp);
 			}
 		}
@@ -545,6 +566,14 @@ void read_exif_time_digitized_data(FileData *file)
 
 	if (!file->exif)
 		{
+		ExifFast ef;
+
+		if (exif_fast_read_fd(file, &ef))
+			{
+			if (ef.date_time_digitized[0]) file->exifdate_digitized = exif_time_data_parse(ef.date_time_digitized);
+			return;
+			}
+
 		exif_read_fd(file);
 		}
 
@@ -555,19 +584,7 @@ void read_exif_time_digitized_data(FileData *file)
 
 		if (tmp)
 			{
-			struct tm time_str;
-			uint year, month, day, hour, min, sec;
-
-			sscanf(tmp, "%4d:%2d:%2d %2d:%2d:%2d", &year, &month, &day, &hour, &min, &sec);
-			time_str.tm_year  = year - 1900;
-			time_str.tm_mon   = month - 1;
-			time_str.tm_mday  = day;
-			time_str.tm_hour  = hour;
-			time_str.tm_min   = min;
-			time_str.tm_sec   = sec;
-			time_str.tm_isdst = 0;
-
-			file->exifdate_digitized = mktime(&time_str);
+			file->exifdate_digitized = exif_time_data_parse(tmp);
 			g_free(tmp);
 			}
 		}
@@ -1335,22 +1352,267 @@ static gboolean is_hidden_file(const gchar *name)
 	return TRUE;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * directory scanning
+ *
+ * The readdir() and stat() calls do not touch any FileData and may run in a
+ * worker thread, the FileData are created from the results on the main thread.
+ *-----------------------------------------------------------------------------
+ */
+
+#define FILELIST_STAT_THREADS 8		/* stat() calls in parallel, they mostly wait on network file systems */
+#define FILELIST_STAT_PARALLEL_MIN 64	/* fewer entries per thread are not worth starting it */
+#define FILELIST_READ_CHUNK 1024	/* entries passed to the main thread at once by filelist_read_async() */
+
+typedef struct _FileListEntry FileListEntry;
+struct _FileListEntry
+{
+	gchar *name;
+	struct stat st;
+	gint error; /* errno of the stat, 0 on success */
+};
+
+typedef struct _FileListStat FileListStat;
+struct _FileListStat
+{
+	gint dir_fd;
+	gint flags;
+	FileListEntry *entries;
+	guint count;
+};
+
+static gpointer filelist_stat_thread(gpointer data)
+{
+	FileListStat *fs = data;
+	guint i;
+
+	for (i = 0; i < fs->count; i++)
+		{
+		FileListEntry *fe = &fs->entries[i];
+
+		fe->error = (fstatat(fs->dir_fd, fe->name, &fe->st, fs->flags) < 0) ? errno : 0;
+		}
+
+	return NULL;
+}
+
+/* stats the entries relative to the open directory dir_fd, in several threads when there are many */
+static void filelist_stat_entries(gint dir_fd, gboolean follow_symlinks, FileListEntry *entries, guint count)
+{
+	FileListStat fs[FILELIST_STAT_THREADS];
+	guint threads;
+	guint per_thread;
+	guint start = 0;
+	guint i;
+
+	threads = CLAMP(count / FILELIST_STAT_PARALLEL_MIN, 1, FILELIST_STAT_THREADS);
+	per_thread = (count + threads - 1) / MAX(threads, 1);
+
+	for (i = 0; i < threads; i++)
+		{
+		fs[i].dir_fd = dir_fd;
+		fs[i].flags = follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+		fs[i].entries = entries + start;
+		fs[i].count = MIN(per_thread, count - start);
+		start += fs[i].count;
+		}
+
+#ifdef HAVE_GTHREAD
+	if (threads > 1)
+		{
+		GThread *thread[FILELIST_STAT_THREADS];
+
+		for (i = 1; i < threads; i++)
+			{
+			thread[i] = g_thread_try_new("filelist_stat", filelist_stat_thread, &fs[i], NULL);
+			}
+
+		filelist_stat_thread(&fs[0]);
+
+		for (i = 1; i < threads; i++)
+			{
+			if (thread[i])
+				{
+				g_thread_join(thread[i]);
+				}
+			else
+				{
+				filelist_stat_thread(&fs[i]);
+				}
+			}
+		return;
+		}
+#endif
+
+	for (i = 0; i < threads; i++)
+		{
+		filelist_stat_thread(&fs[i]);
+		}
+}
+
+/* returns the names of the entries of dp as an array of FileListEntry, not yet stat()ed */
+static GArray *filelist_read_names(DIR *dp, gboolean show_hidden)
+{
+	GArray *entries;
+	struct dirent *dir;
+
+	entries = g_array_new(FALSE, TRUE, sizeof(FileListEntry));
+
+	while ((dir = readdir(dp)) != NULL)
+		{
+		FileListEntry fe;
+
+		if (!show_hidden && is_hidden_file(dir->d_name))
+			continue;
+
+		memset(&fe, 0, sizeof(fe));
+		fe.name = g_strdup(dir->d_name);
+		g_array_append_val(entries, fe);
+		}
+
+	return entries;
+}
+
+static void filelist_entries_free(GArray *entries, guint start)
+{
+	guint i;
+
+	if (!entries) return;
+
+	for (i = start; i < entries->len; i++)
+		{
+		g_free(g_array_index(entries, FileListEntry, i).name);
+		}
+	g_array_free(entries, TRUE);
+}
+
 /*
  *-----------------------------------------------------------------------------
  * the main filelist function
  *-----------------------------------------------------------------------------
  */
 
+typedef struct _FileListBuild FileListBuild;
+struct _FileListBuild
+{
+	gchar *pathl;
+	gboolean files;
+	gboolean dirs;
+
+	GList *flist;
+	GList *dlist;
+	GList *xmp_files;
+	GHashTable *basename_hash;
+};
+
+static void filelist_build_init(FileListBuild *fb, const gchar *pathl, gboolean files, gboolean dirs)
+{
+	memset(fb, 0, sizeof(FileListBuild));
+
+	fb->pathl = g_strdup(pathl);
+	fb->files = files;
+	fb->dirs = dirs;
+
+	if (files) fb->basename_hash = file_data_basename_hash_new();
+}
+
+/* creates the FileData of a stat()ed entry */
+static void filelist_build_add(FileListBuild *fb, FileListEntry *fe)
+{
+	struct stat *ent_sbuf = &fe->st;
+	const gchar *name = fe->name;
+	gchar *filepath;
+
+	filepath = g_build_filename(fb->pathl, name, NULL);
+	if (fe->error == 0)
+		{
+		if (S_ISDIR(ent_sbuf->st_mode))
+			{
+			/* we ignore the .thumbnails dir for cleanliness */
+			if (fb->dirs &&
+			    !(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) &&
+			    strcmp(name, GQ_CACHE_LOCAL_THUMB) != 0 &&
+			    strcmp(name, GQ_CACHE_LOCAL_METADATA) != 0 &&
+			    strcmp(name, THUMB_FOLDER_LOCAL) != 0)
+				{
+				fb->dlist = g_list_prepend(fb->dlist, file_data_new_local(filepath, ent_sbuf, TRUE));
+				}
+			}
+		else
+			{
+			if (fb->files && filter_name_exists(name))
+				{
+				FileData *fd = file_data_new_local(filepath, ent_sbuf, FALSE);
+				fb->flist = g_list_prepend(fb->flist, fd);
+				if (fd->sidecar_priority && !fd->disable_grouping)
+					{
+					if (strcmp(fd->extension, ".xmp") != 0)
+						file_data_basename_hash_insert(fb->basename_hash, fd);
+					else
+						fb->xmp_files = g_list_append(fb->xmp_files, fd);
+					}
+				}
+			}
+		}
+	else
+		{
+		if (fe->error == EOVERFLOW)
+			{
+			log_printf("stat(): EOVERFLOW, skip '%s'", filepath);
+			}
+		}
+	g_free(filepath);
+}
+
+/* groups the sidecars, once all entries are added */
+static void filelist_build_finish(FileListBuild *fb, GList **files, GList **dirs)
+{
+	if (fb->xmp_files)
+		{
+		g_list_foreach(fb->xmp_files,file_data_basename_hash_insert_cb,fb->basename_hash);
+		g_list_free(fb->xmp_files);
+		fb->xmp_files = NULL;
+		}
+
+	if (dirs) *dirs = fb->dlist;
+	fb->dlist = NULL;
+
+	if (files)
+		{
+		g_hash_table_foreach(fb->basename_hash, file_data_basename_hash_to_sidecars, NULL);
+
+		*files = filelist_filter_out_sidecars(fb->flist);
+		fb->flist = NULL;
+		}
+	if (fb->basename_hash) file_data_basename_hash_free(fb->basename_hash);
+	fb->basename_hash = NULL;
+
+	g_free(fb->pathl);
+	fb->pathl = NULL;
+}
+
+static void filelist_build_free(FileListBuild *fb)
+{
+	g_list_free(fb->xmp_files);
+	fb->xmp_files = NULL;
+	if (fb->basename_hash) file_data_basename_hash_free(fb->basename_hash);
+	fb->basename_hash = NULL;
+	filelist_free(fb->flist);
+	fb->flist = NULL;
+	filelist_free(fb->dlist);
+	fb->dlist = NULL;
+	g_free(fb->pathl);
+	fb->pathl = NULL;
+}
+
 static gboolean filelist_read_real(const gchar *dir_path, GList **files, GList **dirs, gboolean follow_symlinks)
 {
 	DIR *dp;
-	struct dirent *dir;
 	gchar *pathl;
-	GList *dlist = NULL;
-	GList *flist = NULL;
-	GList *xmp_files = NULL;
-	gint (*stat_func)(const gchar *path, struct stat *buf);
-	GHashTable *basename_hash = NULL;
+	GArray *entries;
+	FileListBuild fb;
+	guint i;
 
 	g_assert(files || dirs);
 
@@ -1367,94 +1629,313 @@ static gboolean filelist_read_real(const gchar *dir_path, GList **files, GList *
 		return FALSE;
 		}
 
-	if (files) basename_hash = file_data_basename_hash_new();
+	entries = filelist_read_names(dp, options->file_filter.show_hidden_files);
+	filelist_stat_entries(dirfd(dp), follow_symlinks, (FileListEntry *)entries->data, entries->len);
 
-	if (follow_symlinks)
-		stat_func = stat;
-	else
-		stat_func = lstat;
+	closedir(dp);
 
-	while ((dir = readdir(dp)) != NULL)
+	filelist_build_init(&fb, pathl, files != NULL, dirs != NULL);
+	for (i = 0; i < entries->len; i++)
 		{
-		struct stat ent_sbuf;
-		const gchar *name = dir->d_name;
+		filelist_build_add(&fb, &g_array_index(entries, FileListEntry, i));
+		}
+	filelist_build_finish(&fb, files, dirs);
+
+	filelist_entries_free(entries, 0);
+	g_free(pathl);
+
+	return TRUE;
+}
+
+gboolean filelist_read(FileData *dir_fd, GList **files, GList **dirs)
+{
+	return filelist_read_real(dir_fd->path, files, dirs, TRUE);
+}
+
+gboolean filelist_read_lstat(FileData *dir_fd, GList **files, GList **dirs)
+{
+	return filelist_read_real(dir_fd->path, files, dirs, FALSE);
+}
+
+/* reads the files of dir_fd from the snapshot stored by cache_dir_list_save(),
+ * returns FALSE if there is none for dir_mtime
+ */
+gboolean filelist_read_snapshot(FileData *dir_fd, time_t dir_mtime, GList **files)
+{
+	GList *entries;
+	GList *work;
+	gchar *pathl;
+	FileListBuild fb;
+
+	*files = NULL;
+
+	if (!cache_dir_list_load(dir_fd->path, dir_mtime, &entries)) return FALSE;
+
+	pathl = path_from_utf8(dir_fd->path);
+	filelist_build_init(&fb, pathl, TRUE, FALSE);
+
+	for (work = entries; work; work = work->next)
+		{
+		CacheDirListEntry *entry = work->data;
+		FileListEntry fe;
+		FileData *fd;
 		gchar *filepath;
+		gchar *path_utf8;
 
-		if (!options->file_filter.show_hidden_files && is_hidden_file(name))
-			continue;
+		if (!options->file_filter.show_hidden_files && is_hidden_file(entry->name)) continue;
 
-		filepath = g_build_filename(pathl, name, NULL);
-		if (stat_func(filepath, &ent_sbuf) >= 0)
-			{
-			if (S_ISDIR(ent_sbuf.st_mode))
-				{
-				/* we ignore the .thumbnails dir for cleanliness */
-				if (dirs &&
-				    !(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) &&
-				    strcmp(name, GQ_CACHE_LOCAL_THUMB) != 0 &&
-				    strcmp(name, GQ_CACHE_LOCAL_METADATA) != 0 &&
-				    strcmp(name, THUMB_FOLDER_LOCAL) != 0)
-					{
-					dlist = g_list_prepend(dlist, file_data_new_local(filepath, &ent_sbuf, TRUE));
-					}
-				}
-			else
-				{
-				if (files && filter_name_exists(name))
-					{
-					FileData *fd = file_data_new_local(filepath, &ent_sbuf, FALSE);
-					flist = g_list_prepend(flist, fd);
-					if (fd->sidecar_priority && !fd->disable_grouping)
-						{
-						if (strcmp(fd->extension, ".xmp") != 0)
-							file_data_basename_hash_insert(basename_hash, fd);
-						else
-							xmp_files = g_list_append(xmp_files, fd);
-						}
-					}
-				}
-			}
-		else
+		memset(&fe, 0, sizeof(fe));
+		fe.name = entry->name;
+		fe.st.st_mode = entry->mode;
+		fe.st.st_uid = entry->uid;
+		fe.st.st_gid = entry->gid;
+		fe.st.st_size = entry->size;
+		fe.st.st_mtime = entry->mtime;
+		fe.st.st_ctime = entry->ctime;
+
+		filepath = g_build_filename(pathl, entry->name, NULL);
+		path_utf8 = path_to_utf8(filepath);
+
+		/* a FileData still in use is newer than the snapshot, it must not be reverted */
+		fd = file_data_pool ? g_hash_table_lookup(file_data_pool, path_utf8) : NULL;
+		if (fd)
 			{
-			if (errno == EOVERFLOW)
-				{
-				log_printf("stat(): EOVERFLOW, skip '%s'", filepath);
-				}
+			fe.st.st_mode = fd->mode;
+			fe.st.st_size = fd->size;
+			fe.st.st_mtime = fd->date;
+			fe.st.st_ctime = fd->cdate;
 			}
+
+		filelist_build_add(&fb, &fe);
+
+		g_free(path_utf8);
 		g_free(filepath);
 		}
 
-	closedir(dp);
+	filelist_build_finish(&fb, files, NULL);
 
+	cache_dir_list_free(entries);
 	g_free(pathl);
 
-	if (xmp_files)
+	return TRUE;
+}
+
+static void filelist_apply_snapshot_file(FileData *fd, GHashTable *names)
+{
+	CacheDirListEntry *entry;
+	gchar *namel;
+
+	namel = path_from_utf8(fd->name);
+	entry = g_hash_table_lookup(names, namel);
+	g_free(namel);
+
+	if (!entry || fd->size != entry->size || fd->date != (time_t)entry->mtime) return;
+
+	/* spares reading the exif data again for sorting */
+	if (fd->exifdate == 0) fd->exifdate = (time_t)entry->exifdate;
+	if (fd->exifdate_digitized == 0) fd->exifdate_digitized = (time_t)entry->exifdate_digitized;
+}
+
+/* sets the exif dates stored in the snapshot for dir_mtime on files, which must be
+ * read from the file system after filelist_read_snapshot(): the snapshot itself
+ * can not tell a file rewritten in place, only the files whose size and mtime
+ * were confirmed by that read get the stored dates
+ */
+void filelist_apply_snapshot(FileData *dir_fd, time_t dir_mtime, GList *files)
+{
+	GList *entries;
+	GList *work;
+	GHashTable *names;
+
+	if (!cache_dir_list_load(dir_fd->path, dir_mtime, &entries)) return;
+
+	names = g_hash_table_new(g_str_hash, g_str_equal);
+	for (work = entries; work; work = work->next)
 		{
-		g_list_foreach(xmp_files,file_data_basename_hash_insert_cb,basename_hash);
-		g_list_free(xmp_files);
+		CacheDirListEntry *entry = work->data;
+
+		g_hash_table_insert(names, entry->name, entry);
 		}
 
-	if (dirs) *dirs = dlist;
+	for (work = files; work; work = work->next)
+		{
+		FileData *fd = work->data;
+		GList *sidecars;
 
-	if (files)
+		filelist_apply_snapshot_file(fd, names);
+		for (sidecars = fd->sidecar_files; sidecars; sidecars = sidecars->next)
+			{
+			filelist_apply_snapshot_file(sidecars->data, names);
+			}
+		}
+
+	g_hash_table_destroy(names);
+	cache_dir_list_free(entries);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ * reading a directory in the background
+ *-----------------------------------------------------------------------------
+ */
+
+struct _FileListReader
+{
+	gint refcount; /* the caller and the worker, atomic */
+	gint cancelled; /* atomic */
+
+	gchar *pathl;
+	gboolean follow_symlinks;
+	gboolean show_hidden;
+
+	/* main thread only */
+	FileListBuild build;
+	FileListReadFunc func;
+	gpointer data;
+};
+
+typedef struct _FileListReadChunk FileListReadChunk;
+struct _FileListReadChunk
+{
+	FileListReader *fr;
+	GArray *entries;
+	gboolean success;
+	gboolean last;
+};
+
+static void filelist_reader_unref(FileListReader *fr)
+{
+	if (!g_atomic_int_dec_and_test(&fr->refcount)) return;
+
+	g_free(fr->pathl);
+	g_free(fr);
+}
+
+static gboolean filelist_read_async_chunk_cb(gpointer data)
+{
+	FileListReadChunk *chunk = data;
+	FileListReader *fr = chunk->fr;
+
+	if (!g_atomic_int_get(&fr->cancelled))
 		{
-		g_hash_table_foreach(basename_hash, file_data_basename_hash_to_sidecars, NULL);
+		guint i;
+
+		for (i = 0; chunk->entries && i < chunk->entries->len; i++)
+			{
+			filelist_build_add(&fr->build, &g_array_index(chunk->entries, FileListEntry, i));
+			}
+
+		if (chunk->last)
+			{
+			GList *files = NULL;
+			GList *dirs = NULL;
 
-		*files = filelist_filter_out_sidecars(flist);
+			filelist_build_finish(&fr->build, fr->build.files ? &files : NULL, fr->build.dirs ? &dirs : NULL);
+			g_atomic_int_set(&fr->cancelled, TRUE);
+
+			fr->func(fr, chunk->success, files, dirs, fr->data);
+			filelist_reader_unref(fr);
+			}
 		}
-	if (basename_hash) file_data_basename_hash_free(basename_hash);
 
-	return TRUE;
+	filelist_entries_free(chunk->entries, 0);
+	filelist_reader_unref(chunk->fr);
+	g_free(chunk);
+
+	return FALSE;
 }
 
-gboolean filelist_read(FileData *dir_fd, GList **files, GList **dirs)
+/* does the readdir() and stat() calls, the results are passed to the main thread in chunks */
+static gpointer filelist_read_async_thread(gpointer data)
 {
-	return filelist_read_real(dir_fd->path, files, dirs, TRUE);
+	FileListReader *fr = data;
+	DIR *dp;
+	GArray *names = NULL;
+	guint start = 0;
+	gboolean last = FALSE;
+
+	dp = opendir(fr->pathl);
+	if (dp) names = filelist_read_names(dp, fr->show_hidden);
+
+	while (!last)
+		{
+		FileListReadChunk *chunk;
+
+		chunk = g_new0(FileListReadChunk, 1);
+		chunk->fr = fr;
+		chunk->success = (dp != NULL);
+		g_atomic_int_inc(&fr->refcount);
+
+		if (names && !g_atomic_int_get(&fr->cancelled))
+			{
+			guint count = MIN(FILELIST_READ_CHUNK, names->len - start);
+
+			chunk->entries = g_array_sized_new(FALSE, TRUE, sizeof(FileListEntry), count);
+			g_array_append_vals(chunk->entries, &g_array_index(names, FileListEntry, start), count);
+			start += count;
+
+			filelist_stat_entries(dirfd(dp), fr->follow_symlinks, (FileListEntry *)chunk->entries->data, count);
+			}
+
+		last = (!names || start >= names->len || g_atomic_int_get(&fr->cancelled));
+		chunk->last = last;
+
+		g_idle_add(filelist_read_async_chunk_cb, chunk);
+		}
+
+	/* the names passed in chunks are owned by them now */
+	filelist_entries_free(names, start);
+	if (dp) closedir(dp);
+
+	filelist_reader_unref(fr);
+
+	return NULL;
 }
 
-gboolean filelist_read_lstat(FileData *dir_fd, GList **files, GList **dirs)
+/* reads the directory like filelist_read(), without blocking the main thread,
+ * func is called with the lists when done, they are owned by the callee
+ */
+FileListReader *filelist_read_async(FileData *dir_fd, gboolean files, gboolean dirs,
+				    FileListReadFunc func, gpointer data)
 {
-	return filelist_read_real(dir_fd->path, files, dirs, FALSE);
+	FileListReader *fr;
+	gchar *pathl;
+
+	g_assert(files || dirs);
+
+	pathl = path_from_utf8(dir_fd->path);
+	if (!pathl) return NULL;
+
+	fr = g_new0(FileListReader, 1);
+	fr->refcount = 2;
+	fr->pathl = pathl;
+	fr->follow_symlinks = TRUE;
+	fr->show_hidden = options->file_filter.show_hidden_files;
+	fr->func = func;
+	fr->data = data;
+
+	filelist_build_init(&fr->build, pathl, files, dirs);
+
+#ifdef HAVE_GTHREAD
+	if (g_thread_try_new("filelist_read", filelist_read_async_thread, fr, NULL))
+		{
+		return fr;
+		}
+#endif
+	/* the results are still delivered from idle */
+	filelist_read_async_thread(fr);
+
+	return fr;
+}
+
+/* stops a read, valid until func was called */
+void filelist_read_async_cancel(FileListReader *fr)
+{
+	if (!fr) return;
+
+	g_atomic_int_set(&fr->cancelled, TRUE);
+	filelist_build_free(&fr->build);
+	filelist_reader_unref(fr);
 }
 
 FileData *file_data_new_group(const gchar *path_utf8)
@@ -3234,12 +3715,49 @@ void file_data_send_notification(FileData *fd, NotifyType type)
     */
 }
 
-static GHashTable *file_data_monitor_pool = NULL;
+/*
+ *-----------------------------------------------------------------------------
+ * realtime monitor
+ *
+ * Each watched directory gets one GFileMonitor, which uses inotify on Linux.
+ * Events are collected for REALTIME_MONITOR_DELAY and then the affected
+ * FileData are checked by file_data_check_changed_files(), which sends the
+ * notifications. Directories that can not be watched, e.g. when the inotify
+ * watches are exhausted, are polled every REALTIME_MONITOR_POLL_INTERVAL.
+ *-----------------------------------------------------------------------------
+ */
+
+#define REALTIME_MONITOR_DELAY 250
+#define REALTIME_MONITOR_POLL_INTERVAL 5000
+
+typedef struct _FileDataMonitorDir FileDataMonitorDir;
+struct _FileDataMonitorDir
+{
+	gchar *path;
+	GFileMonitor *monitor; /* NULL if polled */
+	gint refcount;
+};
+
+typedef struct _FileDataMonitor FileDataMonitor;
+struct _FileDataMonitor
+{
+	gint count;
+	FileDataMonitorDir *dir;
+};
+
+static GHashTable *file_data_monitor_pool = NULL; /* FileData -> FileDataMonitor */
+static GHashTable *file_data_monitor_dirs = NULL; /* path -> FileDataMonitorDir */
+static GHashTable *file_data_monitor_changed = NULL; /* FileData with pending events */
 static guint realtime_monitor_id = 0; /* event source id */
+static guint realtime_monitor_changed_id = 0; /* event source id */
+static gint realtime_monitor_polled = 0; /* count of directories without monitor */
 
 static void realtime_monitor_check_cb(gpointer key, gpointer value, gpointer data)
 {
 	FileData *fd = key;
+	FileDataMonitor *fdm = value;
+
+	if (fdm->dir->monitor) return;
 
 	file_data_check_changed_files(fd);
 
@@ -3253,59 +3771,235 @@ static gboolean realtime_monitor_cb(gpointer data)
 	return TRUE;
 }
 
+static gboolean realtime_monitor_changed_cb(gpointer data)
+{
+	GHashTable *changed = file_data_monitor_changed;
+	GList *list;
+	GList *work;
+
+	/* the notifications may queue new events */
+	file_data_monitor_changed = NULL;
+	realtime_monitor_changed_id = 0;
+
+	list = g_hash_table_get_keys(changed);
+	for (work = list; work; work = work->next)
+		{
+		FileData *fd = work->data;
+
+		DEBUG_1("monitor event %s", fd->path);
+		file_data_check_changed_files(fd);
+		}
+	g_list_free(list);
+
+	g_hash_table_destroy(changed);
+
+	return FALSE;
+}
+
+static void realtime_monitor_queue(const gchar *path)
+{
+	FileData *fd;
+
+	fd = g_hash_table_lookup(file_data_pool, path);
+	if (!fd) return;
+
+	if (!file_data_monitor_changed)
+		{
+		file_data_monitor_changed = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+								  (GDestroyNotify)file_data_unref, NULL);
+		}
+	if (g_hash_table_contains(file_data_monitor_changed, fd)) return;
+
+	g_hash_table_add(file_data_monitor_changed, file_data_ref(fd));
+
+	if (!realtime_monitor_changed_id)
+		{
+		realtime_monitor_changed_id = g_timeout_add(REALTIME_MONITOR_DELAY, realtime_monitor_changed_cb, NULL);
+		}
+}
+
+static void realtime_monitor_queue_file(GFile *file)
+{
+	gchar *path_l;
+	gchar *path;
+
+	if (!file) return;
+
+	path_l = g_file_get_path(file);
+	if (!path_l) return;
+
+	path = path_to_utf8(path_l);
+	realtime_monitor_queue(path);
+
+	g_free(path);
+	g_free(path_l);
+}
+
+static void realtime_monitor_event_cb(GFileMonitor *monitor, GFile *file, GFile *other_file,
+				      GFileMonitorEvent event_type, gpointer data)
+{
+	FileDataMonitorDir *fdmd = data;
+
+	if (!options->update_on_time_change) return;
+
+	switch (event_type)
+		{
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_MOVED:
+		case G_FILE_MONITOR_EVENT_RENAMED:
+		case G_FILE_MONITOR_EVENT_MOVED_IN:
+		case G_FILE_MONITOR_EVENT_MOVED_OUT:
+			/* the directory contents changed */
+			realtime_monitor_queue(fdmd->path);
+			realtime_monitor_queue_file(other_file);
+			/* fall through */
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+			realtime_monitor_queue_file(file);
+			break;
+		default:
+			/* G_FILE_MONITOR_EVENT_CHANGED is followed by the done hint */
+			break;
+		}
+}
+
+static FileDataMonitorDir *realtime_monitor_dir_ref(FileData *fd)
+{
+	FileDataMonitorDir *fdmd;
+	gchar *path;
+	gchar *path_l;
+	GFile *file;
+	GError *error = NULL;
+
+	if (S_ISDIR(fd->mode))
+		{
+		path = g_strdup(fd->path);
+		}
+	else
+		{
+		path = remove_level_from_path(fd->path);
+		}
+
+	if (!file_data_monitor_dirs)
+		{
+		file_data_monitor_dirs = g_hash_table_new(g_str_hash, g_str_equal);
+		}
+
+	fdmd = g_hash_table_lookup(file_data_monitor_dirs, path);
+	if (fdmd)
+		{
+		fdmd->refcount++;
+		g_free(path);
+		return fdmd;
+		}
+
+	fdmd = g_new0(FileDataMonitorDir, 1);
+	fdmd->path = path;
+	fdmd->refcount = 1;
+
+	path_l = path_from_utf8(path);
+	file = g_file_new_for_path(path_l);
+	fdmd->monitor = g_file_monitor_directory(file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+	g_object_unref(file);
+	g_free(path_l);
+
+	if (fdmd->monitor)
+		{
+		g_signal_connect(G_OBJECT(fdmd->monitor), "changed",
+				 G_CALLBACK(realtime_monitor_event_cb), fdmd);
+		}
+	else
+		{
+		/* e.g. out of inotify watches */
+		DEBUG_1("monitor %s failed, polling: %s", path, error->message);
+		g_error_free(error);
+
+		realtime_monitor_polled++;
+		if (!realtime_monitor_id)
+			{
+			realtime_monitor_id = g_timeout_add(REALTIME_MONITOR_POLL_INTERVAL, realtime_monitor_cb, NULL);
+			}
+		}
+
+	g_hash_table_insert(file_data_monitor_dirs, fdmd->path, fdmd);
+
+	return fdmd;
+}
+
+static void realtime_monitor_dir_unref(FileDataMonitorDir *fdmd)
+{
+	fdmd->refcount--;
+	if (fdmd->refcount > 0) return;
+
+	g_hash_table_remove(file_data_monitor_dirs, fdmd->path);
+
+	if (fdmd->monitor)
+		{
+		g_file_monitor_cancel(fdmd->monitor);
+		g_object_unref(fdmd->monitor);
+		}
+	else
+		{
+		realtime_monitor_polled--;
+		if (realtime_monitor_polled == 0 && realtime_monitor_id)
+			{
+			g_source_remove(realtime_monitor_id);
+			realtime_monitor_id = 0;
+			}
+		}
+
+	g_free(fdmd->path);
+	g_free(fdmd);
+}
+
 gboolean file_data_register_real_time_monitor(FileData *fd)
 {
-	gint count;
+	FileDataMonitor *fdm;
 
 	file_data_ref(fd);
 
 	if (!file_data_monitor_pool)
-		file_data_monitor_pool = g_hash_table_new(g_direct_hash, g_direct_equal);
-
-	count = GPOINTER_TO_INT(g_hash_table_lookup(file_data_monitor_pool, fd));
+		file_data_monitor_pool = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
 
-	DEBUG_1("Register realtime %d %s", count, fd->path);
+	fdm = g_hash_table_lookup(file_data_monitor_pool, fd);
 
-	count++;
-	g_hash_table_insert(file_data_monitor_pool, fd, GINT_TO_POINTER(count));
+	DEBUG_1("Register realtime %d %s", fdm ? fdm->count : 0, fd->path);
 
-	if (!realtime_monitor_id)
+	if (!fdm)
 		{
-		realtime_monitor_id = g_timeout_add(5000, realtime_monitor_cb, NULL);
+		fdm = g_new0(FileDataMonitor, 1);
+		fdm->dir = realtime_monitor_dir_ref(fd);
+		g_hash_table_insert(file_data_monitor_pool, fd, fdm);
 		}
+	fdm->count++;
 
 	return TRUE;
 }
 
 gboolean file_data_unregister_real_time_monitor(FileData *fd)
 {
-	gint count;
+	FileDataMonitor *fdm;
 
 	g_assert(file_data_monitor_pool);
 
-	count = GPOINTER_TO_INT(g_hash_table_lookup(file_data_monitor_pool, fd));
+	fdm = g_hash_table_lookup(file_data_monitor_pool, fd);
 
-	DEBUG_1("Unregister realtime %d %s", count, fd->path);
+	DEBUG_1("Unregister realtime %d %s", fdm ? fdm->count : 0, fd->path);
 
-	g_assert(count > 0);
+	g_assert(fdm && fdm->count > 0);
 
-	count--;
+	fdm->count--;
 
-	if (count == 0)
+	if (fdm->count == 0)
+		{
+		realtime_monitor_dir_unref(fdm->dir);
 		g_hash_table_remove(file_data_monitor_pool, fd);
-	else
-		g_hash_table_insert(file_data_monitor_pool, fd, GINT_TO_POINTER(count));
+		}
 
 	file_data_unref(fd);
 
-	if (g_hash_table_size(file_data_monitor_pool) == 0)
-		{
-		g_source_remove(realtime_monitor_id);
-		realtime_monitor_id = 0;
-		return FALSE;
-		}
-
-	return TRUE;
+	return (g_hash_table_size(file_data_monitor_pool) > 0);
 }
 
 /*
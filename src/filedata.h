@@ -77,6 +77,14 @@ GList *filelist_insert_sort_full(GList *list, gpointer data, SortType method, gb
 
 gboolean filelist_read(FileData *dir_fd, GList **files, GList **dirs);
 gboolean filelist_read_lstat(FileData *dir_fd, GList **files, GList **dirs);
+gboolean filelist_read_snapshot(FileData *dir_fd, time_t dir_mtime, GList **files);
+void filelist_apply_snapshot(FileData *dir_fd, time_t dir_mtime, GList *files);
+
+typedef void (*FileListReadFunc)(FileListReader *fr, gboolean success, GList *files, GList *dirs, gpointer data);
+FileListReader *filelist_read_async(FileData *dir_fd, gboolean files, gboolean dirs,
+				    FileListReadFunc func, gpointer data);
+void filelist_read_async_cancel(FileListReader *fr);
+
 void filelist_free(GList *list);
 GList *filelist_copy(GList *list);
 GList *filelist_from_path_list(GList *list);
@@ -167,6 +175,7 @@ void file_data_send_notification(FileData *fd, NotifyType type);
 gboolean file_data_register_real_time_monitor(FileData *fd);
 gboolean file_data_unregister_real_time_monitor(FileData *fd);
 
+time_t exif_time_data_parse(const gchar *text);
 void read_exif_time_data(FileData *file);
 void read_exif_time_digitized_data(FileData *file);
 
@@ -37,6 +37,7 @@
 
 #include "exif.h"
 #include "filedata.h"
+#include "misc.h"
 #include "ui_fileops.h"
 #include "gq-marshal.h"
 
@@ -66,6 +67,9 @@ static void image_loader_init(GTypeInstance *instance, gpointer g_class);
 static void image_loader_class_init(ImageLoaderClass *class);
 static void image_loader_finalize(GObject *object);
 static void image_loader_stop(ImageLoader *il);
+#ifdef HAVE_GTHREAD
+static gboolean image_loader_queue_remove(ImageLoader *il);
+#endif
 
 GType image_loader_get_type(void)
 {
@@ -115,6 +119,7 @@ static void image_loader_init(GTypeInstance *instance, gpointer g_class)
 	il->shrunk = FALSE;
 
 	il->can_destroy = TRUE;
+	il->queued = FALSE;
 
 #ifdef HAVE_GTHREAD
 #if GLIB_CHECK_VERSION(2,32,0)
@@ -991,6 +996,15 @@ static void image_loader_stop(ImageLoader *il)
 
 	if (il->thread)
 		{
+#ifdef HAVE_GTHREAD
+		if (image_loader_queue_remove(il))
+			{
+			/* not started yet, nothing to wait for */
+			g_mutex_lock(il->data_mutex);
+			il->can_destroy = TRUE;
+			g_mutex_unlock(il->data_mutex);
+			}
+#endif
 		/* stop loader in the other thread */
 		g_mutex_lock(il->data_mutex);
 		il->stopping = TRUE;
@@ -1077,56 +1091,71 @@ static gboolean image_loader_start_idle(ImageLoader *il)
 /* execution via thread */
 
 #ifdef HAVE_GTHREAD
-static GThreadPool *image_loader_thread_pool = NULL;
 
-static GCond *image_loader_prio_cond = NULL;
-static GMutex *image_loader_prio_mutex = NULL;
-static gint image_loader_prio_num = 0;
+/* The loaders waiting for a thread are kept in image_loader_queue, sorted
+ * by idle_priority (lower value first, FIFO for equal priority). The pool
+ * itself only receives one token per queued loader, each worker then takes
+ * the most urgent loader from the queue. This way the priority of a queued
+ * loader can still be changed and a loader that is stopped before it got a
+ * thread is simply removed from the queue.
+ */
+static GThreadPool *image_loader_thread_pool = NULL;
 
+static GMutex image_loader_queue_mutex;
+static GQueue image_loader_queue = G_QUEUE_INIT;
 
-static void image_loader_thread_enter_high(void)
+/* call with image_loader_queue_mutex locked */
+static void image_loader_queue_insert(ImageLoader *il)
 {
-	g_mutex_lock(image_loader_prio_mutex);
-	image_loader_prio_num++;
-	g_mutex_unlock(image_loader_prio_mutex);
-}
+	GList *work = image_loader_queue.tail;
 
-static void image_loader_thread_leave_high(void)
-{
-	g_mutex_lock(image_loader_prio_mutex);
-	image_loader_prio_num--;
-	if (image_loader_prio_num == 0) g_cond_broadcast(image_loader_prio_cond); /* wake up all low prio threads */
-	g_mutex_unlock(image_loader_prio_mutex);
+	while (work && ((ImageLoader *)work->data)->idle_priority > il->idle_priority) work = work->prev;
+
+	if (work)
+		g_queue_insert_after(&image_loader_queue, work, il);
+	else
+		g_queue_push_head(&image_loader_queue, il);
+
+	il->queued = TRUE;
 }
 
-static void image_loader_thread_wait_high(void)
+/* returns TRUE if the loader was still waiting for a thread */
+static gboolean image_loader_queue_remove(ImageLoader *il)
 {
-	g_mutex_lock(image_loader_prio_mutex);
-	while (image_loader_prio_num)
+	gboolean queued;
+
+	g_mutex_lock(&image_loader_queue_mutex);
+	queued = il->queued;
+	if (queued)
 		{
-		g_cond_wait(image_loader_prio_cond, image_loader_prio_mutex);
+		g_queue_remove(&image_loader_queue, il);
+		il->queued = FALSE;
 		}
+	g_mutex_unlock(&image_loader_queue_mutex);
 
-	g_mutex_unlock(image_loader_prio_mutex);
+	return queued;
 }
 
+static ImageLoader *image_loader_queue_pop(void)
+{
+	ImageLoader *il;
+
+	g_mutex_lock(&image_loader_queue_mutex);
+	il = g_queue_pop_head(&image_loader_queue);
+	if (il) il->queued = FALSE;
+	g_mutex_unlock(&image_loader_queue_mutex);
+
+	return il;
+}
 
 static void image_loader_thread_run(gpointer data, gpointer user_data)
 {
-	ImageLoader *il = data;
+	ImageLoader *il;
 	gboolean cont;
 	gboolean err;
 
-	if (il->idle_priority > G_PRIORITY_DEFAULT_IDLE)
-		{
-		/* low prio, wait untill high prio tasks finishes */
-		image_loader_thread_wait_high();
-		}
-	else
-		{
-		/* high prio */
-		image_loader_thread_enter_high();
-		}
+	il = image_loader_queue_pop();
+	if (!il) return; /* stopped before it was started */
 
 	err = !image_loader_begin(il);
 
@@ -1144,21 +1173,10 @@ static void image_loader_thread_run(gpointer data, gpointer user_data)
 
 	while (cont && !image_loader_get_is_done(il) && !image_loader_get_stopping(il))
 		{
-		if (il->idle_priority > G_PRIORITY_DEFAULT_IDLE)
-			{
-			/* low prio, wait untill high prio tasks finishes */
-			image_loader_thread_wait_high();
-			}
 		cont = image_loader_continue(il);
 		}
 	image_loader_stop_loader(il);
 
-	if (il->idle_priority <= G_PRIORITY_DEFAULT_IDLE)
-		{
-		/* high prio */
-		image_loader_thread_leave_high();
-		}
-
 	g_mutex_lock(il->data_mutex);
 	il->can_destroy = TRUE;
 	g_cond_signal(il->can_destroy_cond);
@@ -1177,24 +1195,23 @@ static gboolean image_loader_start_thread(ImageLoader *il)
 
 	if (!image_loader_setup_source(il)) return FALSE;
 
-        if (!image_loader_thread_pool)
+	if (!image_loader_thread_pool)
 		{
-		image_loader_thread_pool = g_thread_pool_new(image_loader_thread_run, NULL, -1, FALSE, NULL);
-#if GLIB_CHECK_VERSION(2,32,0)
-		if (!image_loader_prio_cond) image_loader_prio_cond = g_new(GCond, 1);
-		g_cond_init(image_loader_prio_cond);
-		if (!image_loader_prio_mutex) image_loader_prio_mutex = g_new(GMutex, 1);
-		g_mutex_init(image_loader_prio_mutex);
-#else
-		image_loader_prio_cond = g_cond_new();
-		image_loader_prio_mutex = g_mutex_new();
-#endif
+		image_loader_thread_pool = g_thread_pool_new(image_loader_thread_run, NULL, image_loader_get_thread_count(), FALSE, NULL);
+		}
+	else
+		{
+		g_thread_pool_set_max_threads(image_loader_thread_pool, image_loader_get_thread_count(), NULL);
 		}
 
 	il->can_destroy = FALSE; /* ImageLoader can't be freed until image_loader_thread_run finishes */
 
-	g_thread_pool_push(image_loader_thread_pool, il, NULL);
-	DEBUG_1("Thread pool num threads: %d", g_thread_pool_get_num_threads(image_loader_thread_pool));
+	g_mutex_lock(&image_loader_queue_mutex);
+	image_loader_queue_insert(il);
+	g_mutex_unlock(&image_loader_queue_mutex);
+
+	g_thread_pool_push(image_loader_thread_pool, GINT_TO_POINTER(1), NULL);
+	DEBUG_1("Thread pool num threads: %d queued: %u", g_thread_pool_get_num_threads(image_loader_thread_pool), image_loader_get_queue_length());
 
 	return TRUE;
 }
@@ -1254,10 +1271,67 @@ void image_loader_set_priority(ImageLoader *il, gint priority)
 {
 	if (!il) return;
 
-	if (il->thread) return; /* can't change prio if the thread already runs */
+#ifdef HAVE_GTHREAD
+	if (il->thread)
+		{
+		/* a queued loader is moved to its new place in the queue,
+		 * a running one only changes the priority of its signals
+		 */
+		g_mutex_lock(&image_loader_queue_mutex);
+		if (il->queued)
+			{
+			g_queue_remove(&image_loader_queue, il);
+			il->idle_priority = priority;
+			image_loader_queue_insert(il);
+			}
+		else
+			{
+			il->idle_priority = priority;
+			}
+		g_mutex_unlock(&image_loader_queue_mutex);
+		return;
+		}
+#endif
+
+	if (il->idle_id) return; /* can't change prio if the idle loader already runs */
 	il->idle_priority = priority;
 }
 
+gint image_loader_get_priority(ImageLoader *il)
+{
+	if (!il) return G_PRIORITY_DEFAULT_IDLE;
+
+	return il->idle_priority;
+}
+
+/* number of images that are decoded at the same time */
+gint image_loader_get_thread_count(void)
+{
+#ifdef HAVE_GTHREAD
+	return (options->threads.image_loader > 0) ? options->threads.image_loader : get_cpu_cores();
+#else
+	return 1;
+#endif
+}
+
+/* number of loaders waiting for a free thread,
+ * views can use it to throttle how much work they submit
+ */
+guint image_loader_get_queue_length(void)
+{
+#ifdef HAVE_GTHREAD
+	guint ret;
+
+	g_mutex_lock(&image_loader_queue_mutex);
+	ret = image_loader_queue.length;
+	g_mutex_unlock(&image_loader_queue_mutex);
+
+	return ret;
+#else
+	return 0;
+#endif
+}
+
 
 gdouble image_loader_get_percent(ImageLoader *il)
 {
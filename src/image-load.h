@@ -103,6 +103,7 @@ struct _ImageLoader
 	gboolean can_destroy;
 	GCond *can_destroy_cond;
 	gboolean thread;
+	gboolean queued; /* waiting in the thread pool queue */
 
 	guchar *mapped_file;
 	gsize read_buffer_size;
@@ -136,10 +137,15 @@ void image_loader_set_requested_size(ImageLoader *il, gint width, gint height);
 
 void image_loader_set_buffer_size(ImageLoader *il, guint size);
 
-/* this only has effect if used before image_loader_start()
- * default is G_PRIORITY_DEFAULT_IDLE
+/* lower values are loaded first, default is G_PRIORITY_DEFAULT_IDLE
+ * a threaded loader can be changed until it gets a thread,
+ * an idle loader only before image_loader_start()
  */
 void image_loader_set_priority(ImageLoader *il, gint priority);
+gint image_loader_get_priority(ImageLoader *il);
+
+gint image_loader_get_thread_count(void);
+guint image_loader_get_queue_length(void);
 
 gboolean image_loader_start(ImageLoader *il);
 
@@ -34,6 +34,7 @@
 #include "image-overlay.h"
 #include "layout.h"
 #include "layout_image.h"
+#include "pixbuf-mipmap.h"
 #include "pixbuf-renderer.h"
 #include "pixbuf_util.h"
 #include "ui_fileops.h"
@@ -43,6 +44,10 @@
 
 #include <math.h>
 
+/* loader priorities, the displayed image uses G_PRIORITY_DEFAULT_IDLE */
+#define IMAGE_READ_AHEAD_PRIORITY (G_PRIORITY_DEFAULT_IDLE + 10)
+#define IMAGE_READ_AHEAD_WINDOW_PRIORITY (G_PRIORITY_DEFAULT_IDLE + 20)
+
 static GList *image_list = NULL;
 
 static void image_update_title(ImageWindow *imd);
@@ -737,12 +742,10 @@ static void image_read_ahead_start(ImageWindow *imd)
 	/* already started ? */
 	if (!imd->read_ahead_fd || imd->read_ahead_il || imd->read_ahead_fd->pixbuf) return;
 
-	/* still loading ?, do later */
-	if (imd->il /*|| imd->cm*/) return;
-
 	DEBUG_1("%s read ahead started for :%s", get_exec_time(), imd->read_ahead_fd->path);
 
 	imd->read_ahead_il = image_loader_new(imd->read_ahead_fd);
+	image_loader_set_priority(imd->read_ahead_il, IMAGE_READ_AHEAD_PRIORITY);
 
 	image_loader_delay_area_ready(imd->read_ahead_il, TRUE); /* we will need the area_ready signals later */
 
@@ -769,6 +772,147 @@ static void image_read_ahead_set(ImageWindow *imd, FileData *fd)
 	image_read_ahead_start(imd);
 }
 
+/*
+ *-------------------------------------------------------------------
+ * read ahead window
+ *-------------------------------------------------------------------
+ */
+
+/* besides the primary read ahead above, a window of further images
+ * around the current one is decoded in parallel straight into the
+ * image cache; the primary read ahead is the next image in the browsing
+ * direction, the window holds the ones after it and those behind
+ */
+
+typedef struct _ImageReadAhead ImageReadAhead;
+struct _ImageReadAhead
+{
+	ImageWindow *imd;
+	FileData *fd;
+	ImageLoader *il;
+};
+
+static void image_read_ahead_window_free_item(ImageReadAhead *ra)
+{
+	image_loader_free(ra->il);
+	file_data_unref(ra->fd);
+	g_free(ra);
+}
+
+static void image_read_ahead_window_cancel(ImageWindow *imd)
+{
+	GList *work;
+
+	work = imd->read_ahead_window;
+	while (work)
+		{
+		ImageReadAhead *ra = work->data;
+		work = work->next;
+
+		DEBUG_1("%s read ahead window cancelled for :%s", get_exec_time(), ra->fd->path);
+		image_read_ahead_window_free_item(ra);
+		}
+
+	g_list_free(imd->read_ahead_window);
+	imd->read_ahead_window = NULL;
+}
+
+static ImageReadAhead *image_read_ahead_window_find(ImageWindow *imd, FileData *fd)
+{
+	GList *work;
+
+	work = imd->read_ahead_window;
+	while (work)
+		{
+		ImageReadAhead *ra = work->data;
+		if (ra->fd == fd) return ra;
+		work = work->next;
+		}
+
+	return NULL;
+}
+
+static void image_read_ahead_window_done_cb(ImageLoader *il, gpointer data)
+{
+	ImageReadAhead *ra = data;
+	ImageWindow *imd = ra->imd;
+
+	DEBUG_1("%s read ahead window done for :%s", get_exec_time(), ra->fd->path);
+
+	if (!ra->fd->pixbuf)
+		{
+		GdkPixbuf *pixbuf = image_loader_get_pixbuf(il);
+		if (pixbuf)
+			{
+			ra->fd->pixbuf = g_object_ref(pixbuf);
+			image_cache_set(imd, ra->fd);
+			}
+		}
+
+	imd->read_ahead_window = g_list_remove(imd->read_ahead_window, ra);
+	image_read_ahead_window_free_item(ra);
+}
+
+static ImageReadAhead *image_read_ahead_window_start(ImageWindow *imd, FileData *fd)
+{
+	ImageReadAhead *ra;
+
+	DEBUG_1("%s read ahead window started for :%s", get_exec_time(), fd->path);
+
+	ra = g_new0(ImageReadAhead, 1);
+	ra->imd = imd;
+	ra->fd = file_data_ref(fd);
+	ra->il = image_loader_new(fd);
+	image_loader_set_priority(ra->il, IMAGE_READ_AHEAD_WINDOW_PRIORITY);
+
+	image_loader_delay_area_ready(ra->il, TRUE); /* in case it is promoted to the displayed image */
+
+	/* errors are treated as success, as for the primary read ahead */
+	g_signal_connect(G_OBJECT(ra->il), "error", (GCallback)image_read_ahead_window_done_cb, ra);
+	g_signal_connect(G_OBJECT(ra->il), "done", (GCallback)image_read_ahead_window_done_cb, ra);
+
+	if (!image_loader_start(ra->il))
+		{
+		image_read_ahead_window_free_item(ra);
+		return NULL;
+		}
+
+	return ra;
+}
+
+/* if fd is still being decoded in the window, make it the primary read ahead
+ * so that image_read_ahead_check() can take over the running loader
+ */
+static void image_read_ahead_window_promote(ImageWindow *imd, FileData *fd)
+{
+	ImageReadAhead *ra;
+
+	ra = image_read_ahead_window_find(imd, fd);
+	if (!ra) return;
+
+	DEBUG_1("%s read ahead window promoted :%s", get_exec_time(), fd->path);
+
+	image_read_ahead_cancel(imd);
+
+	g_signal_handlers_disconnect_by_func(G_OBJECT(ra->il), (GCallback)image_read_ahead_window_done_cb, ra);
+	g_signal_connect(G_OBJECT(ra->il), "error", (GCallback)image_read_ahead_error_cb, imd);
+	g_signal_connect(G_OBJECT(ra->il), "done", (GCallback)image_read_ahead_done_cb, imd);
+
+	imd->read_ahead_fd = ra->fd;
+	imd->read_ahead_il = ra->il;
+	image_loader_set_priority(imd->read_ahead_il, IMAGE_READ_AHEAD_PRIORITY);
+
+	imd->read_ahead_window = g_list_remove(imd->read_ahead_window, ra);
+	g_free(ra);
+}
+
+static gulong image_pixbuf_cache_size(GdkPixbuf *pixbuf)
+{
+	if (!pixbuf) return 0;
+	/* the mipmaps are built when the image is zoomed out, count them in advance */
+	return (gulong)gdk_pixbuf_get_rowstride(pixbuf) * (gulong)gdk_pixbuf_get_height(pixbuf) + pixbuf_mipmap_size(pixbuf);
+}
+
 /*
  *-------------------------------------------------------------------
  * post buffering
@@ -793,7 +937,7 @@ static void image_cache_set(ImageWindow *imd, FileData *fd)
 {
 	g_assert(fd->pixbuf);
 
-	file_cache_put(image_get_cache(), fd, (gulong)gdk_pixbuf_get_rowstride(fd->pixbuf) * (gulong)gdk_pixbuf_get_height(fd->pixbuf));
+	file_cache_put(image_get_cache(), fd, image_pixbuf_cache_size(fd->pixbuf));
 	file_data_send_notification(fd, NOTIFY_PIXBUF); /* to update histogram */
 }
 
@@ -939,8 +1083,12 @@ static void image_load_set_signals(ImageWindow *imd, gboolean override_old_signa
 
 static gboolean image_read_ahead_check(ImageWindow *imd)
 {
-	if (!imd->read_ahead_fd) return FALSE;
 	if (imd->il) return FALSE;
+	if (imd->image_fd && imd->read_ahead_fd != imd->image_fd)
+		{
+		image_read_ahead_window_promote(imd, imd->image_fd);
+		}
+	if (!imd->read_ahead_fd) return FALSE;
 
 	if (!imd->image_fd || imd->read_ahead_fd != imd->image_fd)
 		{
@@ -953,6 +1101,9 @@ static gboolean image_read_ahead_check(ImageWindow *imd)
 		imd->il = imd->read_ahead_il;
 		imd->read_ahead_il = NULL;
 
+		/* needed now, move it ahead of the other queued loads */
+		image_loader_set_priority(imd->il, G_PRIORITY_DEFAULT_IDLE);
+
 		image_load_set_signals(imd, TRUE);
 
 		g_object_set(G_OBJECT(imd->pr), "loading", TRUE, NULL);
@@ -1481,6 +1632,8 @@ void image_move_from_image(ImageWindow *imd, ImageWindow *source)
 	file_data_unref(imd->read_ahead_fd);
 	source->read_ahead_fd = NULL;
 
+	image_read_ahead_window_cancel(source);
+
 	imd->orientation = source->orientation;
 	imd->desaturate = source->desaturate;
 
@@ -1539,6 +1692,8 @@ void image_copy_from_image(ImageWindow *imd, ImageWindow *source)
 	imd->read_ahead_fd = source->read_ahead_fd;
 	source->read_ahead_fd = NULL;
 
+	image_read_ahead_window_cancel(source);
+
 	imd->completed = source->completed;
 	imd->state = source->state;
 	source->state = IMAGE_STATE_NONE;
@@ -1759,6 +1914,88 @@ void image_prebuffer_set(ImageWindow *imd, FileData *fd)
 		}
 }
 
+/* decode the images in list into the image cache in parallel,
+ * loads for images that dropped out of the list are cancelled;
+ * the list is in order of preference and is cut short when the
+ * images would no longer fit in the image cache
+ */
+void image_prebuffer_window_set(ImageWindow *imd, GList *list)
+{
+	GList *old_window;
+	GList *window = NULL;
+	GList *work;
+	gulong budget;
+	gulong estimate;
+	gulong used;
+
+	budget = file_cache_get_max_size(image_get_cache());
+
+	if (pixbuf_renderer_get_tiles((PixbufRenderer *)imd->pr) || !list || budget == 0)
+		{
+		image_read_ahead_window_cancel(imd);
+		return;
+		}
+
+	/* the size of the images is not known before decoding,
+	 * assume they are about as large as the current one
+	 */
+	estimate = image_pixbuf_cache_size(image_get_pixbuf(imd));
+	used = estimate;
+	if (imd->read_ahead_fd) used += estimate;
+
+	old_window = imd->read_ahead_window;
+	imd->read_ahead_window = NULL;
+
+	work = list;
+	while (work)
+		{
+		FileData *fd = work->data;
+		ImageReadAhead *ra;
+		GList *link;
+
+		work = work->next;
+
+		if (!fd || fd == imd->image_fd || fd == imd->read_ahead_fd) continue;
+
+		if (fd->pixbuf && file_cache_get(image_get_cache(), fd))
+			{
+			used += image_pixbuf_cache_size(fd->pixbuf);
+			continue;
+			}
+
+		if (used + estimate > budget) break;
+		used += estimate;
+
+		ra = NULL;
+		for (link = old_window; link; link = link->next)
+			{
+			if (((ImageReadAhead *)link->data)->fd == fd)
+				{
+				ra = link->data;
+				old_window = g_list_delete_link(old_window, link);
+				break;
+				}
+			}
+
+		if (!ra) ra = image_read_ahead_window_start(imd, fd);
+		if (ra) window = g_list_prepend(window, ra);
+		}
+
+	imd->read_ahead_window = g_list_reverse(window);
+
+	/* jumped elsewhere - drop the loads that are no longer needed */
+	work = old_window;
+	while (work)
+		{
+		ImageReadAhead *ra = work->data;
+		work = work->next;
+
+		DEBUG_1("%s read ahead window cancelled for :%s", get_exec_time(), ra->fd->path);
+		image_read_ahead_window_free_item(ra);
+		}
+	g_list_free(old_window);
+}
+
 static void image_notify_cb(FileData *fd, NotifyType type, gpointer data)
 {
 	ImageWindow *imd = data;
@@ -1976,6 +2213,7 @@ static void image_options_set(ImageWindow *imd)
 {
 	g_object_set(G_OBJECT(imd->pr), "zoom_quality", options->image.zoom_quality,
 					"zoom_2pass", options->image.zoom_2pass,
+					"tile_prefetch", options->image.tile_prefetch,
 					"zoom_expand", options->image.zoom_to_fit_allow_expand,
 					"scroll_reset", options->image.scroll_reset_method,
 					"cache_display", options->image.tile_cache_max,
@@ -2031,6 +2269,7 @@ static void image_free(ImageWindow *imd)
 	image_reset(imd);
 
 	image_read_ahead_cancel(imd);
+	image_read_ahead_window_cancel(imd);
 
 	file_data_unref(imd->image_fd);
 	g_free(imd->title);
@@ -112,6 +112,7 @@ void image_stereo_pixbuf_set(ImageWindow *imd, StereoPixbufData stereo_mode);
 
 /* read ahead, pass NULL to cancel */
 void image_prebuffer_set(ImageWindow *imd, FileData *fd);
+void image_prebuffer_window_set(ImageWindow *imd, GList *list);
 
 /* auto refresh */
 void image_auto_refresh_enable(ImageWindow *imd, gboolean enable);
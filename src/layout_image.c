@@ -1484,6 +1484,31 @@ void layout_image_set_index(LayoutWindow *lw, gint index)
 		}
 
 	layout_image_set_with_ahead(lw, fd, read_ahead_fd);
+
+	if (options->image.enable_read_ahead)
+		{
+		GList *window = NULL;
+
+		/* no window when stepping through a selection */
+		if (layout_selection_count(lw, 0) <= 1)
+			{
+			gint step = (old > index) ? -1 : 1;
+			gint i;
+
+			for (i = 1; i <= options->image.read_ahead_count; i++)
+				{
+				window = g_list_prepend(window, layout_list_get_fd(lw, index + i * step));
+				}
+			for (i = 1; i <= options->image.read_behind_count; i++)
+				{
+				window = g_list_prepend(window, layout_list_get_fd(lw, index - i * step));
+				}
+			window = g_list_reverse(window);
+			}
+
+		image_prebuffer_window_set(lw->image, window);
+		g_list_free(window);
+		}
 }
 
 static void layout_image_set_collection_real(LayoutWindow *lw, CollectionData *cd, CollectInfo *info, gboolean forward)
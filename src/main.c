@@ -33,6 +33,8 @@
 #include "main.h"
 
 #include "cache.h"
+#include "cache-build.h"
+#include "cache-db.h"
 #include "collect.h"
 #include "collect-io.h"
 #include "filedata.h"
@@ -50,6 +52,7 @@
 #include "ui_utildlg.h"
 #include "cache_maint.h"
 #include "thumb.h"
+#include "thumb_standard.h"
 #include "metadata.h"
 #include "editors.h"
 #include "exif.h"
@@ -375,6 +378,7 @@ static void parse_command_line(gint argc, gchar *argv[])
 				print_term(FALSE, _("      --geometry=XxY+XOFF+YOFF     set main window location\n"));
 				print_term(FALSE, _("  -r, --remote                     send following commands to open window\n"));
 				print_term(FALSE, _("  -rh,--remote-help                print remote command list\n"));
+				print_term(FALSE, _("      --cache-build <folder>       build caches without a display, must be first\n"));
 #ifdef DEBUG
 				print_term(FALSE, _("      --debug[=level]              turn on debug output\n"));
 				print_term(FALSE, _("  -g:<regexp>, --grep:<regexp>     filter debug output\n"));
@@ -708,6 +712,8 @@ static void exit_program_final(void)
 	remote_close(remote_connection);
 
 	collect_manager_flush();
+	cache_sim_db_flush();
+	thumb_std_save_flush();
 
 	save_options(options);
 	keys_save();
@@ -871,9 +877,16 @@ gint main(gint argc, gchar *argv[])
 	file_data_register_notify_func(metadata_notify_cb, NULL, NOTIFY_PRIORITY_LOW);
 
 
+	parse_command_line_for_debug_option(argc, argv);
+
+	/* batch cache building, must not need a display */
+	if (argc > 1 && strcmp(argv[1], CACHE_BUILD_OPTION) == 0)
+		{
+		exit(cache_build_main(argc, argv));
+		}
+
 	gtkrc_load();
 
-	parse_command_line_for_debug_option(argc, argv);
 	DEBUG_1("%s main: gtk_init", get_exec_time());
 #ifdef HAVE_CLUTTER
 	if (gtk_clutter_init(&argc, &argv) != CLUTTER_INIT_SUCCESS)
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "metadata-prefetch.h"
+
+#include "cache.h"
+#include "exif.h"
+#include "filedata.h"
+#include "metadata.h"
+#include "misc.h"
+#include "ui_fileops.h"
+
+
+/*
+ *-------------------------------------------------------------------
+ * The exif dates and the rating used for sorting are read by a pool of
+ * worker threads. The workers only get the paths of the files, the FileData
+ * are updated on the main thread when the results are collected, in batches.
+ * The files are queued in steps to keep the memory use low, the queued ones
+ * are skipped when the prefetch is stopped.
+ *-------------------------------------------------------------------
+ */
+
+#define METADATA_PREFETCH_DELAY 50	/* ms between batches */
+#define METADATA_PREFETCH_QUEUED 256	/* files queued per worker, enough for the workers to not wait on a batch */
+#define METADATA_PREFETCH_SYNC 4	/* files read per batch on the main thread, without threads */
+
+typedef struct _MetadataPrefetchJob MetadataPrefetchJob;
+struct _MetadataPrefetchJob
+{
+	MetadataPrefetch *mp;
+	FileData *fd;			/* main thread only */
+
+	gchar *path;
+	gchar *sidecar_path;
+	gboolean need_date;
+	gboolean need_date_digitized;
+	gboolean need_rating;
+
+	/* read by the worker */
+	gchar *date;
+	gchar *date_digitized;
+	gchar *rating;
+};
+
+struct _MetadataPrefetch
+{
+	GList *list;			/* FileData, referenced */
+	GList *cursor;			/* next FileData to queue */
+	guint total;
+	guint done;
+	guint queued;			/* given to the workers, not collected yet */
+	gint stopped;			/* atomic */
+
+	GMutex mutex;
+	GList *results;			/* MetadataPrefetchJob done by the workers, protected by mutex */
+
+	guint batch_id;			/* event source id */
+
+	MetadataPrefetchFunc func;
+	gpointer data;
+};
+
+#ifdef HAVE_GTHREAD
+static GThreadPool *metadata_prefetch_pool = NULL;
+#endif
+
+
+#ifdef HAVE_GTHREAD
+static gint metadata_prefetch_threads(void)
+{
+	return MAX(get_cpu_cores(), 1);
+}
+#endif
+
+static void metadata_prefetch_job_free(MetadataPrefetchJob *job)
+{
+	file_data_unref(job->fd);
+	g_free(job->path);
+	g_free(job->sidecar_path);
+	g_free(job->date);
+	g_free(job->date_digitized);
+	g_free(job->rating);
+	g_free(job);
+}
+
+/* runs in a worker, only the needed tags are kept */
+static void metadata_prefetch_job_read(MetadataPrefetchJob *job)
+{
+	ExifData *exif;
+	ExifFast ef;
+
+	if (!job->sidecar_path && exif_fast_read(job->path, &ef))
+		{
+		if (job->need_date && ef.date_time_original[0]) job->date = g_strdup(ef.date_time_original);
+		if (job->need_date_digitized && ef.date_time_digitized[0]) job->date_digitized = g_strdup(ef.date_time_digitized);
+		if (job->need_rating && ef.rating != STAR_RATING_NOT_READ) job->rating = g_strdup_printf("%d", ef.rating);
+		return;
+		}
+
+	exif = exif_read(job->path, job->sidecar_path, NULL);
+	if (!exif) return;
+
+	if (job->need_date) job->date = exif_get_data_as_text(exif, "Exif.Photo.DateTimeOriginal");
+	if (job->need_date_digitized) job->date_digitized = exif_get_data_as_text(exif, "Exif.Photo.DateTimeDigitized");
+	if (job->need_rating)
+		{
+		GList *list = exif_get_metadata(exif, RATING_KEY, METADATA_PLAIN);
+
+		if (list)
+			{
+			job->rating = list->data;
+			list->data = NULL;
+			}
+		string_list_free(list);
+		}
+
+	exif_free(exif);
+}
+
+static void metadata_prefetch_thread_run(gpointer data, gpointer user_data)
+{
+	MetadataPrefetchJob *job = data;
+	MetadataPrefetch *mp = job->mp;
+
+	if (!g_atomic_int_get(&mp->stopped)) metadata_prefetch_job_read(job);
+
+	g_mutex_lock(&mp->mutex);
+	mp->results = g_list_prepend(mp->results, job);
+	g_mutex_unlock(&mp->mutex);
+}
+
+static void metadata_prefetch_job_apply(MetadataPrefetchJob *job)
+{
+	FileData *fd = job->fd;
+
+	if (job->date && !fd->exifdate) fd->exifdate = exif_time_data_parse(job->date);
+	if (job->date_digitized && !fd->exifdate_digitized) fd->exifdate_digitized = exif_time_data_parse(job->date_digitized);
+
+	if (fd->rating == STAR_RATING_NOT_READ)
+		{
+		if (fd->modified_xmp && g_hash_table_lookup(fd->modified_xmp, RATING_KEY))
+			{
+			/* unwritten changes override the file */
+			read_rating_data(fd);
+			}
+		else if (job->rating)
+			{
+			fd->rating = atoi(job->rating);
+			}
+		}
+
+	fd->metadata_in_idle_loaded = TRUE;
+}
+
+static void metadata_prefetch_queue(MetadataPrefetch *mp)
+{
+#ifdef HAVE_GTHREAD
+	guint max = metadata_prefetch_threads() * METADATA_PREFETCH_QUEUED;
+#else
+	guint max = METADATA_PREFETCH_SYNC;
+#endif
+
+	while (mp->cursor && mp->queued < max)
+		{
+		FileData *fd = mp->cursor->data;
+		MetadataPrefetchJob *job;
+
+		mp->cursor = mp->cursor->next;
+
+		if (fd->metadata_in_idle_loaded)
+			{
+			mp->done++;
+			continue;
+			}
+
+		if (fd->exif)
+			{
+			/* the exif data are in the cache already */
+			if (!fd->exifdate) read_exif_time_data(fd);
+			if (!fd->exifdate_digitized) read_exif_time_digitized_data(fd);
+			if (fd->rating == STAR_RATING_NOT_READ) read_rating_data(fd);
+			fd->metadata_in_idle_loaded = TRUE;
+			mp->done++;
+			continue;
+			}
+
+		job = g_new0(MetadataPrefetchJob, 1);
+		job->mp = mp;
+		job->fd = file_data_ref(fd);
+		job->path = g_strdup(fd->path);
+#ifdef HAVE_EXIV2
+		/* as in exif_read_fd() */
+		job->sidecar_path = cache_find_location(CACHE_TYPE_XMP_METADATA, fd->path);
+		if (!job->sidecar_path) job->sidecar_path = file_data_get_sidecar_path(fd, TRUE);
+#endif
+		job->need_date = !fd->exifdate;
+		job->need_date_digitized = !fd->exifdate_digitized;
+		job->need_rating = (fd->rating == STAR_RATING_NOT_READ);
+
+		mp->queued++;
+#ifdef HAVE_GTHREAD
+		g_thread_pool_push(metadata_prefetch_pool, job, NULL);
+#else
+		metadata_prefetch_thread_run(job, NULL);
+#endif
+		}
+}
+
+static void metadata_prefetch_free(MetadataPrefetch *mp)
+{
+	if (mp->batch_id) g_source_remove(mp->batch_id);
+	filelist_free(mp->list);
+	g_mutex_clear(&mp->mutex);
+	g_free(mp);
+}
+
+static gboolean metadata_prefetch_batch_cb(gpointer data)
+{
+	MetadataPrefetch *mp = data;
+	GList *results;
+	GList *work;
+
+	g_mutex_lock(&mp->mutex);
+	results = mp->results;
+	mp->results = NULL;
+	g_mutex_unlock(&mp->mutex);
+
+	for (work = results; work; work = work->next)
+		{
+		MetadataPrefetchJob *job = work->data;
+
+		if (!g_atomic_int_get(&mp->stopped))
+			{
+			metadata_prefetch_job_apply(job);
+			mp->done++;
+			}
+		mp->queued--;
+		metadata_prefetch_job_free(job);
+		}
+	g_list_free(results);
+
+	if (g_atomic_int_get(&mp->stopped))
+		{
+		/* the jobs still queued refer to mp */
+		if (mp->queued > 0) return TRUE;
+
+		mp->batch_id = 0;
+		metadata_prefetch_free(mp);
+		return FALSE;
+		}
+
+	metadata_prefetch_queue(mp);
+
+	if (mp->queued > 0)
+		{
+		if (results) mp->func(mp, FALSE, mp->data);
+		return TRUE;
+		}
+
+	mp->batch_id = 0;
+	mp->func(mp, TRUE, mp->data);
+	metadata_prefetch_free(mp);
+	return FALSE;
+}
+
+MetadataPrefetch *metadata_prefetch_start(GList *list, MetadataPrefetchFunc func, gpointer data)
+{
+	MetadataPrefetch *mp;
+	GList *work;
+
+	mp = g_new0(MetadataPrefetch, 1);
+	mp->func = func;
+	mp->data = data;
+	g_mutex_init(&mp->mutex);
+
+	for (work = list; work; work = work->next)
+		{
+		FileData *fd = work->data;
+
+		if (!fd->metadata_in_idle_loaded) mp->list = g_list_prepend(mp->list, file_data_ref(fd));
+		}
+	mp->list = g_list_reverse(mp->list);
+	mp->cursor = mp->list;
+	mp->total = g_list_length(mp->list);
+
+	DEBUG_1("%s metadata prefetch: %d files", get_exec_time(), mp->total);
+
+#ifdef HAVE_GTHREAD
+	if (!metadata_prefetch_pool)
+		{
+		metadata_prefetch_pool = g_thread_pool_new(metadata_prefetch_thread_run, NULL,
+							   metadata_prefetch_threads(), FALSE, NULL);
+		}
+#endif
+
+	metadata_prefetch_queue(mp);
+	mp->batch_id = g_timeout_add(METADATA_PREFETCH_DELAY, metadata_prefetch_batch_cb, mp);
+
+	return mp;
+}
+
+void metadata_prefetch_stop(MetadataPrefetch *mp)
+{
+	if (!mp) return;
+
+	/* freed by metadata_prefetch_batch_cb() once the workers are done with it */
+	g_atomic_int_set(&mp->stopped, TRUE);
+}
+
+gdouble metadata_prefetch_get_progress(MetadataPrefetch *mp)
+{
+	if (!mp || mp->total == 0) return 1.0;
+
+	return (gdouble)mp->done / mp->total;
+}
+
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
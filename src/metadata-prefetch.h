@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef METADATA_PREFETCH_H
+#define METADATA_PREFETCH_H
+
+
+/* called after each batch of files is updated, and once with done set when all are,
+ * mp is freed after that call
+ */
+typedef void (*MetadataPrefetchFunc)(MetadataPrefetch *mp, gboolean done, gpointer data);
+
+/* reads the exif dates and the rating of the FileData in list which do not have
+ * metadata_in_idle_loaded set, in the background
+ */
+MetadataPrefetch *metadata_prefetch_start(GList *list, MetadataPrefetchFunc func, gpointer data);
+
+/* mp is valid until func is called with done set */
+void metadata_prefetch_stop(MetadataPrefetch *mp);
+
+gdouble metadata_prefetch_get_progress(MetadataPrefetch *mp);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -663,6 +663,30 @@ static GList *remove_duplicate_strings_from_list(GList *list)
 	return g_list_reverse(newlist);
 }
 
+/* the keys needed for the file lists are read without the full exif data when possible,
+ * returns FALSE if exif_read_fd() is needed
+ */
+static gboolean metadata_read_fast(FileData *fd, const gchar *key, GList **list)
+{
+	ExifFast ef;
+	gchar *value = NULL;
+
+	if (strcmp(key, RATING_KEY) != 0 && strcmp(key, ORIENTATION_KEY) != 0) return FALSE;
+	if (!exif_fast_read_fd(fd, &ef)) return FALSE;
+
+	if (strcmp(key, RATING_KEY) == 0)
+		{
+		if (ef.rating != STAR_RATING_NOT_READ) value = g_strdup_printf("%d", ef.rating);
+		}
+	else if (ef.orientation)
+		{
+		value = g_strdup_printf("%d", ef.orientation);
+		}
+
+	*list = value ? g_list_append(NULL, value) : NULL;
+	return TRUE;
+}
+
 GList *metadata_read_list(FileData *fd, const gchar *key, MetadataFormat format)
 {
 	ExifData *exif;
@@ -718,10 +742,15 @@ GList *metadata_read_list(FileData *fd, const gchar *key, MetadataFormat format)
 		}
 #endif
 
-	exif = exif_read_fd(fd); /* this is cached, thus inexpensive */
-	if (!exif) return NULL;
-	list = exif_get_metadata(exif, key, format);
-	exif_free_fd(fd, exif);
+	/* the decoded tags of files read before are kept in a compact form */
+	if (format != METADATA_PLAIN ||
+	    (!exif_compact_get_metadata(fd, key, &list) && !metadata_read_fast(fd, key, &list)))
+		{
+		exif = exif_read_fd(fd); /* this is cached, thus inexpensive */
+		if (!exif) return NULL;
+		list = exif_get_metadata(exif, key, format);
+		exif_free_fd(fd, exif);
+		}
 
 	if (format == METADATA_PLAIN && strcmp(key, KEYWORD_KEY) == 0)
 		{
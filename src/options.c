@@ -99,6 +99,8 @@ ConfOptions *init_options(ConfOptions *options)
 	options->image.alpha_color_2.green = 0x006666;
 	options->image.alpha_color_2.blue = 0x006666;
 	options->image.enable_read_ahead = TRUE;
+	options->image.read_ahead_count = 2;
+	options->image.read_behind_count = 1;
 	options->image.exif_rotate_enable = TRUE;
 	options->image.exif_proof_rotate_enable = TRUE;
 	options->image.fit_window_to_image = FALSE;
@@ -110,9 +112,12 @@ ConfOptions *init_options(ConfOptions *options)
 	options->image.scroll_reset_method = SCROLL_RESET_NOCHANGE;
 	options->image.tile_cache_max = 10;
 	options->image.image_cache_max = 128; /* 4 x 10MPix */
+	options->image.exif_cache_max = 16;
 	options->image.use_custom_border_color = FALSE;
 	options->image.use_custom_border_color_in_fullscreen = TRUE;
 	options->image.zoom_2pass = TRUE;
+	options->image.zoom_mipmaps = TRUE;
+	options->image.tile_prefetch = 2;
 	options->image.zoom_increment = 5;
 	options->image.zoom_mode = ZOOM_RESET_NONE;
 	options->image.zoom_quality = GDK_INTERP_BILINEAR;
@@ -176,10 +181,12 @@ ConfOptions *init_options(ConfOptions *options)
 	options->thumbnails.use_ft_metadata = TRUE;
 // 	options->thumbnails.use_ft_metadata_small = TRUE;
 	options->thumbnails.collection_preview = 20;
+	options->thumbnails.png_compression = 6;
 
 	options->tree_descend_subdirs = FALSE;
 	options->view_dir_list_single_click_enter = TRUE;
 	options->update_on_time_change = TRUE;
+	options->cache_dir_lists = TRUE;
 	options->clipboard_selection = PRIMARY;
 
 	options->stereo.fixed_w = 1920;
@@ -195,6 +202,10 @@ ConfOptions *init_options(ConfOptions *options)
 	options->log_window.timer_data = FALSE;
 
 	options->read_metadata_in_idle = FALSE;
+
+	options->threads.duplicates = 0;
+	options->threads.image_loader = 0;
+	options->threads.cache_render = 0;
 	options->star_rating.star = STAR_RATING_STAR;
 	options->star_rating.rejected = STAR_RATING_REJECTED;
 
@@ -339,7 +350,7 @@ void save_options(ConfOptions *options)
 	g_free(rc_path);
 }
 
-gboolean load_options(ConfOptions *options)
+static gboolean load_options_real(ConfOptions *options, gboolean global_only)
 {
 	gboolean success;
 	gchar *rc_path;
@@ -347,15 +358,26 @@ gboolean load_options(ConfOptions *options)
 	if (isdir(GQ_SYSTEM_WIDE_DIR))
 		{
 		rc_path = g_build_filename(GQ_SYSTEM_WIDE_DIR, RC_FILE_NAME, NULL);
-		success = load_config_from_file(rc_path, TRUE);
+		success = global_only ? load_global_config_from_file(rc_path) : load_config_from_file(rc_path, TRUE);
 		DEBUG_1("Loading options from %s ... %s", rc_path, success ? "done" : "failed");
 		g_free(rc_path);
 		}
 
 	rc_path = g_build_filename(get_rc_dir(), RC_FILE_NAME, NULL);
-	success = load_config_from_file(rc_path, TRUE);
+	success = global_only ? load_global_config_from_file(rc_path) : load_config_from_file(rc_path, TRUE);
 	DEBUG_1("Loading options from %s ... %s", rc_path, success ? "done" : "failed");
 	g_free(rc_path);
 	return(success);
 }
+
+gboolean load_options(ConfOptions *options)
+{
+	return load_options_real(options, FALSE);
+}
+
+/* as load_options(), but the saved layout windows are not opened */
+gboolean load_global_options(ConfOptions *options)
+{
+	return load_options_real(options, TRUE);
+}
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
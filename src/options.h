@@ -46,11 +46,13 @@ struct _ConfOptions
 
 	gboolean lazy_image_sync;
 	gboolean update_on_time_change;
+	gboolean cache_dir_lists;
 
 	guint duplicates_similarity_threshold;
 	guint duplicates_match;
 	gboolean duplicates_thumbnails;
 	guint duplicates_select_type;
+	guint duplicates_checksum;
 	gboolean rot_invariant_sim;
 	gboolean sort_totals;
 
@@ -119,10 +121,15 @@ struct _ConfOptions
 
 		gint tile_cache_max;	/* in megabytes */
 		gint image_cache_max;   /* in megabytes */
+		gint exif_cache_max;	/* in megabytes */
 		gboolean enable_read_ahead;
+		gint read_ahead_count;	/* images preloaded in the browsing direction */
+		gint read_behind_count;	/* images preloaded behind */
 
 		ZoomMode zoom_mode;
 		gboolean zoom_2pass;
+		gboolean zoom_mipmaps;	/* scale large images from downsampled copies when zoomed out */
+		gint tile_prefetch;	/* rows or columns of tiles rendered ahead of scrolling */
 		gboolean zoom_to_fit_allow_expand;
 		guint zoom_quality;
 		gint zoom_increment;	/* 100 is 1.0, 5 is 0.05, 200 is 2.0, etc. */
@@ -147,6 +154,7 @@ struct _ConfOptions
 		gboolean use_exif;
 		gboolean use_ft_metadata;
 		gint collection_preview;
+		gint png_compression; /* zlib level used for standard thumbnails */
 // 		gboolean use_ft_metadata_small;
 	} thumbnails;
 
@@ -326,6 +334,13 @@ struct _ConfOptions
 
 	gboolean read_metadata_in_idle;
 
+	/* worker threads, 0 = number of cpu cores */
+	struct {
+		gint duplicates;
+		gint image_loader;
+		gint cache_render;
+	} threads;
+
 	GList *disabled_plugins;
 };
 
@@ -336,6 +351,7 @@ ConfOptions *init_options(ConfOptions *options);
 void setup_default_options(ConfOptions *options);
 void save_options(ConfOptions *options);
 gboolean load_options(ConfOptions *options);
+gboolean load_global_options(ConfOptions *options);
 
 void copy_layout_options(LayoutOptions *dest, const LayoutOptions *src);
 void free_layout_options_content(LayoutOptions *dest);
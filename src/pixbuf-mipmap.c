@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "main.h"
+#include "pixbuf-mipmap.h"
+
+
+/*
+ *-------------------------------------------------------------------
+ * A pyramid of large images, each level is half the size of the
+ * previous one, downsampled with a 2x2 box filter. When the image is
+ * zoomed out, the tiles are scaled from the nearest level instead of
+ * the full image, which touches far fewer source pixels.
+ *
+ * The pyramid is attached to the pixbuf, so it is shared by all views
+ * and the image cache, and freed with the pixbuf. It is built by one
+ * worker thread, the levels are used when all are done.
+ *-------------------------------------------------------------------
+ */
+
+#define PIXBUF_MIPMAP_MIN_IMAGE 4096	/* images smaller than this in both directions get no pyramid */
+#define PIXBUF_MIPMAP_MIN_LEVEL 256	/* no level is smaller than this in both directions */
+#define PIXBUF_MIPMAP_MAX_LEVELS 16
+
+#define PIXBUF_MIPMAP_KEY "pixbuf_mipmap"
+
+typedef struct _PixbufMipmap PixbufMipmap;
+struct _PixbufMipmap
+{
+	gint done;		/* atomic, levels are complete */
+	gint count;
+	GdkPixbuf *levels[PIXBUF_MIPMAP_MAX_LEVELS];	/* levels[0] is half the size of the pixbuf */
+};
+
+#ifdef HAVE_GTHREAD
+static GThreadPool *pixbuf_mipmap_pool = NULL;
+#endif
+
+
+gboolean pixbuf_mipmap_wanted(GdkPixbuf *pixbuf)
+{
+#ifdef HAVE_GTHREAD
+	if (!options->image.zoom_mipmaps || !pixbuf) return FALSE;
+
+	if (gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB ||
+	    gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) return FALSE;
+
+	return (gdk_pixbuf_get_width(pixbuf) >= PIXBUF_MIPMAP_MIN_IMAGE ||
+		gdk_pixbuf_get_height(pixbuf) >= PIXBUF_MIPMAP_MIN_IMAGE);
+#else
+	return FALSE;
+#endif
+}
+
+static gboolean pixbuf_mipmap_next_size(gint *w, gint *h)
+{
+	if (MAX(*w, *h) < PIXBUF_MIPMAP_MIN_LEVEL * 2) return FALSE;
+
+	*w = (*w + 1) / 2;
+	*h = (*h + 1) / 2;
+	return TRUE;
+}
+
+gulong pixbuf_mipmap_size(GdkPixbuf *pixbuf)
+{
+	gint w, h;
+	gint channels;
+	gint i = 0;
+	gulong size = 0;
+
+	if (!pixbuf_mipmap_wanted(pixbuf)) return 0;
+
+	w = gdk_pixbuf_get_width(pixbuf);
+	h = gdk_pixbuf_get_height(pixbuf);
+	channels = gdk_pixbuf_get_n_channels(pixbuf);
+
+	while (i < PIXBUF_MIPMAP_MAX_LEVELS && pixbuf_mipmap_next_size(&w, &h))
+		{
+		size += (gulong)((w * channels + 3) & ~3) * h;
+		i++;
+		}
+	return size;
+}
+
+static void pixbuf_mipmap_free(gpointer data)
+{
+	PixbufMipmap *mm = data;
+	gint i;
+
+	for (i = 0; i < mm->count; i++)
+		{
+		g_object_unref(mm->levels[i]);
+		}
+	g_free(mm);
+}
+
+/* 2x2 box filter, the last row or column is repeated for odd sizes */
+static GdkPixbuf *pixbuf_mipmap_half(GdkPixbuf *src)
+{
+	GdkPixbuf *dest;
+	gint sw, sh, srs;
+	gint dw, dh, drs;
+	gint n;
+	guchar *s_pix, *d_pix;
+	gint x, y, c;
+
+	sw = gdk_pixbuf_get_width(src);
+	sh = gdk_pixbuf_get_height(src);
+	srs = gdk_pixbuf_get_rowstride(src);
+	s_pix = gdk_pixbuf_get_pixels(src);
+	n = gdk_pixbuf_get_n_channels(src);
+
+	dw = sw;
+	dh = sh;
+	if (!pixbuf_mipmap_next_size(&dw, &dh)) return NULL;
+
+	dest = gdk_pixbuf_new(GDK_COLORSPACE_RGB, gdk_pixbuf_get_has_alpha(src), 8, dw, dh);
+	if (!dest) return NULL;
+
+	drs = gdk_pixbuf_get_rowstride(dest);
+	d_pix = gdk_pixbuf_get_pixels(dest);
+
+	for (y = 0; y < dh; y++)
+		{
+		const guchar *s0 = s_pix + (gsize)(y * 2) * srs;
+		const guchar *s1 = s_pix + (gsize)MIN(y * 2 + 1, sh - 1) * srs;
+		guchar *dp = d_pix + (gsize)y * drs;
+
+		for (x = 0; x < sw / 2; x++)
+			{
+			for (c = 0; c < n; c++)
+				{
+				dp[c] = (s0[c] + s0[c + n] + s1[c] + s1[c + n] + 2) >> 2;
+				}
+			s0 += n * 2;
+			s1 += n * 2;
+			dp += n;
+			}
+
+		if (sw & 1)
+			{
+			for (c = 0; c < n; c++)
+				{
+				dp[c] = (s0[c] + s1[c] + 1) >> 1;
+				}
+			}
+		}
+
+	return dest;
+}
+
+#ifdef HAVE_GTHREAD
+static void pixbuf_mipmap_thread_run(gpointer data, gpointer user_data)
+{
+	GdkPixbuf *pixbuf = data;
+	PixbufMipmap *mm = g_object_get_data(G_OBJECT(pixbuf), PIXBUF_MIPMAP_KEY);
+
+	/* skip the images which have been dropped meanwhile */
+	if (g_atomic_int_get((gint *)&G_OBJECT(pixbuf)->ref_count) > 1)
+		{
+		GdkPixbuf *src = pixbuf;
+
+		while (mm->count < PIXBUF_MIPMAP_MAX_LEVELS)
+			{
+			GdkPixbuf *level = pixbuf_mipmap_half(src);
+
+			if (!level) break;
+			mm->levels[mm->count++] = level;
+			src = level;
+			}
+
+		DEBUG_1("mipmap: %dx%d %d levels", gdk_pixbuf_get_width(pixbuf), gdk_pixbuf_get_height(pixbuf), mm->count);
+		}
+
+	g_atomic_int_set(&mm->done, TRUE);
+	g_object_unref(pixbuf);
+}
+#endif
+
+void pixbuf_mipmap_request(GdkPixbuf *pixbuf)
+{
+#ifdef HAVE_GTHREAD
+	PixbufMipmap *mm;
+
+	if (!pixbuf_mipmap_wanted(pixbuf)) return;
+	if (g_object_get_data(G_OBJECT(pixbuf), PIXBUF_MIPMAP_KEY)) return;
+
+	mm = g_new0(PixbufMipmap, 1);
+	g_object_set_data_full(G_OBJECT(pixbuf), PIXBUF_MIPMAP_KEY, mm, pixbuf_mipmap_free);
+
+	if (!pixbuf_mipmap_pool)
+		{
+		pixbuf_mipmap_pool = g_thread_pool_new(pixbuf_mipmap_thread_run, NULL, 1, FALSE, NULL);
+		}
+	g_thread_pool_push(pixbuf_mipmap_pool, g_object_ref(pixbuf), NULL);
+#endif
+}
+
+GdkPixbuf *pixbuf_mipmap_get_level(GdkPixbuf *pixbuf, gdouble scale_x, gdouble scale_y,
+				   gdouble *level_x, gdouble *level_y)
+{
+	PixbufMipmap *mm;
+	gint i;
+
+	*level_x = 1.0;
+	*level_y = 1.0;
+
+	if (!pixbuf) return NULL;
+
+	mm = g_object_get_data(G_OBJECT(pixbuf), PIXBUF_MIPMAP_KEY);
+	if (!mm || !g_atomic_int_get(&mm->done)) return pixbuf;
+
+	for (i = mm->count - 1; i >= 0; i--)
+		{
+		gdouble lx = (gdouble)gdk_pixbuf_get_width(pixbuf) / gdk_pixbuf_get_width(mm->levels[i]);
+		gdouble ly = (gdouble)gdk_pixbuf_get_height(pixbuf) / gdk_pixbuf_get_height(mm->levels[i]);
+
+		/* the level must not be scaled up */
+		if (scale_x * lx <= 1.0 && scale_y * ly <= 1.0)
+			{
+			*level_x = lx;
+			*level_y = ly;
+			return mm->levels[i];
+			}
+		}
+
+	return pixbuf;
+}
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
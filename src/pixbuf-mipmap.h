@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2008 - 2016 The Geeqie Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PIXBUF_MIPMAP_H
+#define PIXBUF_MIPMAP_H
+
+
+/* TRUE if a pyramid would be built for pixbuf, depends on options->image.zoom_mipmaps */
+gboolean pixbuf_mipmap_wanted(GdkPixbuf *pixbuf);
+
+/* memory used by the pyramid of pixbuf, counted in advance for the image cache */
+gulong pixbuf_mipmap_size(GdkPixbuf *pixbuf);
+
+/* starts building the pyramid of a fully loaded pixbuf in the background, if wanted */
+void pixbuf_mipmap_request(GdkPixbuf *pixbuf);
+
+/* returns the smallest level of pixbuf which is still at least as large as
+ * the image scaled by scale_x, scale_y, or pixbuf itself if there is none yet;
+ * level_x, level_y are set to the size of a level pixel in pixbuf pixels.
+ * The level is valid as long as pixbuf.
+ */
+GdkPixbuf *pixbuf_mipmap_get_level(GdkPixbuf *pixbuf, gdouble scale_x, gdouble scale_y,
+				   gdouble *level_x, gdouble *level_y);
+
+
+#endif
+/* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
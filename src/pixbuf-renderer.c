@@ -101,6 +101,7 @@ enum {
 	PROP_COMPLETE,
 	PROP_CACHE_SIZE_DISPLAY,
 	PROP_CACHE_SIZE_TILES,
+	PROP_TILE_PREFETCH,
 	PROP_WINDOW_FIT,
 	PROP_WINDOW_LIMIT,
 	PROP_WINDOW_LIMIT_VALUE,
@@ -286,6 +287,16 @@ static void pixbuf_renderer_class_init(PixbufRendererClass *class)
 							  PR_CACHE_SIZE_DEFAULT,
 							  G_PARAM_READABLE | G_PARAM_WRITABLE));
 
+	g_object_class_install_property(gobject_class,
+					PROP_TILE_PREFETCH,
+					g_param_spec_uint("tile_prefetch",
+							  "Tile prefetch",
+							  "Rows or columns of tiles rendered ahead of scrolling.",
+							  0,
+							  8,
+							  0,
+							  G_PARAM_READABLE | G_PARAM_WRITABLE));
+
 	g_object_class_install_property(gobject_class,
 					PROP_WINDOW_FIT,
 					g_param_spec_boolean("window_fit",
@@ -423,6 +434,7 @@ static void pixbuf_renderer_init(PixbufRenderer *pr)
 	pr->zoom_max = PR_ZOOM_MAX;
 	pr->zoom_quality = GDK_INTERP_BILINEAR;
 	pr->zoom_2pass = FALSE;
+	pr->tile_prefetch = 0;
 
 	pr->zoom = 1.0;
 	pr->scale = 1.0;
@@ -526,6 +538,9 @@ static void pixbuf_renderer_set_property(GObject *object, guint prop_id,
 		case PROP_CACHE_SIZE_TILES:
 			pr->source_tiles_cache_size = g_value_get_uint(value);
 			break;
+		case PROP_TILE_PREFETCH:
+			pr->tile_prefetch = g_value_get_uint(value);
+			break;
 		case PROP_WINDOW_FIT:
 			pr->window_fit = g_value_get_boolean(value);
 			break;
@@ -592,6 +607,9 @@ static void pixbuf_renderer_get_property(GObject *object, guint prop_id,
 		case PROP_CACHE_SIZE_TILES:
 			g_value_set_uint(value, pr->source_tiles_cache_size);
 			break;
+		case PROP_TILE_PREFETCH:
+			g_value_set_uint(value, pr->tile_prefetch);
+			break;
 		case PROP_WINDOW_FIT:
 			g_value_set_boolean(value, pr->window_fit);
 			break;
@@ -146,6 +146,8 @@ struct _PixbufRenderer
 	gboolean zoom_2pass;
 	gboolean zoom_expand;
 
+	gint tile_prefetch;	/* rows or columns of tiles rendered ahead of scrolling */
+
 	PixbufRendererScrollResetType scroll_reset;
 
 	gboolean has_frame;
@@ -254,6 +256,9 @@ gint pixbuf_renderer_get_orientation(PixbufRenderer *pr);
 /* sets the format of stereo data in the input pixbuf */
 void pixbuf_renderer_set_stereo_data(PixbufRenderer *pr, StereoPixbufData stereo_data);
 
+/* func is called on the main thread only, once per rendered tile after its pixels are
+ * produced, so it may use state that is not thread safe (the color management transform)
+ */
 void pixbuf_renderer_set_post_process_func(PixbufRenderer *pr, PixbufRendererPostProcessFunc func, gpointer user_data, gboolean slow);
 
 /* display an on-request array of pixbuf tiles */
@@ -27,6 +27,9 @@
 #include "icons/icons_inline.h"
 
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 /*
@@ -360,54 +363,186 @@ gboolean util_clip_region(gint x, gint y, gint w, gint h,
  *-----------------------------------------------------------------------------
  */
 
-static void pixbuf_copy_block_rotate(guchar *src, gint src_row_stride, gint x, gint y,
-				     guchar *dest, gint dest_row_stride, gint w, gint h,
-				     gint bytes_per_pixel, gboolean counter_clockwise)
+#define ROTATE_BLOCK_SIZE 32	/* pixels, a block of source and destination rows stays in cache */
+
+/* copies the pixels of the src rectangle x1,y1 - x2,y2 of a rotated block,
+ * the size of the pixel is passed as a constant so the copy is inlined
+ */
+#define ROTATE_RECT(bpp) \
+	for (i = y1; i < y2; i++) \
+		{ \
+		sp = src + i * src_row_stride + x1 * (bpp); \
+		if (counter_clockwise) \
+			{ \
+			dp = dest + (w - x1 - 1) * dest_row_stride + i * (bpp); \
+			for (j = x1; j < x2; j++) \
+				{ \
+				memcpy(dp, sp, (bpp)); \
+				sp += (bpp); \
+				dp -= dest_row_stride; \
+				} \
+			} \
+		else \
+			{ \
+			dp = dest + x1 * dest_row_stride + (h - i - 1) * (bpp); \
+			for (j = x1; j < x2; j++) \
+				{ \
+				memcpy(dp, sp, (bpp)); \
+				sp += (bpp); \
+				dp += dest_row_stride; \
+				} \
+			} \
+		}
+
+static void pixbuf_rotate_rect(const guchar *src, gint src_row_stride,
+			       guchar *dest, gint dest_row_stride, gint w, gint h,
+			       gint x1, gint y1, gint x2, gint y2,
+			       gint bytes_per_pixel, gboolean counter_clockwise)
 {
-	gint i, j;
-	guchar *sp;
+	const guchar *sp;
 	guchar *dp;
+	gint i, j;
 
-	for (i = 0; i < h; i++)
+	if (bytes_per_pixel == 4)
 		{
-		sp = src + ((i + y) * src_row_stride) + (x * bytes_per_pixel);
-		for (j = 0; j < w; j++)
+		ROTATE_RECT(4)
+		}
+	else
+		{
+		ROTATE_RECT(3)
+		}
+}
+
+#ifdef __SSE2__
+/* rotates the 4x4 block of 4 byte pixels at x,y by transposing it in registers */
+static inline void pixbuf_rotate_4x4_sse2(const guchar *src, gint src_row_stride,
+					  guchar *dest, gint dest_row_stride, gint w, gint h,
+					  gint x, gint y, gboolean counter_clockwise)
+{
+	const guchar *sp = src + y * src_row_stride + x * 4;
+	__m128i r0, r1, r2, r3;
+	__m128i t0, t1, t2, t3;
+	__m128i c[4];
+	gint k;
+
+	r0 = _mm_loadu_si128((const __m128i *)sp);
+	r1 = _mm_loadu_si128((const __m128i *)(sp + src_row_stride));
+	r2 = _mm_loadu_si128((const __m128i *)(sp + src_row_stride * 2));
+	r3 = _mm_loadu_si128((const __m128i *)(sp + src_row_stride * 3));
+
+	t0 = _mm_unpacklo_epi32(r0, r1);
+	t1 = _mm_unpackhi_epi32(r0, r1);
+	t2 = _mm_unpacklo_epi32(r2, r3);
+	t3 = _mm_unpackhi_epi32(r2, r3);
+
+	/* c[k] is column x + k, top to bottom */
+	c[0] = _mm_unpacklo_epi64(t0, t2);
+	c[1] = _mm_unpackhi_epi64(t0, t2);
+	c[2] = _mm_unpacklo_epi64(t1, t3);
+	c[3] = _mm_unpackhi_epi64(t1, t3);
+
+	for (k = 0; k < 4; k++)
+		{
+		if (counter_clockwise)
 			{
-			if (counter_clockwise)
+			_mm_storeu_si128((__m128i *)(dest + (w - x - k - 1) * dest_row_stride + y * 4), c[k]);
+			}
+		else
+			{
+			_mm_storeu_si128((__m128i *)(dest + (x + k) * dest_row_stride + (h - y - 4) * 4),
+					 _mm_shuffle_epi32(c[k], _MM_SHUFFLE(0, 1, 2, 3)));
+			}
+		}
+}
+#endif
+
+/*
+ * Copies the w x h block of pixels at src rotated 90 degrees clockwise or
+ * counterclockwise to the h x w block at dest. The blocks must not overlap.
+ */
+void pixbuf_rotate_block_90(const guchar *src, gint src_row_stride,
+			    guchar *dest, gint dest_row_stride, gint w, gint h,
+			    gint bytes_per_pixel, gboolean counter_clockwise)
+{
+	gint bx, by;
+
+	for (by = 0; by < h; by += ROTATE_BLOCK_SIZE)
+		{
+		gint y2 = MIN(by + ROTATE_BLOCK_SIZE, h);
+
+		for (bx = 0; bx < w; bx += ROTATE_BLOCK_SIZE)
+			{
+			gint x2 = MIN(bx + ROTATE_BLOCK_SIZE, w);
+			gint y = by;
+
+#ifdef __SSE2__
+			if (bytes_per_pixel == 4)
 				{
-				dp = dest + ((w - j - 1) * dest_row_stride) + (i * bytes_per_pixel);
+				for (; y + 4 <= y2; y += 4)
+					{
+					gint x;
+
+					for (x = bx; x + 4 <= x2; x += 4)
+						{
+						pixbuf_rotate_4x4_sse2(src, src_row_stride, dest, dest_row_stride,
+								       w, h, x, y, counter_clockwise);
+						}
+					if (x < x2)
+						{
+						pixbuf_rotate_rect(src, src_row_stride, dest, dest_row_stride, w, h,
+								   x, y, x2, y + 4, bytes_per_pixel, counter_clockwise);
+						}
+					}
 				}
-			else
+#endif
+			if (y < y2)
 				{
-				dp = dest + (j * dest_row_stride) + ((h - i - 1) * bytes_per_pixel);
+				pixbuf_rotate_rect(src, src_row_stride, dest, dest_row_stride, w, h,
+						   bx, y, x2, y2, bytes_per_pixel, counter_clockwise);
 				}
-			*(dp++) = *(sp++);	/* r */
-			*(dp++) = *(sp++);	/* g */
-			*(dp++) = *(sp++);	/* b */
-			if (bytes_per_pixel == 4) *(dp) = *(sp++);	/* a */
 			}
 		}
-
 }
 
-static void pixbuf_copy_block(guchar *src, gint src_row_stride, gint w, gint h,
-			      guchar *dest, gint dest_row_stride, gint x, gint y, gint bytes_per_pixel)
+/*
+ * Copies the row of w pixels at src in reverse order to dest.
+ */
+void pixbuf_mirror_row(const guchar *src, guchar *dest, gint w, gint bytes_per_pixel)
 {
-	gint i;
-	guchar *sp;
-	guchar *dp;
+	const guchar *sp = src;
+	guchar *dp = dest + (w - 1) * bytes_per_pixel;
+	gint j = 0;
 
-	for (i = 0; i < h; i++)
+	if (bytes_per_pixel == 4)
 		{
-		sp = src + (i * src_row_stride);
-		dp = dest + ((y + i) * dest_row_stride) + (x * bytes_per_pixel);
-		memcpy(dp, sp, w * bytes_per_pixel);
+#ifdef __SSE2__
+		for (; j + 4 <= w; j += 4)
+			{
+			__m128i v = _mm_loadu_si128((const __m128i *)sp);
+
+			_mm_storeu_si128((__m128i *)(dp - 12), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+			sp += 16;
+			dp -= 16;
+			}
+#endif
+		for (; j < w; j++)
+			{
+			memcpy(dp, sp, 4);
+			sp += 4;
+			dp -= 4;
+			}
+		}
+	else
+		{
+		for (; j < w; j++)
+			{
+			memcpy(dp, sp, 3);
+			sp += 3;
+			dp -= 3;
+			}
 		}
 }
 
-#define ROTATE_BUFFER_WIDTH 48
-#define ROTATE_BUFFER_HEIGHT 48
-
 /*
  * Returns a copy of pixbuf src rotated 90 degrees clockwise or 90 counterclockwise
  *
@@ -420,12 +555,7 @@ GdkPixbuf *pixbuf_copy_rotate_90(GdkPixbuf *src, gboolean counter_clockwise)
 	gint dw, dh, drs;
 	guchar *s_pix;
 	guchar *d_pix;
-	gint i, j;
 	gint a;
-	GdkPixbuf *buffer;
-	guchar *b_pix;
-	gint brs;
-	gint w, h;
 
 	if (!src) return NULL;
 
@@ -443,39 +573,7 @@ GdkPixbuf *pixbuf_copy_rotate_90(GdkPixbuf *src, gboolean counter_clockwise)
 
 	a = (has_alpha ? 4 : 3);
 
-	buffer = gdk_pixbuf_new(GDK_COLORSPACE_RGB, has_alpha, 8,
-				ROTATE_BUFFER_WIDTH, ROTATE_BUFFER_HEIGHT);
-	b_pix = gdk_pixbuf_get_pixels(buffer);
-	brs = gdk_pixbuf_get_rowstride(buffer);
-
-	for (i = 0; i < sh; i+= ROTATE_BUFFER_WIDTH)
-		{
-		w = MIN(ROTATE_BUFFER_WIDTH, (sh - i));
-		for (j = 0; j < sw; j += ROTATE_BUFFER_HEIGHT)
-			{
-			gint x, y;
-
-			h = MIN(ROTATE_BUFFER_HEIGHT, (sw - j));
-			pixbuf_copy_block_rotate(s_pix, srs, j, i,
-						 b_pix, brs, h, w,
-						 a, counter_clockwise);
-
-			if (counter_clockwise)
-				{
-				x = i;
-				y = sw - h - j;
-				}
-			else
-				{
-				x = sh - w - i;
-				y = j;
-				}
-			pixbuf_copy_block(b_pix, brs, w, h,
-					  d_pix, drs, x, y, a);
-			}
-		}
-
-	g_object_unref(buffer);
+	pixbuf_rotate_block_90(s_pix, srs, d_pix, drs, sw, sh, a, counter_clockwise);
 
 #if 0
 	/* this is the simple version of rotation (roughly 2-4x slower) */
@@ -520,7 +618,7 @@ GdkPixbuf *pixbuf_copy_mirror(GdkPixbuf *src, gboolean mirror, gboolean flip)
 	guchar *d_pix;
 	guchar *sp;
 	guchar *dp;
-	gint i, j;
+	gint i;
 	gint a;
 
 	if (!src) return NULL;
@@ -550,25 +648,11 @@ GdkPixbuf *pixbuf_copy_mirror(GdkPixbuf *src, gboolean mirror, gboolean flip)
 			}
 		if (mirror)
 			{
-			dp += (w - 1) * a;
-			for (j = 0; j < w; j++)
-				{
-				*(dp++) = *(sp++);	/* r */
-				*(dp++) = *(sp++);	/* g */
-				*(dp++) = *(sp++);	/* b */
-				if (has_alpha) *(dp) = *(sp++);	/* a */
-				dp -= (a + 3);
-				}
+			pixbuf_mirror_row(sp, dp, w, a);
 			}
 		else
 			{
-			for (j = 0; j < w; j++)
-				{
-				*(dp++) = *(sp++);	/* r */
-				*(dp++) = *(sp++);	/* g */
-				*(dp++) = *(sp++);	/* b */
-				if (has_alpha) *(dp++) = *(sp++);	/* a */
-				}
+			memcpy(dp, sp, w * a);
 			}
 		}
 
@@ -85,6 +85,11 @@ gboolean pixbuf_scale_aspect(gint req_w, gint req_h, gint old_w, gint old_h, gin
 #define PIXBUF_INLINE_ICON_FLIP	"icon_flip"
 #define PIXBUF_INLINE_ICON_ORIGINAL	"icon_original"
 
+void pixbuf_rotate_block_90(const guchar *src, gint src_row_stride,
+			    guchar *dest, gint dest_row_stride, gint w, gint h,
+			    gint bytes_per_pixel, gboolean counter_clockwise);
+void pixbuf_mirror_row(const guchar *src, guchar *dest, gint w, gint bytes_per_pixel);
+
 GdkPixbuf *pixbuf_copy_rotate_90(GdkPixbuf *src, gboolean counter_clockwise);
 GdkPixbuf *pixbuf_copy_mirror(GdkPixbuf *src, gboolean mirror, gboolean flip);
 GdkPixbuf* pixbuf_apply_orientation(GdkPixbuf *pixbuf, gint orientation);
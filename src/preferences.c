@@ -271,6 +271,8 @@ static void config_window_apply(void)
 	options->show_window_ids = c_options->show_window_ids;
 	options->image.scroll_reset_method = c_options->image.scroll_reset_method;
 	options->image.zoom_2pass = c_options->image.zoom_2pass;
+	options->image.zoom_mipmaps = c_options->image.zoom_mipmaps;
+	options->image.tile_prefetch = c_options->image.tile_prefetch;
 	options->image.fit_window_to_image = c_options->image.fit_window_to_image;
 	options->image.limit_window_size = c_options->image.limit_window_size;
 	options->image.zoom_to_fit_allow_expand = c_options->image.zoom_to_fit_allow_expand;
@@ -296,6 +298,7 @@ static void config_window_apply(void)
 	options->thumbnails.cache_into_dirs = c_options->thumbnails.cache_into_dirs;
 	options->thumbnails.use_exif = c_options->thumbnails.use_exif;
 	options->thumbnails.collection_preview = c_options->thumbnails.collection_preview;
+	options->thumbnails.png_compression = c_options->thumbnails.png_compression;
 	options->thumbnails.use_ft_metadata = c_options->thumbnails.use_ft_metadata;
 // 	options->thumbnails.use_ft_metadata_small = c_options->thumbnails.use_ft_metadata_small;
 	options->thumbnails.spec_standard = c_options->thumbnails.spec_standard;
@@ -325,12 +328,15 @@ static void config_window_apply(void)
 
 	options->image.tile_cache_max = c_options->image.tile_cache_max;
 	options->image.image_cache_max = c_options->image.image_cache_max;
+	options->image.exif_cache_max = c_options->image.exif_cache_max;
 
 	options->image.zoom_quality = c_options->image.zoom_quality;
 
 	options->image.zoom_increment = c_options->image.zoom_increment;
 
 	options->image.enable_read_ahead = c_options->image.enable_read_ahead;
+	options->image.read_ahead_count = c_options->image.read_ahead_count;
+	options->image.read_behind_count = c_options->image.read_behind_count;
 
 
 	if (options->image.use_custom_border_color != c_options->image.use_custom_border_color
@@ -366,6 +372,7 @@ static void config_window_apply(void)
 	options->image_overlay.background_blue = c_options->image_overlay.background_blue;
 	options->image_overlay.background_alpha = c_options->image_overlay.background_alpha;
 	options->update_on_time_change = c_options->update_on_time_change;
+	options->cache_dir_lists = c_options->cache_dir_lists;
 	options->image.exif_proof_rotate_enable = c_options->image.exif_proof_rotate_enable;
 
 	options->duplicates_similarity_threshold = c_options->duplicates_similarity_threshold;
@@ -428,6 +435,10 @@ static void config_window_apply(void)
 
 	options->read_metadata_in_idle = c_options->read_metadata_in_idle;
 
+	options->threads.duplicates = c_options->threads.duplicates;
+	options->threads.image_loader = c_options->threads.image_loader;
+	options->threads.cache_render = c_options->threads.cache_render;
+
 	options->star_rating.star = c_options->star_rating.star;
 	options->star_rating.rejected = c_options->star_rating.rejected;
 #ifdef DEBUG
@@ -1906,6 +1917,11 @@ static void config_tab_general(GtkWidget *notebook)
 				 options->thumbnails.collection_preview, &c_options->thumbnails.collection_preview);
 	gtk_widget_set_tooltip_text(spin, _("The maximum number of thumbnails shown in a Collection preview montage"));
 
+	spin = pref_spin_new_int(group, _("PNG compression level:"), NULL,
+				 0, 9, 1,
+				 options->thumbnails.png_compression, &c_options->thumbnails.png_compression);
+	gtk_widget_set_tooltip_text(spin, _("Compression of thumbnails saved in the standard thumbnail cache, 1 is fastest, 9 gives the smallest files"));
+
 #ifdef HAVE_FFMPEGTHUMBNAILER_METADATA
 	pref_checkbox_new_int(group, _("Use embedded metadata in video files as thumbnails when available"),
 			      options->thumbnails.use_ft_metadata, &c_options->thumbnails.use_ft_metadata);
@@ -2023,11 +2039,30 @@ static void config_tab_general(GtkWidget *notebook)
 
 	pref_spin_new_int(group, _("Decoded image cache size (Mb):"), NULL,
 			  0, 99999, 1, options->image.image_cache_max, &c_options->image.image_cache_max);
+	pref_spin_new_int(group, _("Exif data cache size (Mb):"), NULL,
+			  1, 9999, 1, options->image.exif_cache_max, &c_options->image.exif_cache_max);
 	pref_checkbox_new_int(group, _("Preload next image"),
 			      options->image.enable_read_ahead, &c_options->image.enable_read_ahead);
+	pref_spin_new_int(group, _("Images to preload ahead:"), NULL,
+			  1, 16, 1, options->image.read_ahead_count, &c_options->image.read_ahead_count);
+	pref_spin_new_int(group, _("Images to preload behind:"), NULL,
+			  0, 16, 1, options->image.read_behind_count, &c_options->image.read_behind_count);
 
 	pref_checkbox_new_int(group, _("Refresh on file change"),
 			      options->update_on_time_change, &c_options->update_on_time_change);
+	pref_checkbox_new_int(group, _("Show visited folders from a snapshot"),
+			      options->cache_dir_lists, &c_options->cache_dir_lists);
+
+	pref_spacer(group, PREF_PAD_GROUP);
+
+	group = pref_group_new(vbox, FALSE, _("Threads"), GTK_ORIENTATION_VERTICAL);
+
+	pref_spin_new_int(group, _("Duplicate check threads (0 = auto):"), NULL,
+			  0, 256, 1, options->threads.duplicates, &c_options->threads.duplicates);
+	pref_spin_new_int(group, _("Image loader threads (0 = auto):"), NULL,
+			  0, 256, 1, options->threads.image_loader, &c_options->threads.image_loader);
+	pref_spin_new_int(group, _("Thumbnail creation threads (0 = auto):"), NULL,
+			  0, 256, 1, options->threads.cache_render, &c_options->threads.cache_render);
 
 	pref_spacer(group, PREF_PAD_GROUP);
 
@@ -2145,6 +2180,10 @@ static void config_tab_image(GtkWidget *notebook)
 
 	pref_checkbox_new_int(group, _("Two pass rendering (apply HQ zoom and color correction in second pass)"),
 			      options->image.zoom_2pass, &c_options->image.zoom_2pass);
+	pref_checkbox_new_int(group, _("Keep downsampled copies of large images for zooming out"),
+			      options->image.zoom_mipmaps, &c_options->image.zoom_mipmaps);
+	pref_spin_new_int(group, _("Tiles rendered ahead of scrolling:"), NULL,
+			  0, 8, 1, options->image.tile_prefetch, &c_options->image.tile_prefetch);
 
 	c_options->image.zoom_increment = options->image.zoom_increment;
 	spin = pref_spin_new(group, _("Zoom increment:"), NULL,
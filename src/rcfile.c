@@ -315,6 +315,7 @@ static void write_global_attributes(GString *outstr, gint indent)
 	WRITE_NL(); WRITE_BOOL(*options, view_dir_list_single_click_enter);
 	WRITE_NL(); WRITE_BOOL(*options, lazy_image_sync);
 	WRITE_NL(); WRITE_BOOL(*options, update_on_time_change);
+	WRITE_NL(); WRITE_BOOL(*options, cache_dir_lists);
 	WRITE_SEPARATOR();
 
 	WRITE_NL(); WRITE_BOOL(*options, progressive_key_scrolling);
@@ -323,6 +324,7 @@ static void write_global_attributes(GString *outstr, gint indent)
 	WRITE_NL(); WRITE_UINT(*options, duplicates_similarity_threshold);
 	WRITE_NL(); WRITE_UINT(*options, duplicates_match);
 	WRITE_NL(); WRITE_UINT(*options, duplicates_select_type);
+	WRITE_NL(); WRITE_UINT(*options, duplicates_checksum);
 	WRITE_NL(); WRITE_BOOL(*options, duplicates_thumbnails);
 	WRITE_NL(); WRITE_BOOL(*options, rot_invariant_sim);
 	WRITE_NL(); WRITE_BOOL(*options, sort_totals);
@@ -371,6 +373,8 @@ static void write_global_attributes(GString *outstr, gint indent)
 
 	WRITE_SEPARATOR();
 	WRITE_NL(); WRITE_BOOL(*options, image.zoom_2pass);
+	WRITE_NL(); WRITE_BOOL(*options, image.zoom_mipmaps);
+	WRITE_NL(); WRITE_INT(*options, image.tile_prefetch);
 	WRITE_NL(); WRITE_BOOL(*options, image.zoom_to_fit_allow_expand);
 	WRITE_NL(); WRITE_UINT(*options, image.zoom_quality);
 	WRITE_NL(); WRITE_INT(*options, image.zoom_increment);
@@ -383,7 +387,10 @@ static void write_global_attributes(GString *outstr, gint indent)
 	WRITE_NL(); WRITE_UINT(*options, image.scroll_reset_method);
 	WRITE_NL(); WRITE_INT(*options, image.tile_cache_max);
 	WRITE_NL(); WRITE_INT(*options, image.image_cache_max);
+	WRITE_NL(); WRITE_INT(*options, image.exif_cache_max);
 	WRITE_NL(); WRITE_BOOL(*options, image.enable_read_ahead);
+	WRITE_NL(); WRITE_INT(*options, image.read_ahead_count);
+	WRITE_NL(); WRITE_INT(*options, image.read_behind_count);
 	WRITE_NL(); WRITE_BOOL(*options, image.exif_rotate_enable);
 	WRITE_NL(); WRITE_BOOL(*options, image.use_custom_border_color);
 	WRITE_NL(); WRITE_BOOL(*options, image.use_custom_border_color_in_fullscreen);
@@ -403,6 +410,7 @@ static void write_global_attributes(GString *outstr, gint indent)
 	WRITE_NL(); WRITE_BOOL(*options, thumbnails.use_exif);
 	WRITE_NL(); WRITE_BOOL(*options, thumbnails.use_ft_metadata);
 	WRITE_NL(); WRITE_INT(*options, thumbnails.collection_preview);
+	WRITE_NL(); WRITE_INT(*options, thumbnails.png_compression);
 // 	WRITE_NL(); WRITE_BOOL(*options, thumbnails.use_ft_metadata_small);
 
 	/* File sorting Options */
@@ -489,6 +497,10 @@ static void write_global_attributes(GString *outstr, gint indent)
 
 	WRITE_NL(); WRITE_BOOL(*options, read_metadata_in_idle);
 
+	WRITE_NL(); WRITE_INT(*options, threads.duplicates);
+	WRITE_NL(); WRITE_INT(*options, threads.image_loader);
+	WRITE_NL(); WRITE_INT(*options, threads.cache_render);
+
 	WRITE_NL(); WRITE_UINT(*options, star_rating.star);
 	WRITE_NL(); WRITE_UINT(*options, star_rating.rejected);
 
@@ -730,10 +742,12 @@ static gboolean load_global_params(const gchar **attribute_names, const gchar **
 		if (READ_BOOL(*options, view_dir_list_single_click_enter)) continue;
 		if (READ_BOOL(*options, lazy_image_sync)) continue;
 		if (READ_BOOL(*options, update_on_time_change)) continue;
+		if (READ_BOOL(*options, cache_dir_lists)) continue;
 
 		if (READ_UINT_CLAMP(*options, duplicates_similarity_threshold, 0, 100)) continue;
 		if (READ_UINT_CLAMP(*options, duplicates_match, 0, DUPE_MATCH_NAME_CI)) continue;
 		if (READ_UINT_CLAMP(*options, duplicates_select_type, 0, DUPE_SELECT_GROUP2)) continue;
+		if (READ_UINT_CLAMP(*options, duplicates_checksum, 0, CHECKSUM_XXH64)) continue;
 		if (READ_BOOL(*options, duplicates_thumbnails)) continue;
 		if (READ_BOOL(*options, rot_invariant_sim)) continue;
 		if (READ_BOOL(*options, sort_totals)) continue;
@@ -773,6 +787,8 @@ static gboolean load_global_params(const gchar **attribute_names, const gchar **
 		/* Image options */
 		if (READ_UINT_CLAMP(*options, image.zoom_mode, 0, ZOOM_RESET_NONE)) continue;
 		if (READ_BOOL(*options, image.zoom_2pass)) continue;
+		if (READ_BOOL(*options, image.zoom_mipmaps)) continue;
+		if (READ_INT_CLAMP(*options, image.tile_prefetch, 0, 8)) continue;
 		if (READ_BOOL(*options, image.zoom_to_fit_allow_expand)) continue;
 		if (READ_BOOL(*options, image.fit_window_to_image)) continue;
 		if (READ_BOOL(*options, image.limit_window_size)) continue;
@@ -783,9 +799,12 @@ static gboolean load_global_params(const gchar **attribute_names, const gchar **
 		if (READ_UINT_CLAMP(*options, image.scroll_reset_method, 0, PR_SCROLL_RESET_COUNT - 1)) continue;
 		if (READ_INT(*options, image.tile_cache_max)) continue;
 		if (READ_INT(*options, image.image_cache_max)) continue;
+		if (READ_INT(*options, image.exif_cache_max)) continue;
 		if (READ_UINT_CLAMP(*options, image.zoom_quality, GDK_INTERP_NEAREST, GDK_INTERP_HYPER)) continue;
 		if (READ_INT(*options, image.zoom_increment)) continue;
 		if (READ_BOOL(*options, image.enable_read_ahead)) continue;
+		if (READ_INT_CLAMP(*options, image.read_ahead_count, 1, 16)) continue;
+		if (READ_INT_CLAMP(*options, image.read_behind_count, 0, 16)) continue;
 		if (READ_BOOL(*options, image.exif_rotate_enable)) continue;
 		if (READ_BOOL(*options, image.use_custom_border_color)) continue;
 		if (READ_BOOL(*options, image.use_custom_border_color_in_fullscreen)) continue;
@@ -805,6 +824,7 @@ static gboolean load_global_params(const gchar **attribute_names, const gchar **
 		if (READ_UINT_CLAMP(*options, thumbnails.quality, GDK_INTERP_NEAREST, GDK_INTERP_HYPER)) continue;
 		if (READ_BOOL(*options, thumbnails.use_exif)) continue;
 		if (READ_INT(*options, thumbnails.collection_preview)) continue;
+		if (READ_INT_CLAMP(*options, thumbnails.png_compression, 0, 9)) continue;
 		if (READ_BOOL(*options, thumbnails.use_ft_metadata)) continue;
 // 		if (READ_BOOL(*options, thumbnails.use_ft_metadata_small)) continue;
 
@@ -899,6 +919,10 @@ static gboolean load_global_params(const gchar **attribute_names, const gchar **
 
 		if (READ_BOOL(*options, read_metadata_in_idle)) continue;
 
+		if (READ_INT_CLAMP(*options, threads.duplicates, 0, 256)) continue;
+		if (READ_INT_CLAMP(*options, threads.image_loader, 0, 256)) continue;
+		if (READ_INT_CLAMP(*options, threads.cache_render, 0, 256)) continue;
+
 		if (READ_UINT(*options, star_rating.star)) continue;
 		if (READ_UINT(*options, star_rating.rejected)) continue;
 
@@ -1020,6 +1044,7 @@ struct _GQParserData
 {
 	GList *parse_func_stack;
 	gboolean startup; /* reading config for the first time - add commandline and defaults */
+	gboolean global_only; /* skip the layout windows, there may be no display */
 };
 
 static const gchar *options_get_id(const gchar **attribute_names, const gchar **attribute_values)
@@ -1042,6 +1067,11 @@ void options_parse_leaf(GQParserData *parser_data, GMarkupParseContext *context,
 	options_parse_func_push(parser_data, options_parse_leaf, NULL, NULL);
 }
 
+static void options_parse_skip(GQParserData *parser_data, GMarkupParseContext *context, const gchar *element_name, const gchar **attribute_names, const gchar **attribute_values, gpointer data, GError **error)
+{
+	options_parse_func_push(parser_data, options_parse_skip, NULL, NULL);
+}
+
 static void options_parse_color_profiles(GQParserData *parser_data, GMarkupParseContext *context, const gchar *element_name, const gchar **attribute_names, const gchar **attribute_values, gpointer data, GError **error)
 {
 	if (g_ascii_strcasecmp(element_name, "profile") == 0)
@@ -1470,7 +1500,11 @@ static void options_parse_toplevel(GQParserData *parser_data, GMarkupParseContex
 		return;
 		}
 
-	if (g_ascii_strcasecmp(element_name, "layout") == 0)
+	if (g_ascii_strcasecmp(element_name, "layout") == 0 && parser_data->global_only)
+		{
+		options_parse_func_push(parser_data, options_parse_skip, NULL, NULL);
+		}
+	else if (g_ascii_strcasecmp(element_name, "layout") == 0)
 		{
 		LayoutWindow *lw;
 		lw = layout_find_by_layout_id(options_get_id(attribute_names, attribute_values));
@@ -1576,7 +1610,7 @@ static GMarkupParser parser = {
  *-----------------------------------------------------------------------------
  */
 
-gboolean load_config_from_buf(const gchar *buf, gsize size, gboolean startup)
+static gboolean load_config_from_buf_real(const gchar *buf, gsize size, gboolean startup, gboolean global_only)
 {
 	GMarkupParseContext *context;
 	gboolean ret = TRUE;
@@ -1585,6 +1619,7 @@ gboolean load_config_from_buf(const gchar *buf, gsize size, gboolean startup)
 	parser_data = g_new0(GQParserData, 1);
 
 	parser_data->startup = startup;
+	parser_data->global_only = global_only;
 	options_parse_func_push(parser_data, options_parse_toplevel, NULL, NULL);
 
 	context = g_markup_parse_context_new(&parser, 0, parser_data, NULL);
@@ -1601,7 +1636,12 @@ gboolean load_config_from_buf(const gchar *buf, gsize size, gboolean startup)
 	return ret;
 }
 
-gboolean load_config_from_file(const gchar *utf8_path, gboolean startup)
+gboolean load_config_from_buf(const gchar *buf, gsize size, gboolean startup)
+{
+	return load_config_from_buf_real(buf, size, startup, FALSE);
+}
+
+static gboolean load_config_from_file_real(const gchar *utf8_path, gboolean startup, gboolean global_only)
 {
 	gsize size;
 	gchar *buf;
@@ -1611,11 +1651,22 @@ gboolean load_config_from_file(const gchar *utf8_path, gboolean startup)
 		{
 		return FALSE;
 		}
-	ret = load_config_from_buf(buf, size, startup);
+	ret = load_config_from_buf_real(buf, size, startup, global_only);
 	g_free(buf);
 	return ret;
 }
 
+gboolean load_config_from_file(const gchar *utf8_path, gboolean startup)
+{
+	return load_config_from_file_real(utf8_path, startup, FALSE);
+}
+
+/* reads the global options only, without creating any window */
+gboolean load_global_config_from_file(const gchar *utf8_path)
+{
+	return load_config_from_file_real(utf8_path, TRUE, TRUE);
+}
+
 
 
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
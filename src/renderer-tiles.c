@@ -44,6 +44,8 @@
 #include "main.h"
 #include "pixbuf_util.h"
 #include "exif.h"
+#include "misc.h"
+#include "pixbuf-mipmap.h"
 #else
 typedef enum {
 	EXIF_ORIENTATION_UNKNOWN	= 0,
@@ -90,6 +92,11 @@ struct _ImageTile
 	QueueData *qd2;
 
 	guint size;		/* est. memory used by pixmap and pixbuf */
+
+	gboolean rendering;	/* in the batch being rendered, must not be freed */
+	gboolean prefetched;	/* rendered ahead of scrolling and not shown yet */
+
+	GList *link;		/* in RendererTiles tiles, most recently used first */
 };
 
 struct _QueueData
@@ -128,8 +135,16 @@ struct _RendererTiles
 	gint tile_width;
 	gint tile_height;
 	gint tile_cols;		/* count of tile columns */
-	GList *tiles;		/* list of buffer tiles */
+	GQueue tiles;		/* buffer tiles, most recently used first */
+	GHashTable *tile_table;	/* the same tiles, indexed by x, y */
 	gint tile_cache_size;	/* allocated size of pixmaps/pixbufs */
+
+	/* statistics */
+	gulong tile_lookups;
+	gulong tile_misses;
+	gulong tile_evictions;
+	gulong tile_prefetches;
+	gulong tile_prefetch_hits;
 	GList *draw_queue;	/* list of areas to redraw */
 	GList *draw_queue_2pass;/* list when 2 pass is enabled */
 
@@ -138,7 +153,13 @@ struct _RendererTiles
 
 	guint draw_idle_id; /* event source id */
 
-	GdkPixbuf *spare_tile;
+	/* scroll motion, the tiles ahead of it are rendered when idle */
+	gdouble scroll_vx;
+	gdouble scroll_vy;
+	gint64 scroll_time;
+	guint prefetch_idle_id; /* event source id */
+
+	GList *spare_tiles;	/* pixbufs for orientation and anaglyph, reused by the render jobs */
 
 	gint stereo_mode;
 	gint stereo_off_x;
@@ -321,11 +342,30 @@ static void rt_tile_free(ImageTile *it)
 	g_free(it);
 }
 
+static guint rt_tile_hash(gconstpointer key)
+{
+	const ImageTile *it = key;
+
+	return (guint)it->x * 31 + (guint)it->y * 65599;
+}
+
+static gboolean rt_tile_equal(gconstpointer a, gconstpointer b)
+{
+	const ImageTile *ia = a;
+	const ImageTile *ib = b;
+
+	return ia->x == ib->x && ia->y == ib->y;
+}
+
 static void rt_tile_free_all(RendererTiles *rt)
 {
 	GList *work;
 
-	work = rt->tiles;
+	DEBUG_1("tiles: rt=%p count:%u size:%d lookups:%lu misses:%lu evictions:%lu prefetches:%lu hits:%lu",
+		rt, rt->tiles.length, rt->tile_cache_size, rt->tile_lookups, rt->tile_misses, rt->tile_evictions,
+		rt->tile_prefetches, rt->tile_prefetch_hits);
+
+	work = rt->tiles.head;
 	while (work)
 		{
 		ImageTile *it;
@@ -336,8 +376,8 @@ static void rt_tile_free_all(RendererTiles *rt)
 		rt_tile_free(it);
 		}
 
-	g_list_free(rt->tiles);
-	rt->tiles = NULL;
+	g_queue_clear(&rt->tiles);
+	g_hash_table_remove_all(rt->tile_table);
 	rt->tile_cache_size = 0;
 }
 
@@ -351,7 +391,9 @@ static ImageTile *rt_tile_add(RendererTiles *rt, gint x, gint y)
 	if (it->x + it->w > pr->width) it->w = pr->width - it->x;
 	if (it->y + it->h > pr->height) it->h = pr->height - it->y;
 
-	rt->tiles = g_list_prepend(rt->tiles, it);
+	g_queue_push_head(&rt->tiles, it);
+	it->link = rt->tiles.head;
+	g_hash_table_add(rt->tile_table, it);
 	rt->tile_cache_size += it->size;
 
 	return it;
@@ -377,41 +419,65 @@ static void rt_tile_remove(RendererTiles *rt, ImageTile *it)
 		g_free(qd);
 		}
 
-	rt->tiles = g_list_remove(rt->tiles, it);
+	g_queue_delete_link(&rt->tiles, it->link);
+	g_hash_table_remove(rt->tile_table, it);
 	rt->tile_cache_size -= it->size;
 
 	rt_tile_free(it);
 }
 
-static void rt_tile_free_space(RendererTiles *rt, guint space, ImageTile *it)
+static guint rt_tile_cache_limit(RendererTiles *rt)
 {
 	PixbufRenderer *pr = rt->pr;
-	GList *work;
-	guint tile_max;
-
-	work = g_list_last(rt->tiles);
 
 	if (pr->source_tiles_enabled && pr->scale < 1.0)
 		{
 		gint tiles;
 
 		tiles = (pr->vis_width / rt->tile_width + 1) * (pr->vis_height / rt->tile_height + 1);
-		tile_max = MAX(tiles * rt->tile_width * rt->tile_height * 3,
-			       (gint)((gdouble)rt->tile_cache_max * 1048576.0 * pr->scale));
+		return MAX(tiles * rt->tile_width * rt->tile_height * 3,
+			   (gint)((gdouble)rt->tile_cache_max * 1048576.0 * pr->scale));
 		}
-	else
+
+	return rt->tile_cache_max * 1048576;
+}
+
+static void rt_tile_free_space(RendererTiles *rt, guint space, ImageTile *it)
+{
+	GList *work;
+	guint tile_max;
+
+	tile_max = rt_tile_cache_limit(rt);
+
+	/* the tiles rendered ahead of scrolling go first */
+	work = rt->tiles.tail;
+	while (work && rt->tile_cache_size + space > tile_max)
 		{
-		tile_max = rt->tile_cache_max * 1048576;
+		ImageTile *needle;
+
+		needle = work->data;
+		work = work->prev;
+		if (needle->prefetched && needle != it && !needle->rendering &&
+		    !needle->qd && !needle->qd2 && !rt_tile_is_visible(rt, needle))
+			{
+			rt_tile_remove(rt, needle);
+			rt->tile_evictions++;
+			}
 		}
 
+	work = rt->tiles.tail;
 	while (work && rt->tile_cache_size + space > tile_max)
 		{
 		ImageTile *needle;
 
 		needle = work->data;
 		work = work->prev;
-		if (needle != it &&
-		    ((!needle->qd && !needle->qd2) || !rt_tile_is_visible(rt, needle))) rt_tile_remove(rt, needle);
+		if (needle != it && !needle->rendering &&
+		    ((!needle->qd && !needle->qd2) || !rt_tile_is_visible(rt, needle)))
+			{
+			rt_tile_remove(rt, needle);
+			rt->tile_evictions++;
+			}
 		}
 }
 
@@ -420,7 +486,7 @@ static void rt_tile_invalidate_all(RendererTiles *rt)
 	PixbufRenderer *pr = rt->pr;
 	GList *work;
 
-	work = rt->tiles;
+	work = rt->tiles.head;
 	while (work)
 		{
 		ImageTile *it;
@@ -437,6 +503,15 @@ static void rt_tile_invalidate_all(RendererTiles *rt)
 		}
 }
 
+static ImageTile *rt_tile_lookup(RendererTiles *rt, gint x, gint y)
+{
+	ImageTile key;
+
+	key.x = x;
+	key.y = y;
+	return g_hash_table_lookup(rt->tile_table, &key);
+}
+
 static void rt_tile_invalidate_region(RendererTiles *rt, gint x, gint y, gint w, gint h)
 {
 	gint x1, x2;
@@ -449,7 +524,29 @@ static void rt_tile_invalidate_region(RendererTiles *rt, gint x, gint y, gint w,
 	y1 = ROUND_DOWN(y, rt->tile_height);
 	y2 = ROUND_UP(y + h, rt->tile_height);
 
-	work = rt->tiles;
+	/* the tiles are aligned to the tile size, look up the ones in
+	   the region unless there are fewer tiles than that */
+	if ((guint)((x2 - x1) / rt->tile_width) * (guint)((y2 - y1) / rt->tile_height) < rt->tiles.length)
+		{
+		gint i, j;
+
+		for (j = y1; j < y2; j += rt->tile_height)
+			{
+			for (i = x1; i < x2; i += rt->tile_width)
+				{
+				ImageTile *it = rt_tile_lookup(rt, i, j);
+
+				if (it && it->x + it->w > x1 && it->y + it->h > y1)
+					{
+					it->render_done = TILE_RENDER_NONE;
+					it->render_todo = TILE_RENDER_ALL;
+					}
+				}
+			}
+		return;
+		}
+
+	work = rt->tiles.head;
 	while (work)
 		{
 		ImageTile *it;
@@ -468,24 +565,22 @@ static void rt_tile_invalidate_region(RendererTiles *rt, gint x, gint y, gint w,
 
 static ImageTile *rt_tile_get(RendererTiles *rt, gint x, gint y, gboolean only_existing)
 {
-	GList *work;
+	ImageTile *it;
 
-	work = rt->tiles;
-	while (work)
-		{
-		ImageTile *it;
+	rt->tile_lookups++;
 
-		it = work->data;
-		if (it->x == x && it->y == y)
+	it = rt_tile_lookup(rt, x, y);
+	if (it)
+		{
+		if (it->link != rt->tiles.head)
 			{
-			rt->tiles = g_list_delete_link(rt->tiles, work);
-			rt->tiles = g_list_prepend(rt->tiles, it);
-			return it;
+			g_queue_unlink(&rt->tiles, it->link);
+			g_queue_push_head_link(&rt->tiles, it->link);
 			}
-
-		work = work->next;
+		return it;
 		}
 
+	rt->tile_misses++;
 	if (only_existing) return NULL;
 
 	return rt_tile_add(rt, x, y);
@@ -899,95 +994,70 @@ static void rt_hierarchy_changed_cb(GtkWidget *widget, GtkWidget *previous_tople
  *-------------------------------------------------------------------
  */
 
-static GdkPixbuf *rt_get_spare_tile(RendererTiles *rt)
+static GdkPixbuf *rt_get_spare_tile(RendererTiles *rt, GdkPixbuf **spare)
 {
-	if (!rt->spare_tile) rt->spare_tile = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, rt->tile_width * rt->hidpi_scale, rt->tile_height * rt->hidpi_scale);
-	return rt->spare_tile;
+	if (!*spare) *spare = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, rt->tile_width * rt->hidpi_scale, rt->tile_height * rt->hidpi_scale);
+	return *spare;
 }
 
 #define COLOR_BYTES 3	/* rgb */
 
-static void rt_tile_rotate_90_clockwise(RendererTiles *rt, GdkPixbuf **tile, gint x, gint y, gint w, gint h)
+static void rt_tile_rotate_90_clockwise(RendererTiles *rt, GdkPixbuf **tile, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	GdkPixbuf *src = *tile;
 	GdkPixbuf *dest;
 	gint srs, drs;
 	guchar *s_pix, *d_pix;
-	guchar *sp, *dp;
-	guchar *ip, *spi, *dpi;
-	gint i, j;
 	gint tw = rt->tile_width * rt->hidpi_scale;
 
 	srs = gdk_pixbuf_get_rowstride(src);
 	s_pix = gdk_pixbuf_get_pixels(src);
-	spi = s_pix + (x * COLOR_BYTES);
 
-	dest = rt_get_spare_tile(rt);
+	dest = rt_get_spare_tile(rt, spare);
 	drs = gdk_pixbuf_get_rowstride(dest);
 	d_pix = gdk_pixbuf_get_pixels(dest);
-	dpi = d_pix + (tw - 1) * COLOR_BYTES;
 
-	for (i = y; i < y + h; i++)
-		{
-		sp = spi + (i * srs);
-		ip = dpi - (i * COLOR_BYTES);
-		for (j = x; j < x + w; j++)
-			{
-			dp = ip + (j * drs);
-			memcpy(dp, sp, COLOR_BYTES);
-			sp += COLOR_BYTES;
-			}
-		}
+	/* the area x,y w,h goes to x = tw - y - h, y = x */
+	pixbuf_rotate_block_90(s_pix + (y * srs) + (x * COLOR_BYTES), srs,
+			       d_pix + (x * drs) + ((tw - y - h) * COLOR_BYTES), drs,
+			       w, h, COLOR_BYTES, FALSE);
 
-	rt->spare_tile = src;
+	*spare = src;
 	*tile = dest;
 }
 
-static void rt_tile_rotate_90_counter_clockwise(RendererTiles *rt, GdkPixbuf **tile, gint x, gint y, gint w, gint h)
+static void rt_tile_rotate_90_counter_clockwise(RendererTiles *rt, GdkPixbuf **tile, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	GdkPixbuf *src = *tile;
 	GdkPixbuf *dest;
 	gint srs, drs;
 	guchar *s_pix, *d_pix;
-	guchar *sp, *dp;
-	guchar *ip, *spi, *dpi;
-	gint i, j;
 	gint th = rt->tile_height * rt->hidpi_scale;
 
 	srs = gdk_pixbuf_get_rowstride(src);
 	s_pix = gdk_pixbuf_get_pixels(src);
-	spi = s_pix + (x * COLOR_BYTES);
 
-	dest = rt_get_spare_tile(rt);
+	dest = rt_get_spare_tile(rt, spare);
 	drs = gdk_pixbuf_get_rowstride(dest);
 	d_pix = gdk_pixbuf_get_pixels(dest);
-	dpi = d_pix + (th - 1) * drs;
 
-	for (i = y; i < y + h; i++)
-		{
-		sp = spi + (i * srs);
-		ip = dpi + (i * COLOR_BYTES);
-		for (j = x; j < x + w; j++)
-			{
-			dp = ip - (j * drs);
-			memcpy(dp, sp, COLOR_BYTES);
-			sp += COLOR_BYTES;
-			}
-		}
+	/* the area x,y w,h goes to x = y, y = th - x - w */
+	pixbuf_rotate_block_90(s_pix + (y * srs) + (x * COLOR_BYTES), srs,
+			       d_pix + ((th - x - w) * drs) + (y * COLOR_BYTES), drs,
+			       w, h, COLOR_BYTES, TRUE);
 
-	rt->spare_tile = src;
+	*spare = src;
 	*tile = dest;
 }
 
-static void rt_tile_mirror_only(RendererTiles *rt, GdkPixbuf **tile, gint x, gint y, gint w, gint h)
+static void rt_tile_mirror_only(RendererTiles *rt, GdkPixbuf **tile, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	GdkPixbuf *src = *tile;
 	GdkPixbuf *dest;
 	gint srs, drs;
 	guchar *s_pix, *d_pix;
-	guchar *sp, *dp;
 	guchar *spi, *dpi;
-	gint i, j;
+	gint i;
 
 	gint tw = rt->tile_width * rt->hidpi_scale;
 
@@ -995,64 +1065,50 @@ static void rt_tile_mirror_only(RendererTiles *rt, GdkPixbuf **tile, gint x, gin
 	s_pix = gdk_pixbuf_get_pixels(src);
 	spi = s_pix + (x * COLOR_BYTES);
 
-	dest = rt_get_spare_tile(rt);
+	dest = rt_get_spare_tile(rt, spare);
 	drs = gdk_pixbuf_get_rowstride(dest);
 	d_pix = gdk_pixbuf_get_pixels(dest);
-	dpi =  d_pix + (tw - x - 1) * COLOR_BYTES;
+	dpi =  d_pix + (tw - x - w) * COLOR_BYTES;
 
 	for (i = y; i < y + h; i++)
 		{
-		sp = spi + (i * srs);
-		dp = dpi + (i * drs);
-		for (j = 0; j < w; j++)
-			{
-			memcpy(dp, sp, COLOR_BYTES);
-			sp += COLOR_BYTES;
-			dp -= COLOR_BYTES;
-			}
+		pixbuf_mirror_row(spi + (i * srs), dpi + (i * drs), w, COLOR_BYTES);
 		}
 
-	rt->spare_tile = src;
+	*spare = src;
 	*tile = dest;
 }
 
-static void rt_tile_mirror_and_flip(RendererTiles *rt, GdkPixbuf **tile, gint x, gint y, gint w, gint h)
+static void rt_tile_mirror_and_flip(RendererTiles *rt, GdkPixbuf **tile, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	GdkPixbuf *src = *tile;
 	GdkPixbuf *dest;
 	gint srs, drs;
 	guchar *s_pix, *d_pix;
-	guchar *sp, *dp;
-	guchar *dpi;
-	gint i, j;
+	guchar *spi, *dpi;
+	gint i;
 	gint tw = rt->tile_width * rt->hidpi_scale;
 	gint th = rt->tile_height * rt->hidpi_scale;
 
 	srs = gdk_pixbuf_get_rowstride(src);
 	s_pix = gdk_pixbuf_get_pixels(src);
+	spi = s_pix + (x * COLOR_BYTES);
 
-	dest = rt_get_spare_tile(rt);
+	dest = rt_get_spare_tile(rt, spare);
 	drs = gdk_pixbuf_get_rowstride(dest);
 	d_pix = gdk_pixbuf_get_pixels(dest);
-	dpi = d_pix + (th - 1) * drs + (tw - 1) * COLOR_BYTES;
+	dpi = d_pix + (th - 1) * drs + (tw - x - w) * COLOR_BYTES;
 
 	for (i = y; i < y + h; i++)
 		{
-		sp = s_pix + (i * srs) + (x * COLOR_BYTES);
-		dp = dpi - (i * drs) - (x * COLOR_BYTES);
-		for (j = 0; j < w; j++)
-			{
-			memcpy(dp, sp, COLOR_BYTES);
-			sp += COLOR_BYTES;
-			dp -= COLOR_BYTES;
-			}
+		pixbuf_mirror_row(spi + (i * srs), dpi - (i * drs), w, COLOR_BYTES);
 		}
 
-	rt->spare_tile = src;
+	*spare = src;
 	*tile = dest;
 }
 
-static void rt_tile_flip_only(RendererTiles *rt, GdkPixbuf **tile, gint x, gint y, gint w, gint h)
+static void rt_tile_flip_only(RendererTiles *rt, GdkPixbuf **tile, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	GdkPixbuf *src = *tile;
 	GdkPixbuf *dest;
@@ -1067,7 +1123,7 @@ static void rt_tile_flip_only(RendererTiles *rt, GdkPixbuf **tile, gint x, gint
 	s_pix = gdk_pixbuf_get_pixels(src);
 	spi = s_pix + (x * COLOR_BYTES);
 
-	dest = rt_get_spare_tile(rt);
+	dest = rt_get_spare_tile(rt, spare);
 	drs = gdk_pixbuf_get_rowstride(dest);
 	d_pix = gdk_pixbuf_get_pixels(dest);
 	dpi = d_pix + (th - 1) * drs + (x * COLOR_BYTES);
@@ -1079,11 +1135,11 @@ static void rt_tile_flip_only(RendererTiles *rt, GdkPixbuf **tile, gint x, gint
 		memcpy(dp, sp, w * COLOR_BYTES);
 		}
 
-	rt->spare_tile = src;
+	*spare = src;
 	*tile = dest;
 }
 
-static void rt_tile_apply_orientation(RendererTiles *rt, gint orientation, GdkPixbuf **pixbuf, gint x, gint y, gint w, gint h)
+static void rt_tile_apply_orientation(RendererTiles *rt, gint orientation, GdkPixbuf **pixbuf, GdkPixbuf **spare, gint x, gint y, gint w, gint h)
 {
 	switch (orientation)
 		{
@@ -1093,43 +1149,43 @@ static void rt_tile_apply_orientation(RendererTiles *rt, gint orientation, GdkPi
 		case EXIF_ORIENTATION_TOP_RIGHT:
 			/* mirrored */
 			{
-				rt_tile_mirror_only(rt, pixbuf, x, y, w, h);
+				rt_tile_mirror_only(rt, pixbuf, spare, x, y, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_BOTTOM_RIGHT:
 			/* upside down */
 			{
-				rt_tile_mirror_and_flip(rt, pixbuf, x, y, w, h);
+				rt_tile_mirror_and_flip(rt, pixbuf, spare, x, y, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_BOTTOM_LEFT:
 			/* flipped */
 			{
-				rt_tile_flip_only(rt, pixbuf, x, y, w, h);
+				rt_tile_flip_only(rt, pixbuf, spare, x, y, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_LEFT_TOP:
 			{
-				rt_tile_flip_only(rt, pixbuf, x, y, w, h);
-				rt_tile_rotate_90_clockwise(rt, pixbuf, x, rt->tile_height - y - h, w, h);
+				rt_tile_flip_only(rt, pixbuf, spare, x, y, w, h);
+				rt_tile_rotate_90_clockwise(rt, pixbuf, spare, x, rt->tile_height - y - h, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_RIGHT_TOP:
 			/* rotated -90 (270) */
 			{
-				rt_tile_rotate_90_clockwise(rt, pixbuf, x, y, w, h);
+				rt_tile_rotate_90_clockwise(rt, pixbuf, spare, x, y, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_RIGHT_BOTTOM:
 			{
-				rt_tile_flip_only(rt, pixbuf, x, y, w, h);
-				rt_tile_rotate_90_counter_clockwise(rt, pixbuf, x, rt->tile_height - y - h, w, h);
+				rt_tile_flip_only(rt, pixbuf, spare, x, y, w, h);
+				rt_tile_rotate_90_counter_clockwise(rt, pixbuf, spare, x, rt->tile_height - y - h, w, h);
 			}
 			break;
 		case EXIF_ORIENTATION_LEFT_BOTTOM:
 			/* rotated 90 */
 			{
-				rt_tile_rotate_90_counter_clockwise(rt, pixbuf, x, y, w, h);
+				rt_tile_rotate_90_counter_clockwise(rt, pixbuf, spare, x, y, w, h);
 			}
 			break;
 		default:
@@ -1317,12 +1373,98 @@ static gint rt_get_orientation(RendererTiles *rt)
 }
 
 
-static void rt_tile_render(RendererTiles *rt, ImageTile *it,
-			   gint x, gint y, gint w, gint h,
-			   gboolean new_data, gboolean fast)
+/*
+ *-------------------------------------------------------------------
+ * tile rendering
+ *
+ * The queued tiles are rendered in batches. The state of the tiles is
+ * updated and their surfaces are created on the main thread, then the
+ * pixels of all tiles of the batch are scaled and oriented in parallel by
+ * a pool of worker threads, the main thread helps and waits for them.
+ * Finally the pixels are post processed and copied to the surfaces and to
+ * the window on the main thread. The tiles of a batch are not freed
+ * meanwhile.
+ *-------------------------------------------------------------------
+ */
+
+#define RT_RENDER_BATCH_PER_THREAD 2	/* queued tiles taken for each thread */
+
+typedef struct _TileRenderJob TileRenderJob;
+struct _TileRenderJob
 {
-	PixbufRenderer *pr = rt->pr;
+	RendererTiles *rt;
+	ImageTile *it;
+	QueueData *qd;
+
+	/* area of the tile drawn to the window, if expose is set */
+	gboolean expose;
+	gint ex, ey, ew, eh;
+
+	/* area of the tile pixbuf copied to the surface, if draw is set */
+	gboolean draw;
+	gint x, y, w, h;
+
+	gboolean post_process;
+
+	/* the tile pixbuf is produced from src, pr->pixbuf or a level of its mipmaps, if scale is set */
+	gboolean scale;
+	GdkPixbuf *src;
 	gboolean has_alpha;
+	gboolean anaglyph;
+	gint orientation;
+	gint pb_x, pb_y, pb_w, pb_h;
+	gdouble offset_x, offset_y;
+	gdouble offset_x_left;
+	gdouble scale_x, scale_y;
+	GdkInterpType interp_type;
+
+	GdkPixbuf *spare;	/* used by the worker for orientation and anaglyph */
+};
+
+#ifdef HAVE_GTHREAD
+typedef struct _TileRenderBatch TileRenderBatch;
+struct _TileRenderBatch
+{
+	TileRenderJob *jobs;
+	gint count;
+	gint next;		/* atomic, next job to render */
+
+	GMutex mutex;
+	GCond cond;
+	gint running;		/* workers not done, protected by mutex */
+};
+
+static GThreadPool *rt_render_pool = NULL;
+#endif
+
+static gint rt_render_threads(void)
+{
+#ifdef HAVE_GTHREAD
+	static gint threads = 0;
+
+	/* get_cpu_cores() parses /proc/cpuinfo */
+	if (!threads) threads = MAX(get_cpu_cores(), 1);
+	return threads;
+#else
+	return 1;
+#endif
+}
+
+/* number of queued tiles rendered by one idle call */
+static gint rt_render_batch_size(void)
+{
+	gint threads = rt_render_threads();
+
+	return (threads > 1) ? threads * RT_RENDER_BATCH_PER_THREAD : 1;
+}
+
+/* main thread, updates the tile state and prepares the job */
+static void rt_tile_render_setup(RendererTiles *rt, TileRenderJob *job,
+				 gint x, gint y, gint w, gint h,
+				 gboolean new_data, gboolean fast)
+{
+	PixbufRenderer *pr = rt->pr;
+	ImageTile *it = job->it;
 	gboolean draw = FALSE;
 	gint orientation = rt_get_orientation(rt);
 
@@ -1347,7 +1489,6 @@ static void rt_tile_render(RendererTiles *rt, ImageTile *it,
 	if (new_data) it->blank = FALSE;
 
 	rt_tile_prepare(rt, it);
-	has_alpha = (pr->pixbuf && gdk_pixbuf_get_has_alpha(pr->pixbuf));
 
 	/* FIXME checker colors for alpha should be configurable,
 	 * also should be drawn for blank = TRUE
@@ -1417,94 +1558,274 @@ static void rt_tile_render(RendererTiles *rt, ImageTile *it,
 		 */
 		if (pr->width < PR_MIN_SCALE_SIZE || pr->height < PR_MIN_SCALE_SIZE) fast = TRUE;
 
-		rt_tile_get_region(has_alpha,
-				   pr->pixbuf, it->pixbuf, pb_x, pb_y, pb_w, pb_h,
-				   (gdouble) 0.0 - src_x - GET_RIGHT_PIXBUF_OFFSET(rt) * scale_x,
-				   (gdouble) 0.0 - src_y,
-				   scale_x, scale_y,
-				   (fast) ? GDK_INTERP_NEAREST : pr->zoom_quality,
-				   it->x + pb_x, it->y + pb_y);
-		if (rt->stereo_mode & PR_STEREO_ANAGLYPH &&
-		    (pr->stereo_pixbuf_offset_right > 0 || pr->stereo_pixbuf_offset_left > 0))
+		job->scale = TRUE;
+		job->has_alpha = (pr->pixbuf && gdk_pixbuf_get_has_alpha(pr->pixbuf));
+		job->anaglyph = (rt->stereo_mode & PR_STEREO_ANAGLYPH &&
+				 (pr->stereo_pixbuf_offset_right > 0 || pr->stereo_pixbuf_offset_left > 0));
+		job->orientation = orientation;
+		job->pb_x = pb_x;
+		job->pb_y = pb_y;
+		job->pb_w = pb_w;
+		job->pb_h = pb_h;
+		job->offset_x = (gdouble) 0.0 - src_x - GET_RIGHT_PIXBUF_OFFSET(rt) * scale_x;
+		job->offset_x_left = (gdouble) 0.0 - src_x - GET_LEFT_PIXBUF_OFFSET(rt) * scale_x;
+		job->offset_y = (gdouble) 0.0 - src_y;
+		job->scale_x = scale_x;
+		job->scale_y = scale_y;
+
+		/* zoomed out, scale from a downsampled copy when it is ready,
+		 * the offsets are in tile pixels and stay the same
+		 */
+		job->src = pr->pixbuf;
+		if (scale_x < 0.5 && scale_y < 0.5)
 			{
-			GdkPixbuf *right_pb = rt_get_spare_tile(rt);
-			rt_tile_get_region(has_alpha,
-					   pr->pixbuf, right_pb, pb_x, pb_y, pb_w, pb_h,
-					   (gdouble) 0.0 - src_x - GET_LEFT_PIXBUF_OFFSET(rt) * scale_x,
-					   (gdouble) 0.0 - src_y,
-					   scale_x, scale_y,
-					   (fast) ? GDK_INTERP_NEAREST : pr->zoom_quality,
-					   it->x + pb_x, it->y + pb_y);
-			pr_create_anaglyph(rt->stereo_mode, it->pixbuf, right_pb, pb_x, pb_y, pb_w, pb_h);
-			/* do not care about freeing spare_tile, it will be reused */
+			gdouble level_x, level_y;
+
+			if (!pr->loading) pixbuf_mipmap_request(pr->pixbuf);
+			job->src = pixbuf_mipmap_get_level(pr->pixbuf, scale_x, scale_y, &level_x, &level_y);
+			job->scale_x = scale_x * level_x;
+			job->scale_y = scale_y * level_y;
 			}
-		rt_tile_apply_orientation(rt, orientation, &it->pixbuf, pb_x, pb_y, pb_w, pb_h);
+
+		job->interp_type = (fast) ? GDK_INTERP_NEAREST : pr->zoom_quality;
 		draw = TRUE;
 		}
 
 	if (draw && it->pixbuf && !it->blank)
 		{
-		cairo_t *cr;
+		job->draw = TRUE;
+		job->x = x;
+		job->y = y;
+		job->w = w;
+		job->h = h;
+		job->post_process = (pr->func_post_process && !(pr->post_process_slow && fast));
+		}
+}
 
-		if (pr->func_post_process && !(pr->post_process_slow && fast))
-			pr->func_post_process(pr, &it->pixbuf, x, y, w, h, pr->post_process_user_data);
+/* any thread, produces the pixels of the tile pixbuf */
+static void rt_tile_render_pixels(TileRenderJob *job)
+{
+	RendererTiles *rt = job->rt;
+	ImageTile *it = job->it;
 
-		cr = cairo_create(it->surface);
-		cairo_rectangle (cr, x, y, w, h);
-		rt_hidpi_aware_draw(rt, cr, it->pixbuf, 0, 0);
-		cairo_destroy (cr);
+	if (job->scale)
+		{
+		rt_tile_get_region(job->has_alpha,
+				   job->src, it->pixbuf, job->pb_x, job->pb_y, job->pb_w, job->pb_h,
+				   job->offset_x, job->offset_y,
+				   job->scale_x, job->scale_y,
+				   job->interp_type,
+				   it->x + job->pb_x, it->y + job->pb_y);
+		if (job->anaglyph)
+			{
+			GdkPixbuf *right_pb = rt_get_spare_tile(rt, &job->spare);
+			rt_tile_get_region(job->has_alpha,
+					   job->src, right_pb, job->pb_x, job->pb_y, job->pb_w, job->pb_h,
+					   job->offset_x_left, job->offset_y,
+					   job->scale_x, job->scale_y,
+					   job->interp_type,
+					   it->x + job->pb_x, it->y + job->pb_y);
+			pr_create_anaglyph(rt->stereo_mode, it->pixbuf, right_pb, job->pb_x, job->pb_y, job->pb_w, job->pb_h);
+			/* do not care about freeing the spare tile, it will be reused */
+			}
+		rt_tile_apply_orientation(rt, job->orientation, &it->pixbuf, &job->spare,
+					  job->pb_x, job->pb_y, job->pb_w, job->pb_h);
 		}
 }
 
+#ifdef HAVE_GTHREAD
+static void rt_render_batch_run(TileRenderBatch *batch)
+{
+	gint i;
+
+	while ((i = g_atomic_int_add(&batch->next, 1)) < batch->count)
+		{
+		if (batch->jobs[i].draw) rt_tile_render_pixels(&batch->jobs[i]);
+		}
+}
+
+static void rt_render_thread_run(gpointer data, gpointer user_data)
+{
+	TileRenderBatch *batch = data;
+
+	rt_render_batch_run(batch);
+
+	g_mutex_lock(&batch->mutex);
+	batch->running--;
+	g_cond_signal(&batch->cond);
+	g_mutex_unlock(&batch->mutex);
+}
+#endif
+
+static void rt_render_jobs(TileRenderJob *jobs, gint count)
+{
+	gint pending = 0;
+	gint i;
+
+	for (i = 0; i < count; i++)
+		{
+		if (jobs[i].draw) pending++;
+		}
+
+#ifdef HAVE_GTHREAD
+	if (pending > 1 && rt_render_threads() > 1)
+		{
+		TileRenderBatch batch;
+		gint workers = MIN(pending, rt_render_threads()) - 1;
+
+		if (!rt_render_pool)
+			{
+			rt_render_pool = g_thread_pool_new(rt_render_thread_run, NULL, rt_render_threads() - 1, FALSE, NULL);
+			}
+
+		batch.jobs = jobs;
+		batch.count = count;
+		batch.next = 0;
+		batch.running = workers;
+		g_mutex_init(&batch.mutex);
+		g_cond_init(&batch.cond);
+
+		for (i = 0; i < workers; i++)
+			{
+			g_thread_pool_push(rt_render_pool, &batch, NULL);
+			}
+
+		/* the main thread renders too */
+		rt_render_batch_run(&batch);
+
+		g_mutex_lock(&batch.mutex);
+		while (batch.running > 0) g_cond_wait(&batch.cond, &batch.mutex);
+		g_mutex_unlock(&batch.mutex);
+
+		g_mutex_clear(&batch.mutex);
+		g_cond_clear(&batch.cond);
+		return;
+		}
+#endif
+
+	for (i = 0; i < count; i++)
+		{
+		if (jobs[i].draw) rt_tile_render_pixels(&jobs[i]);
+		}
+}
 
-static void rt_tile_expose(RendererTiles *rt, ImageTile *it,
-			   gint x, gint y, gint w, gint h,
-			   gboolean new_data, gboolean fast)
+/* clamps the area of the tile to the visible area, returns FALSE if empty */
+static gboolean rt_tile_expose_clamp(RendererTiles *rt, ImageTile *it,
+				     gint *x, gint *y, gint *w, gint *h)
 {
 	PixbufRenderer *pr = rt->pr;
-	GtkWidget *box;
-	GdkWindow *window;
-	cairo_t *cr;
 
-	/* clamp to visible */
-	if (it->x + x < rt->x_scroll)
+	if (it->x + *x < rt->x_scroll)
 		{
-		w -= rt->x_scroll - it->x - x;
-		x = rt->x_scroll - it->x;
+		*w -= rt->x_scroll - it->x - *x;
+		*x = rt->x_scroll - it->x;
 		}
-	if (it->x + x + w > rt->x_scroll + pr->vis_width)
+	if (it->x + *x + *w > rt->x_scroll + pr->vis_width)
 		{
-		w = rt->x_scroll + pr->vis_width - it->x - x;
+		*w = rt->x_scroll + pr->vis_width - it->x - *x;
 		}
-	if (w < 1) return;
-	if (it->y + y < rt->y_scroll)
+	if (*w < 1) return FALSE;
+	if (it->y + *y < rt->y_scroll)
 		{
-		h -= rt->y_scroll - it->y - y;
-		y = rt->y_scroll - it->y;
+		*h -= rt->y_scroll - it->y - *y;
+		*y = rt->y_scroll - it->y;
 		}
-	if (it->y + y + h > rt->y_scroll + pr->vis_height)
+	if (it->y + *y + *h > rt->y_scroll + pr->vis_height)
 		{
-		h = rt->y_scroll + pr->vis_height - it->y - y;
+		*h = rt->y_scroll + pr->vis_height - it->y - *y;
 		}
-	if (h < 1) return;
+	if (*h < 1) return FALSE;
 
-	rt_tile_render(rt, it, x, y, w, h, new_data, fast);
+	return TRUE;
+}
 
-	box = GTK_WIDGET(pr);
-	window = gtk_widget_get_window(box);
+static void rt_tile_render_take_spare(RendererTiles *rt, TileRenderJob *job)
+{
+	if (job->scale && rt->spare_tiles)
+		{
+		job->spare = rt->spare_tiles->data;
+		rt->spare_tiles = g_list_delete_link(rt->spare_tiles, rt->spare_tiles);
+		}
+}
 
-	cr = gdk_cairo_create(window);
-	cairo_set_source_surface(cr, it->surface, pr->x_offset + (it->x - rt->x_scroll) + rt->stereo_off_x, pr->y_offset + (it->y - rt->y_scroll) + rt->stereo_off_y);
-	cairo_rectangle (cr, pr->x_offset + (it->x - rt->x_scroll) + x + rt->stereo_off_x, pr->y_offset + (it->y - rt->y_scroll) + y + rt->stereo_off_y, w, h);
-	cairo_fill (cr);
-	cairo_destroy (cr);
+static void rt_tile_render_queued(RendererTiles *rt, TileRenderJob *job, gboolean fast)
+{
+	QueueData *qd = job->qd;
+	ImageTile *it = job->it;
 
-	if (rt->overlay_list)
+	if (rt_tile_is_visible(rt, it))
 		{
-		rt_overlay_draw(rt, pr->x_offset + (it->x - rt->x_scroll) + x,
-				pr->y_offset + (it->y - rt->y_scroll) + y,
-				w, h,
-				it);
+		job->ex = qd->x;
+		job->ey = qd->y;
+		job->ew = qd->w;
+		job->eh = qd->h;
+		job->expose = rt_tile_expose_clamp(rt, it, &job->ex, &job->ey, &job->ew, &job->eh);
+		if (job->expose) rt_tile_render_setup(rt, job, job->ex, job->ey, job->ew, job->eh, qd->new_data, fast);
+		}
+	else if (qd->new_data)
+		{
+		/* if new pixel data, and we already have a pixmap, update the tile */
+		it->blank = FALSE;
+		if (it->surface && it->render_done == TILE_RENDER_ALL)
+			{
+			rt_tile_render_setup(rt, job, qd->x, qd->y, qd->w, qd->h, qd->new_data, fast);
+			}
+		}
+
+	rt_tile_render_take_spare(rt, job);
+}
+
+/* main thread, copies the rendered pixels to the surface and the window */
+static void rt_tile_render_finish(RendererTiles *rt, TileRenderJob *job)
+{
+	PixbufRenderer *pr = rt->pr;
+	ImageTile *it = job->it;
+
+	if (job->spare) rt->spare_tiles = g_list_prepend(rt->spare_tiles, job->spare);
+	job->spare = NULL;
+
+	if (job->draw)
+		{
+		cairo_t *cr;
+
+		/* see pixbuf_renderer_set_post_process_func() */
+		if (job->post_process)
+			pr->func_post_process(pr, &it->pixbuf, job->x, job->y, job->w, job->h, pr->post_process_user_data);
+
+		cr = cairo_create(it->surface);
+		cairo_rectangle (cr, job->x, job->y, job->w, job->h);
+		rt_hidpi_aware_draw(rt, cr, it->pixbuf, 0, 0);
+		cairo_destroy (cr);
+		}
+
+	if (job->expose)
+		{
+		GtkWidget *box;
+		GdkWindow *window;
+		cairo_t *cr;
+
+		if (it->prefetched)
+			{
+			it->prefetched = FALSE;
+			rt->tile_prefetch_hits++;
+			}
+
+		box = GTK_WIDGET(pr);
+		window = gtk_widget_get_window(box);
+
+		cr = gdk_cairo_create(window);
+		cairo_set_source_surface(cr, it->surface, pr->x_offset + (it->x - rt->x_scroll) + rt->stereo_off_x, pr->y_offset + (it->y - rt->y_scroll) + rt->stereo_off_y);
+		cairo_rectangle (cr, pr->x_offset + (it->x - rt->x_scroll) + job->ex + rt->stereo_off_x, pr->y_offset + (it->y - rt->y_scroll) + job->ey + rt->stereo_off_y, job->ew, job->eh);
+		cairo_fill (cr);
+		cairo_destroy (cr);
+
+		if (rt->overlay_list)
+			{
+			rt_overlay_draw(rt, pr->x_offset + (it->x - rt->x_scroll) + job->ex,
+					pr->y_offset + (it->y - rt->y_scroll) + job->ey,
+					job->ew, job->eh,
+					it);
+			}
 		}
 }
 
@@ -1516,6 +1837,178 @@ static gboolean rt_tile_is_visible(RendererTiles *rt, ImageTile *it)
 		it->y + it->h >= rt->y_scroll && it->y < rt->y_scroll + pr->vis_height);
 }
 
+/*
+ *-------------------------------------------------------------------
+ * prefetch
+ *
+ * While scrolling, the tiles just outside the visible area in the
+ * direction of the motion are rendered when the draw queue is empty,
+ * so they can be shown at once when they scroll into view. They only
+ * use free space of the tile cache, and are dropped first when it
+ * is needed.
+ *-------------------------------------------------------------------
+ */
+
+#define RT_PREFETCH_MOTION_TIME 500000	/* us, scrolls further apart are a new motion */
+
+static void rt_prefetch_reset(RendererTiles *rt)
+{
+	if (rt->prefetch_idle_id)
+		{
+		g_source_remove(rt->prefetch_idle_id);
+		rt->prefetch_idle_id = 0;
+		}
+	rt->scroll_vx = 0.0;
+	rt->scroll_vy = 0.0;
+}
+
+static void rt_prefetch_motion(RendererTiles *rt, gint x_off, gint y_off)
+{
+	gint64 now = g_get_monotonic_time();
+
+	if (now - rt->scroll_time > RT_PREFETCH_MOTION_TIME)
+		{
+		rt->scroll_vx = x_off;
+		rt->scroll_vy = y_off;
+		}
+	else
+		{
+		rt->scroll_vx = (rt->scroll_vx + x_off) / 2.0;
+		rt->scroll_vy = (rt->scroll_vy + y_off) / 2.0;
+		}
+	rt->scroll_time = now;
+}
+
+static gboolean rt_prefetch_wanted(RendererTiles *rt)
+{
+	PixbufRenderer *pr = rt->pr;
+
+	return (pr->tile_prefetch > 0 && pr->pixbuf && !pr->source_tiles_enabled && !pr->loading &&
+		(rt->scroll_vx != 0.0 || rt->scroll_vy != 0.0) &&
+		!rt->draw_queue && !rt->draw_queue_2pass &&
+		gtk_widget_get_realized(GTK_WIDGET(pr)));
+}
+
+/* memory of a rendered tile, as counted by rt_tile_prepare() */
+static guint rt_prefetch_tile_size(RendererTiles *rt)
+{
+	return (rt->tile_width * rt->tile_height * 4 / 8 + rt->tile_width * 3 * rt->tile_height) *
+	       rt->hidpi_scale * rt->hidpi_scale;
+}
+
+/* adds the tiles to render next to jobs, nearest to the visible area first */
+static gint rt_prefetch_collect(RendererTiles *rt, TileRenderJob *jobs, gint max)
+{
+	PixbufRenderer *pr = rt->pr;
+	gint dx = 0;
+	gint dy = 0;
+	gint vx1, vx2, vy1, vy2;
+	guint space;
+	guint tile_max;
+	gint count = 0;
+	gint d;
+
+	/* a mostly horizontal or vertical motion prefetches in that direction only */
+	if (fabs(rt->scroll_vx) * 4.0 > fabs(rt->scroll_vy)) dx = (rt->scroll_vx > 0.0) ? 1 : -1;
+	if (fabs(rt->scroll_vy) * 4.0 > fabs(rt->scroll_vx)) dy = (rt->scroll_vy > 0.0) ? 1 : -1;
+
+	/* the visible tiles */
+	vx1 = ROUND_DOWN(rt->x_scroll, rt->tile_width);
+	vx2 = ROUND_DOWN(rt->x_scroll + pr->vis_width - 1, rt->tile_width);
+	vy1 = ROUND_DOWN(rt->y_scroll, rt->tile_height);
+	vy2 = ROUND_DOWN(rt->y_scroll + pr->vis_height - 1, rt->tile_height);
+
+	space = rt_prefetch_tile_size(rt);
+	tile_max = rt_tile_cache_limit(rt);
+
+	for (d = 1; d <= pr->tile_prefetch; d++)
+		{
+		gint ox = dx * d * rt->tile_width;
+		gint oy = dy * d * rt->tile_height;
+		gint i, j;
+
+		for (j = vy1 + oy; j <= vy2 + oy; j += rt->tile_height)
+			{
+			for (i = vx1 + ox; i <= vx2 + ox; i += rt->tile_width)
+				{
+				ImageTile *it;
+
+				if (i < 0 || j < 0 || i >= pr->width || j >= pr->height) continue;
+				if (i >= vx1 && i <= vx2 && j >= vy1 && j <= vy2) continue;
+
+				it = rt_tile_lookup(rt, i, j);
+				if (it && (it->render_done == TILE_RENDER_ALL || it->rendering || it->qd || it->qd2)) continue;
+
+				/* never make room for them */
+				if ((guint)rt->tile_cache_size + (count + 1) * space > tile_max) return count;
+
+				if (!it) it = rt_tile_add(rt, i, j);
+				it->prefetched = TRUE;
+				it->rendering = TRUE;
+
+				jobs[count].rt = rt;
+				jobs[count].it = it;
+				count++;
+				if (count >= max) return count;
+				}
+			}
+		}
+
+	return count;
+}
+
+static gboolean rt_prefetch_idle_cb(gpointer data)
+{
+	RendererTiles *rt = data;
+	TileRenderJob *jobs;
+	gint count;
+	gint i;
+
+	if (!rt_prefetch_wanted(rt))
+		{
+		rt->prefetch_idle_id = 0;
+		return FALSE;
+		}
+
+	jobs = g_new0(TileRenderJob, rt_render_batch_size());
+	count = rt_prefetch_collect(rt, jobs, rt_render_batch_size());
+
+	for (i = 0; i < count; i++)
+		{
+		rt_tile_render_setup(rt, &jobs[i], 0, 0, jobs[i].it->w, jobs[i].it->h, FALSE, FALSE);
+		rt_tile_render_take_spare(rt, &jobs[i]);
+		}
+
+	rt_render_jobs(jobs, count);
+
+	for (i = 0; i < count; i++)
+		{
+		rt_tile_render_finish(rt, &jobs[i]);
+		jobs[i].it->rendering = FALSE;
+		if (jobs[i].draw) rt->tile_prefetches++;
+		}
+
+	g_free(jobs);
+
+	if (count == 0)
+		{
+		rt->prefetch_idle_id = 0;
+		return FALSE;
+		}
+
+	return TRUE;
+}
+
+/* called when the draw queue is done */
+static void rt_prefetch_schedule(RendererTiles *rt)
+{
+	if (rt->prefetch_idle_id) return;
+	if (g_get_monotonic_time() - rt->scroll_time > RT_PREFETCH_MOTION_TIME) return;
+	if (!rt_prefetch_wanted(rt)) return;
+
+	rt->prefetch_idle_id = g_idle_add_full(G_PRIORITY_LOW, rt_prefetch_idle_cb, rt, NULL);
+}
+
 /*
  *-------------------------------------------------------------------
  * draw queue
@@ -1586,7 +2079,11 @@ static gboolean rt_queue_draw_idle_cb(gpointer data)
 {
 	RendererTiles *rt = data;
 	PixbufRenderer *pr = rt->pr;
-	QueueData *qd;
+	GList *work;
+	TileRenderJob *jobs;
+	gint count;
+	gint i;
+	gboolean first_pass;
 	gboolean fast;
 
 
@@ -1597,12 +2094,14 @@ static gboolean rt_queue_draw_idle_cb(gpointer data)
 		pr_render_complete_signal(pr);
 
 		rt->draw_idle_id = 0;
+		rt_prefetch_schedule(rt);
 		return FALSE;
 		}
 
 	if (rt->draw_queue)
 		{
-		qd = rt->draw_queue->data;
+		work = rt->draw_queue;
+		first_pass = TRUE;
 		fast = (pr->zoom_2pass && ((pr->zoom_quality != GDK_INTERP_NEAREST && pr->scale != 1.0) || pr->post_process_slow));
 		}
 	else
@@ -1614,61 +2113,85 @@ static gboolean rt_queue_draw_idle_cb(gpointer data)
 			return rt_queue_schedule_next_draw(rt, FALSE);
 			}
 
-		qd = rt->draw_queue_2pass->data;
+		work = rt->draw_queue_2pass;
+		first_pass = FALSE;
 		fast = FALSE;
 		}
 
+	/* take a batch from the head of the queue, the tiles are not freed until it is done */
+	jobs = g_new0(TileRenderJob, rt_render_batch_size());
+	count = 0;
+	while (work && count < rt_render_batch_size())
+		{
+		QueueData *qd = work->data;
+
+		jobs[count].rt = rt;
+		jobs[count].qd = qd;
+		jobs[count].it = qd->it;
+		qd->it->rendering = TRUE;
+		count++;
+		work = work->next;
+		}
+
 	if (gtk_widget_get_realized(GTK_WIDGET(pr)))
 		{
-		if (rt_tile_is_visible(rt, qd->it))
+		for (i = 0; i < count; i++)
 			{
-			rt_tile_expose(rt, qd->it, qd->x, qd->y, qd->w, qd->h, qd->new_data, fast);
+			rt_tile_render_queued(rt, &jobs[i], fast);
 			}
-		else if (qd->new_data)
+
+		rt_render_jobs(jobs, count);
+
+		for (i = 0; i < count; i++)
 			{
-			/* if new pixel data, and we already have a pixmap, update the tile */
-			qd->it->blank = FALSE;
-			if (qd->it->surface && qd->it->render_done == TILE_RENDER_ALL)
-				{
-				rt_tile_render(rt, qd->it, qd->x, qd->y, qd->w, qd->h, qd->new_data, fast);
-				}
+			rt_tile_render_finish(rt, &jobs[i]);
 			}
 		}
 
-	if (rt->draw_queue)
+	for (i = 0; i < count; i++)
 		{
-		qd->it->qd = NULL;
-		rt->draw_queue = g_list_remove(rt->draw_queue, qd);
-		if (fast)
+		QueueData *qd = jobs[i].qd;
+
+		qd->it->rendering = FALSE;
+
+		if (first_pass)
 			{
-			if (qd->it->qd2)
+			qd->it->qd = NULL;
+			rt->draw_queue = g_list_remove(rt->draw_queue, qd);
+			if (fast)
 				{
-				rt_queue_merge(qd->it->qd2, qd);
-				g_free(qd);
+				if (qd->it->qd2)
+					{
+					rt_queue_merge(qd->it->qd2, qd);
+					g_free(qd);
+					}
+				else
+					{
+					qd->it->qd2 = qd;
+					rt->draw_queue_2pass = g_list_append(rt->draw_queue_2pass, qd);
+					}
 				}
 			else
 				{
-				qd->it->qd2 = qd;
-				rt->draw_queue_2pass = g_list_append(rt->draw_queue_2pass, qd);
+				g_free(qd);
 				}
 			}
 		else
 			{
+			qd->it->qd2 = NULL;
+			rt->draw_queue_2pass = g_list_remove(rt->draw_queue_2pass, qd);
 			g_free(qd);
 			}
 		}
-	else
-		{
-		qd->it->qd2 = NULL;
-		rt->draw_queue_2pass = g_list_remove(rt->draw_queue_2pass, qd);
-		g_free(qd);
-		}
+
+	g_free(jobs);
 
 	if (!rt->draw_queue && !rt->draw_queue_2pass)
 		{
 		pr_render_complete_signal(pr);
 
 		rt->draw_idle_id = 0;
+		rt_prefetch_schedule(rt);
 		return FALSE;
 		}
 
@@ -1708,6 +2231,7 @@ static void rt_queue_clear(RendererTiles *rt)
 		g_source_remove(rt->draw_idle_id);
 		rt->draw_idle_id = 0;
 		}
+	rt_prefetch_reset(rt);
 	rt_sync_scroll(rt);
 }
 
@@ -1891,6 +2415,8 @@ static void rt_scroll(void *renderer, gint x_off, gint y_off)
 	if (rt->stereo_mode & PR_STEREO_MIRROR) x_off = -x_off;
 	if (rt->stereo_mode & PR_STEREO_FLIP) y_off = -y_off;
 
+	rt_prefetch_motion(rt, x_off, y_off);
+
 	gint w = pr->vis_width - abs(x_off);
 	gint h = pr->vis_height - abs(y_off);
 
@@ -2029,6 +2555,7 @@ static void renderer_update_zoom(void *renderer, gboolean lazy)
 	RendererTiles *rt = (RendererTiles *)renderer;
 	PixbufRenderer *pr = rt->pr;
 
+	rt_prefetch_reset(rt);
 	rt_tile_invalidate_all((RendererTiles *)renderer);
 	if (!lazy)
 		{
@@ -2091,7 +2618,8 @@ static void renderer_free(void *renderer)
 	RendererTiles *rt = (RendererTiles *)renderer;
 	rt_queue_clear(rt);
 	rt_tile_free_all(rt);
-	if (rt->spare_tile) g_object_unref(rt->spare_tile);
+	g_hash_table_destroy(rt->tile_table);
+	g_list_free_full(rt->spare_tiles, g_object_unref);
 	if (rt->overlay_buffer) g_object_unref(rt->overlay_buffer);
 	rt_overlay_list_clear(rt);
 	/* disconnect "hierarchy-changed" */
@@ -2179,7 +2707,8 @@ RendererFuncs *renderer_tiles_new(PixbufRenderer *pr)
 	rt->tile_width = PR_TILE_SIZE;
 	rt->tile_height = PR_TILE_SIZE;
 
-	rt->tiles = NULL;
+	g_queue_init(&rt->tiles);
+	rt->tile_table = g_hash_table_new(rt_tile_hash, rt_tile_equal);
 	rt->tile_cache_size = 0;
 
 	rt->tile_cache_max = PR_CACHE_SIZE_DEFAULT;
@@ -23,6 +23,7 @@
 #include "search.h"
 
 #include "cache.h"
+#include "cache-db.h"
 #include "collect.h"
 #include "collect-table.h"
 #include "dnd.h"
@@ -1748,22 +1749,7 @@ static void search_file_load_process(SearchData *sd, CacheData *cd)
 		if (options->thumbnails.enable_caching &&
 		    sd->img_loader && image_loader_get_fd(sd->img_loader))
 			{
-			gchar *base;
-			const gchar *path;
-			mode_t mode = 0755;
-
-			path = image_loader_get_fd(sd->img_loader)->path;
-			base = cache_get_location(CACHE_TYPE_SIM, path, FALSE, &mode);
-			if (recursive_mkdir_if_not_exists(base, mode))
-				{
-				g_free(cd->path);
-				cd->path = cache_get_location(CACHE_TYPE_SIM, path, TRUE, NULL);
-				if (cache_sim_data_save(cd))
-					{
-					filetime_set(cd->path, filetime(image_loader_get_fd(sd->img_loader)->path));
-					}
-				}
-			g_free(base);
+			cache_sim_db_save(image_loader_get_fd(sd->img_loader)->path, cd);
 			}
 		}
 
@@ -1788,16 +1774,9 @@ static gboolean search_file_do_extra(SearchData *sd, FileData *fd, gint *match,
 
 	if (!sd->img_cd)
 		{
-		gchar *cd_path;
-
 		new_data = TRUE;
 
-		cd_path = cache_find_location(CACHE_TYPE_SIM, fd->path);
-		if (cd_path && filetime(fd->path) == filetime(cd_path))
-			{
-			sd->img_cd = cache_sim_data_load(cd_path);
-			}
-		g_free(cd_path);
+		sd->img_cd = cache_sim_db_load(fd->path);
 		}
 
 	if (!sd->img_cd)
@@ -2552,14 +2531,7 @@ static void search_start(SearchData *sd)
 	    !sd->search_similarity_cd &&
 	    isfile(sd->search_similarity_path))
 		{
-		gchar *cd_path;
-
-		cd_path = cache_find_location(CACHE_TYPE_SIM, sd->search_similarity_path);
-		if (cd_path && filetime(sd->search_similarity_path) == filetime(cd_path))
-			{
-			sd->search_similarity_cd = cache_sim_data_load(cd_path);
-			}
-		g_free(cd_path);
+		sd->search_similarity_cd = cache_sim_db_load(sd->search_similarity_path);
 
 		if (!sd->search_similarity_cd || !sd->search_similarity_cd->similarity)
 			{
@@ -74,9 +74,19 @@ ImageSimilarityData *image_sim_new(void)
 
 void image_sim_free(ImageSimilarityData *sd)
 {
+	if (!sd) return;
+
+	g_free(sd->variants);
 	g_free(sd);
 }
 
+/* must be called when the grid of sd is modified after a comparison */
+void image_sim_changed(ImageSimilarityData *sd)
+{
+	g_free(sd->variants);
+	sd->variants = NULL;
+}
+
 static gint image_sim_channel_eq_sort_cb(gconstpointer a, gconstpointer b)
 {
 	gint *pa = (gpointer)a;
@@ -159,6 +169,8 @@ void image_sim_alternate_processing(ImageSimilarityData *sd)
 
 	if (!alternate_enabled) return;
 
+	image_sim_changed(sd);
+
 	image_sim_channel_norm(sd->avg_r, sizeof(sd->avg_r));
 	image_sim_channel_norm(sd->avg_g, sizeof(sd->avg_g));
 	image_sim_channel_norm(sd->avg_b, sizeof(sd->avg_b));
@@ -280,6 +292,7 @@ void image_sim_fill_data(ImageSimilarityData *sd, GdkPixbuf *pixbuf)
 		}
 
 	sd->filled = TRUE;
+	image_sim_changed(sd);
 }
 
 ImageSimilarityData *image_sim_new_from_pixbuf(GdkPixbuf *pixbuf)
@@ -329,30 +342,216 @@ static gdouble alternate_image_sim_compare_fast(ImageSimilarityData *a, ImageSim
 }
 #endif
 
-gdouble image_sim_compare_transfo(ImageSimilarityData *a, ImageSimilarityData *b, gchar transfo)
+/*
+ * The grids are compared row by row with the sum of absolute differences,
+ * using SSE2 or AVX2 when available. The 8 transformations are done by
+ * comparing with the transposed and/or mirrored grid of b, and by reading
+ * its rows in reverse order, so no index mapping is needed in the kernels.
+ *
+ * The kernels return -1 when the difference exceeds min, the result is
+ * the same as with an abort check after every column.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#  define IMAGE_SIM_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define IMAGE_SIM_AVX2 1
+#    include <immintrin.h>
+#  endif
+#endif
+
+#define IMAGE_SIM_MAX_DIFF (255.0 * 1024.0 * 3.0)
+
+#ifndef IMAGE_SIM_SSE2
+static gint image_sim_diff_rows_c(const ImageSimilarityData *a, const ImageSimilarityData *b, gboolean reverse, gdouble min)
 {
-	gint sim;
-	gint i1, i2, *i;
-	gint j1, j2, *j;
+	gint sim = 0;
+	gint row;
 
-	if (!a || !b || !a->filled || !b->filled) return 0.0;
+	for (row = 0; row < 32; row++)
+		{
+		gint pa = row * 32;
+		gint pb = (reverse ? 31 - row : row) * 32;
+		gint i;
 
-	sim = 0.0;
+		for (i = 0; i < 32; i++)
+			{
+			sim += abs(a->avg_r[pa + i] - b->avg_r[pb + i]);
+			sim += abs(a->avg_g[pa + i] - b->avg_g[pb + i]);
+			sim += abs(a->avg_b[pa + i] - b->avg_b[pb + i]);
+			}
 
-	if (transfo & 1) { i = &j2; j = &i2; } else { i = &i2; j = &j2; }
-	for (j1 = 0; j1 < 32; j1++)
+		if ((gdouble)sim / IMAGE_SIM_MAX_DIFF > min) return -1;
+		}
+
+	return sim;
+}
+#endif
+
+#ifdef IMAGE_SIM_SSE2
+static inline __m128i image_sim_sad_sse2(__m128i acc, const guint8 *a, const guint8 *b)
+{
+	acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)a),
+					      _mm_loadu_si128((const __m128i *)b)));
+	return _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + 16)),
+					       _mm_loadu_si128((const __m128i *)(b + 16))));
+}
+
+static gint image_sim_diff_rows_sse2(const ImageSimilarityData *a, const ImageSimilarityData *b, gboolean reverse, gdouble min)
+{
+	__m128i acc = _mm_setzero_si128();
+	gint sim = 0;
+	gint row;
+
+	for (row = 0; row < 32; row++)
+		{
+		gint pa = row * 32;
+		gint pb = (reverse ? 31 - row : row) * 32;
+
+		acc = image_sim_sad_sse2(acc, a->avg_r + pa, b->avg_r + pb);
+		acc = image_sim_sad_sse2(acc, a->avg_g + pa, b->avg_g + pb);
+		acc = image_sim_sad_sse2(acc, a->avg_b + pa, b->avg_b + pb);
+
+		sim = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+		if ((gdouble)sim / IMAGE_SIM_MAX_DIFF > min) return -1;
+		}
+
+	return sim;
+}
+#endif
+
+#ifdef IMAGE_SIM_AVX2
+__attribute__((target("avx2")))
+static gint image_sim_diff_rows_avx2(const ImageSimilarityData *a, const ImageSimilarityData *b, gboolean reverse, gdouble min)
+{
+	__m256i acc = _mm256_setzero_si256();
+	gint sim = 0;
+	gint row;
+
+	for (row = 0; row < 32; row++)
+		{
+		gint pa = row * 32;
+		gint pb = (reverse ? 31 - row : row) * 32;
+		__m128i sum;
+
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a->avg_r + pa)),
+							    _mm256_loadu_si256((const __m256i *)(b->avg_r + pb))));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a->avg_g + pa)),
+							    _mm256_loadu_si256((const __m256i *)(b->avg_g + pb))));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a->avg_b + pa)),
+							    _mm256_loadu_si256((const __m256i *)(b->avg_b + pb))));
+
+		sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		sim = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+		if ((gdouble)sim / IMAGE_SIM_MAX_DIFF > min) return -1;
+		}
+
+	return sim;
+}
+#endif
+
+static gint image_sim_diff_rows(const ImageSimilarityData *a, const ImageSimilarityData *b, gboolean reverse, gdouble min)
+{
+#ifdef IMAGE_SIM_AVX2
+	if (__builtin_cpu_supports("avx2")) return image_sim_diff_rows_avx2(a, b, reverse, min);
+#endif
+#ifdef IMAGE_SIM_SSE2
+	return image_sim_diff_rows_sse2(a, b, reverse, min);
+#else
+	return image_sim_diff_rows_c(a, b, reverse, min);
+#endif
+}
+
+/* the grids of an image needed for the transformations */
+struct _ImageSimilarityVariants
+{
+	ImageSimilarityData mirror;		/* columns reversed */
+	ImageSimilarityData transpose;
+	ImageSimilarityData transpose_mirror;
+};
+
+static void image_sim_mirror(ImageSimilarityData *dest, const ImageSimilarityData *src)
+{
+	gint row;
+	gint i;
+
+	for (row = 0; row < 1024; row += 32)
 		{
-		if (transfo & 2) *j = 31-j1; else *j = j1;
-		for (i1 = 0; i1 < 32; i1++)
+		for (i = 0; i < 32; i++)
 			{
-			if (transfo & 4) *i = 31-i1; else *i = i1;
-			sim += abs(a->avg_r[i1*32+j1] - b->avg_r[i2*32+j2]);
-			sim += abs(a->avg_g[i1*32+j1] - b->avg_g[i2*32+j2]);
-			sim += abs(a->avg_b[i1*32+j1] - b->avg_b[i2*32+j2]);
+			dest->avg_r[row + i] = src->avg_r[row + 31 - i];
+			dest->avg_g[row + i] = src->avg_g[row + 31 - i];
+			dest->avg_b[row + i] = src->avg_b[row + 31 - i];
 			}
 		}
+	dest->filled = TRUE;
+}
 
-	return 1.0 - ((gdouble)sim / (255.0 * 1024.0 * 3.0));
+static void image_sim_transpose(ImageSimilarityData *dest, const ImageSimilarityData *src)
+{
+	gint row;
+	gint i;
+
+	for (row = 0; row < 32; row++)
+		{
+		for (i = 0; i < 32; i++)
+			{
+			dest->avg_r[row * 32 + i] = src->avg_r[i * 32 + row];
+			dest->avg_g[row * 32 + i] = src->avg_g[i * 32 + row];
+			dest->avg_b[row * 32 + i] = src->avg_b[i * 32 + row];
+			}
+		}
+	dest->filled = TRUE;
+}
+
+/* returns the grid of b that is read row by row for transfo, see image_sim_compare_fast_transfo()
+ *
+ * The variants are built once per image and kept with it. The comparison threads
+ * of the duplicates search may build them at the same time, the first one is kept.
+ */
+static const ImageSimilarityData *image_sim_variants_get(ImageSimilarityData *b, gchar transfo)
+{
+	ImageSimilarityVariants *v;
+
+	if (!(transfo & 3)) return b;
+
+	v = g_atomic_pointer_get(&b->variants);
+	if (!v)
+		{
+		v = g_new0(ImageSimilarityVariants, 1);
+		image_sim_mirror(&v->mirror, b);
+		image_sim_transpose(&v->transpose, b);
+		image_sim_mirror(&v->transpose_mirror, &v->transpose);
+
+		if (!g_atomic_pointer_compare_and_exchange(&b->variants, NULL, v))
+			{
+			g_free(v);
+			v = g_atomic_pointer_get(&b->variants);
+			}
+		}
+
+	if (transfo & 1) return (transfo & 2) ? &v->transpose_mirror : &v->transpose;
+
+	return &v->mirror;
+}
+
+static gdouble image_sim_compare_variant(ImageSimilarityData *a, ImageSimilarityData *b, gdouble min, gchar transfo)
+{
+	gint sim;
+
+	sim = image_sim_diff_rows(a, image_sim_variants_get(b, transfo), (transfo & 4) != 0, min);
+	if (sim < 0) return 0.0;
+
+	return (1.0 - ((gdouble)sim / IMAGE_SIM_MAX_DIFF));
+}
+
+gdouble image_sim_compare_transfo(ImageSimilarityData *a, ImageSimilarityData *b, gchar transfo)
+{
+	if (!a || !b || !a->filled || !b->filled) return 0.0;
+
+	/* the difference can not exceed 1.0, this never aborts */
+	return image_sim_compare_variant(a, b, 1.0, transfo);
 }
 
 gdouble image_sim_compare(ImageSimilarityData *a, ImageSimilarityData *b)
@@ -362,9 +561,11 @@ gdouble image_sim_compare(ImageSimilarityData *a, ImageSimilarityData *b)
 	gint t;
 	gdouble score, max_score = 0;
 
+	if (!a || !b || !a->filled || !b->filled) return 0.0;
+
 	for(t = 0; t < max_t; t++)
 	{
-		score = image_sim_compare_transfo(a, b, t);
+		score = image_sim_compare_variant(a, b, 1.0, t);
 		if (score > max_score) max_score = score;
 	}
 	return max_score;
@@ -379,35 +580,13 @@ generate all possible isometric transformations
 */
 gdouble image_sim_compare_fast_transfo(ImageSimilarityData *a, ImageSimilarityData *b, gdouble min, gchar transfo)
 {
-	gint sim;
-	gint i1, i2, *i;
-	gint j1, j2, *j;
-
 #ifdef ALTERNATE_INCLUDE_COMPARE_CHANGE
 	if (alternate_enabled) return alternate_image_sim_compare_fast(a, b, min);
 #endif
 
 	if (!a || !b || !a->filled || !b->filled) return 0.0;
 
-	min = 1.0 - min;
-	sim = 0.0;
-
-	if (transfo & 1) { i = &j2; j = &i2; } else { i = &i2; j = &j2; }
-	for (j1 = 0; j1 < 32; j1++)
-		{
-		if (transfo & 2) *j = 31-j1; else *j = j1;
-		for (i1 = 0; i1 < 32; i1++)
-			{
-			if (transfo & 4) *i = 31-i1; else *i = i1;
-			sim += abs(a->avg_r[i1*32+j1] - b->avg_r[i2*32+j2]);
-			sim += abs(a->avg_g[i1*32+j1] - b->avg_g[i2*32+j2]);
-			sim += abs(a->avg_b[i1*32+j1] - b->avg_b[i2*32+j2]);
-			}
-		/* check for abort, if so return 0.0 */
-		if ((gdouble)sim / (255.0 * 1024.0 * 3.0) > min) return 0.0;
-		}
-
-	return (1.0 - ((gdouble)sim / (255.0 * 1024.0 * 3.0)) );
+	return image_sim_compare_variant(a, b, 1.0 - min, transfo);
 }
 
 /* this uses a cutoff point so that it can abort early when it gets to
@@ -420,11 +599,305 @@ gdouble image_sim_compare_fast(ImageSimilarityData *a, ImageSimilarityData *b, g
 	gint t;
 	gdouble score, max_score = 0;
 
+#ifdef ALTERNATE_INCLUDE_COMPARE_CHANGE
+	if (alternate_enabled) return alternate_image_sim_compare_fast(a, b, min);
+#endif
+
+	if (!a || !b || !a->filled || !b->filled) return 0.0;
+
 	for(t = 0; t < max_t; t++)
 	{
-		score = image_sim_compare_fast_transfo(a, b, min, t);
+		score = image_sim_compare_variant(a, b, 1.0 - min, t);
 		if (score > max_score) max_score = score;
 	}
 	return max_score;
 }
+
+/*
+ * Similarity index
+ *
+ * The key of an image is the sum of each 8 x 8 block of the grid, 4 x 4 blocks
+ * for each channel. The difference of the block sums is never larger than the
+ * sum of the differences within the blocks, so the distance of two keys is a
+ * lower bound of the difference computed by image_sim_compare_fast(). The blocks
+ * are mapped onto each other by the 8 transformations, the same bound holds for
+ * the transformed keys.
+ *
+ * The keys are stored in a vantage point tree, a search for all keys within
+ * the maximum difference returns a superset of the images that can match.
+ */
+
+#define IMAGE_SIM_KEY_SIZE (4 * 4 * 3)
+#define IMAGE_SIM_INDEX_LEAF_SIZE 16
+
+typedef struct _ImageSimilarityIndexNode ImageSimilarityIndexNode;
+struct _ImageSimilarityIndexNode
+{
+	gint start;		/* range in index->items, the vantage point is the first */
+	gint end;
+	gint mu;		/* median distance to the vantage point, 0 for a leaf */
+	gint inner;		/* node with distance <= mu, -1 if none */
+	gint outer;		/* node with distance >= mu, -1 if none */
+};
+
+struct _ImageSimilarityIndex
+{
+	gint count;
+	guint16 *keys;		/* IMAGE_SIM_KEY_SIZE for each position */
+
+	gint *items;		/* positions of filled data, in tree order */
+	gint item_count;
+
+	ImageSimilarityIndexNode *nodes;
+	gint node_count;
+};
+
+typedef struct _ImageSimilarityIndexDist ImageSimilarityIndexDist;
+struct _ImageSimilarityIndexDist
+{
+	gint dist;
+	gint item;
+};
+
+static void image_sim_key(guint16 *key, const ImageSimilarityData *sd)
+{
+	gint i;
+	gint x;
+	gint y;
+
+	memset(key, 0, sizeof(guint16) * IMAGE_SIM_KEY_SIZE);
+
+	for (y = 0; y < 32; y++)
+		{
+		for (x = 0; x < 32; x++)
+			{
+			i = y * 32 + x;
+			key[(y / 8) * 4 + x / 8] += sd->avg_r[i];
+			key[16 + (y / 8) * 4 + x / 8] += sd->avg_g[i];
+			key[32 + (y / 8) * 4 + x / 8] += sd->avg_b[i];
+			}
+		}
+}
+
+/* same mapping as image_sim_compare_fast_transfo(), on the 4 x 4 blocks */
+static void image_sim_key_transfo(guint16 *dest, const guint16 *key, gchar transfo)
+{
+	gint i1, i2, *i;
+	gint j1, j2, *j;
+	gint c;
+
+	if (transfo & 1) { i = &j2; j = &i2; } else { i = &i2; j = &j2; }
+	for (j1 = 0; j1 < 4; j1++)
+		{
+		if (transfo & 2) *j = 3-j1; else *j = j1;
+		for (i1 = 0; i1 < 4; i1++)
+			{
+			if (transfo & 4) *i = 3-i1; else *i = i1;
+			for (c = 0; c < IMAGE_SIM_KEY_SIZE; c += 16)
+				{
+				dest[c + i1*4+j1] = key[c + i2*4+j2];
+				}
+			}
+		}
+}
+
+static gint image_sim_key_distance(const guint16 *a, const guint16 *b)
+{
+	gint dist = 0;
+	gint i;
+
+	for (i = 0; i < IMAGE_SIM_KEY_SIZE; i++)
+		{
+		dist += abs((gint)a[i] - (gint)b[i]);
+		}
+
+	return dist;
+}
+
+static gint image_sim_index_dist_sort_cb(gconstpointer a, gconstpointer b)
+{
+	const ImageSimilarityIndexDist *da = a;
+	const ImageSimilarityIndexDist *db = b;
+
+	if (da->dist < db->dist) return -1;
+	if (da->dist > db->dist) return 1;
+	return da->item - db->item;
+}
+
+static gint image_sim_index_build(ImageSimilarityIndex *index, ImageSimilarityIndexDist *dist, gint start, gint end)
+{
+	ImageSimilarityIndexNode *node;
+	gint n;
+	gint i;
+	gint mid;
+	const guint16 *vp_key;
+
+	if (start >= end) return -1;
+
+	n = index->node_count++;
+	node = &index->nodes[n];
+	node->start = start;
+	node->end = end;
+	node->mu = 0;
+	node->inner = -1;
+	node->outer = -1;
+
+	if (end - start <= IMAGE_SIM_INDEX_LEAF_SIZE) return n;
+
+	vp_key = index->keys + index->items[start] * IMAGE_SIM_KEY_SIZE;
+	for (i = start + 1; i < end; i++)
+		{
+		dist[i].item = index->items[i];
+		dist[i].dist = image_sim_key_distance(vp_key, index->keys + dist[i].item * IMAGE_SIM_KEY_SIZE);
+		}
+	qsort(dist + start + 1, end - start - 1, sizeof(ImageSimilarityIndexDist), image_sim_index_dist_sort_cb);
+
+	for (i = start + 1; i < end; i++)
+		{
+		index->items[i] = dist[i].item;
+		}
+
+	mid = start + 1 + (end - start - 1) / 2;
+	node->mu = dist[mid].dist;
+
+	/* node may move when the children are added */
+	i = image_sim_index_build(index, dist, start + 1, mid);
+	index->nodes[n].inner = i;
+	i = image_sim_index_build(index, dist, mid, end);
+	index->nodes[n].outer = i;
+
+	return n;
+}
+
+/* data may contain NULL or not filled entries, they are never found */
+ImageSimilarityIndex *image_sim_index_new(ImageSimilarityData **data, gint count)
+{
+	ImageSimilarityIndex *index;
+	ImageSimilarityIndexDist *dist;
+	gint i;
+
+	index = g_new0(ImageSimilarityIndex, 1);
+	index->count = count;
+	index->keys = g_new(guint16, (gsize)count * IMAGE_SIM_KEY_SIZE + 1);
+	index->items = g_new(gint, count + 1);
+
+	for (i = 0; i < count; i++)
+		{
+		if (!data[i] || !data[i]->filled) continue;
+
+		image_sim_key(index->keys + i * IMAGE_SIM_KEY_SIZE, data[i]);
+		index->items[index->item_count++] = i;
+		}
+
+	index->nodes = g_new(ImageSimilarityIndexNode, index->item_count + 1);
+	dist = g_new(ImageSimilarityIndexDist, index->item_count + 1);
+	image_sim_index_build(index, dist, 0, index->item_count);
+	g_free(dist);
+
+	return index;
+}
+
+void image_sim_index_free(ImageSimilarityIndex *index)
+{
+	if (!index) return;
+
+	g_free(index->keys);
+	g_free(index->items);
+	g_free(index->nodes);
+	g_free(index);
+}
+
+static void image_sim_index_search(ImageSimilarityIndex *index, gint n, const guint16 *key, gint radius, GArray *found)
+{
+	while (n >= 0)
+		{
+		ImageSimilarityIndexNode *node = &index->nodes[n];
+		gint dist;
+		gint i;
+
+		if (node->inner < 0 && node->outer < 0)
+			{
+			for (i = node->start; i < node->end; i++)
+				{
+				if (image_sim_key_distance(key, index->keys + index->items[i] * IMAGE_SIM_KEY_SIZE) <= radius)
+					{
+					g_array_append_val(found, index->items[i]);
+					}
+				}
+			return;
+			}
+
+		dist = image_sim_key_distance(key, index->keys + index->items[node->start] * IMAGE_SIM_KEY_SIZE);
+		if (dist <= radius) g_array_append_val(found, index->items[node->start]);
+
+		if (dist - radius <= node->mu && dist + radius >= node->mu)
+			{
+			image_sim_index_search(index, node->inner, key, radius, found);
+			n = node->outer;
+			}
+		else if (dist - radius <= node->mu)
+			{
+			n = node->inner;
+			}
+		else
+			{
+			n = node->outer;
+			}
+		}
+}
+
+static gint image_sim_index_found_sort_cb(gconstpointer a, gconstpointer b)
+{
+	return *(const gint *)a - *(const gint *)b;
+}
+
+/* sets found to the sorted positions of all data that can be at least
+ * min similar to sd with image_sim_compare_fast(), and maybe some more
+ */
+void image_sim_index_find(ImageSimilarityIndex *index, ImageSimilarityData *sd, gdouble min, GArray *found)
+{
+	guint16 key[IMAGE_SIM_KEY_SIZE];
+	guint16 key_t[IMAGE_SIM_KEY_SIZE];
+	gint max_t = (options->rot_invariant_sim ? 8 : 1);
+	gint radius;
+	gint t;
+	guint i;
+	guint n;
+
+	g_array_set_size(found, 0);
+
+	if (min <= 0.0
+#ifdef ALTERNATE_INCLUDE_COMPARE_CHANGE
+	    || alternate_enabled
+#endif
+	    )
+		{
+		/* everything matches, or the bound does not apply */
+		for (t = 0; t < index->count; t++) g_array_append_val(found, t);
+		return;
+		}
+
+	if (!sd || !sd->filled || index->item_count == 0) return;
+
+	/* the compare aborts when the difference exceeds this, rounded up */
+	radius = (gint)((1.0 - min) * IMAGE_SIM_MAX_DIFF) + 1;
+
+	image_sim_key(key, sd);
+	for (t = 0; t < max_t; t++)
+		{
+		image_sim_key_transfo(key_t, key, t);
+		image_sim_index_search(index, 0, key_t, radius, found);
+		}
+
+	g_array_sort(found, image_sim_index_found_sort_cb);
+
+	/* remove the positions found by more than one transformation */
+	n = 0;
+	for (i = 0; i < found->len; i++)
+		{
+		if (n > 0 && g_array_index(found, gint, i) == g_array_index(found, gint, n - 1)) continue;
+		g_array_index(found, gint, n++) = g_array_index(found, gint, i);
+		}
+	g_array_set_size(found, n);
+}
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -23,6 +23,8 @@
 #define SIMILAR_H
 
 
+typedef struct _ImageSimilarityVariants ImageSimilarityVariants;
+
 typedef struct _ImageSimilarityData ImageSimilarityData;
 struct _ImageSimilarityData
 {
@@ -31,11 +33,14 @@ struct _ImageSimilarityData
 	guint8 avg_b[1024];
 
 	gboolean filled;
+
+	ImageSimilarityVariants *variants;	/* transformed grids, built on first use */
 };
 
 
 ImageSimilarityData *image_sim_new(void);
 void image_sim_free(ImageSimilarityData *sd);
+void image_sim_changed(ImageSimilarityData *sd);
 
 void image_sim_fill_data(ImageSimilarityData *sd, GdkPixbuf *pixbuf);
 ImageSimilarityData *image_sim_new_from_pixbuf(GdkPixbuf *pixbuf);
@@ -44,6 +49,14 @@ gdouble image_sim_compare(ImageSimilarityData *a, ImageSimilarityData *b);
 gdouble image_sim_compare_fast(ImageSimilarityData *a, ImageSimilarityData *b, gdouble min);
 
 
+/* index over similarity data, to compare only the candidates of a query */
+typedef struct _ImageSimilarityIndex ImageSimilarityIndex;
+
+ImageSimilarityIndex *image_sim_index_new(ImageSimilarityData **data, gint count);
+void image_sim_index_free(ImageSimilarityIndex *index);
+void image_sim_index_find(ImageSimilarityIndex *index, ImageSimilarityData *sd, gdouble min, GArray *found);
+
+
 void image_sim_alternate_set(gboolean enable);
 gboolean image_sim_alternate_enabled(void);
 void image_sim_alternate_processing(ImageSimilarityData *sd);
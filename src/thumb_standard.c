@@ -167,6 +167,41 @@ static gchar *thumb_std_cache_path(const gchar *path, const gchar *uri, gboolean
 	return result;
 }
 
+/* quick test used before rendering: TRUE if a thumbnail of the requested size
+ * exists and was written after the source was last modified; the thumbnail
+ * is not decoded, so its embedded URI and MTime are not validated
+ */
+gboolean thumb_std_thumb_file_is_current(const gchar *source, gint width, gint height, gboolean local)
+{
+	gchar *pathl;
+	gchar *uri;
+	gchar *thumb_path;
+	struct stat st_source;
+	struct stat st_thumb;
+	gboolean current = FALSE;
+
+	if (!source || !stat_utf8(source, &st_source)) return FALSE;
+
+	pathl = path_from_utf8(source);
+	uri = g_filename_to_uri(pathl, NULL, NULL);
+	g_free(pathl);
+	if (!uri) return FALSE;
+
+	thumb_path = thumb_std_cache_path(source, (local) ? filename_from_path(uri) : uri, local,
+					  (width > THUMB_SIZE_NORMAL || height > THUMB_SIZE_NORMAL) ?
+					  THUMB_FOLDER_LARGE : THUMB_FOLDER_NORMAL);
+
+	if (thumb_path && stat_utf8(thumb_path, &st_thumb))
+		{
+		current = (st_thumb.st_size > 0 && st_thumb.st_mtime >= st_source.st_mtime);
+		}
+
+	g_free(thumb_path);
+	g_free(uri);
+
+	return current;
+}
+
 static gchar *thumb_loader_std_cache_path(ThumbLoaderStd *tl, gboolean local, GdkPixbuf *pixbuf, gboolean fail)
 {
 	const gchar *folder;
@@ -278,11 +313,118 @@ static gboolean thumb_loader_std_validate(ThumbLoaderStd *tl, GdkPixbuf *pixbuf)
 	return TRUE;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ * thumbnail saving (write behind)
+ *-----------------------------------------------------------------------------
+ */
+
+/* encoding and writing the png is done by a background thread,
+ * the thumbnail is shown without waiting for the disk
+ */
+
+typedef struct _ThumbStdSave ThumbStdSave;
+struct _ThumbStdSave
+{
+	GdkPixbuf *pixbuf;
+	gchar *thumb_path;
+	gchar *mark_uri;
+	gchar *mark_mtime;
+	mode_t mode;
+	gint compression;
+};
+
+#ifdef HAVE_GTHREAD
+static GThreadPool *thumb_std_save_pool = NULL;
+#endif
+
+static void thumb_std_save_write(ThumbStdSave *ts)
+{
+	gchar *tmp_path;
+	gboolean success = FALSE;
+
+	/* save thumb, using a temp file then renaming into place */
+	tmp_path = unique_filename(ts->thumb_path, ".tmp", "_", 2);
+	if (tmp_path)
+		{
+		gchar *mark_app;
+		gchar *compression;
+		gchar *pathl;
+
+		mark_app = g_strdup_printf("%s %s", GQ_APPNAME, VERSION);
+		compression = g_strdup_printf("%d", ts->compression);
+		pathl = path_from_utf8(tmp_path);
+		success = gdk_pixbuf_save(ts->pixbuf, pathl, "png", NULL,
+					  THUMB_MARKER_URI, ts->mark_uri,
+					  THUMB_MARKER_MTIME, ts->mark_mtime,
+					  THUMB_MARKER_APP, mark_app,
+					  "compression", compression,
+					  NULL);
+		if (success)
+			{
+			chmod(pathl, ts->mode);
+			success = rename_file(tmp_path, ts->thumb_path);
+			}
+
+		g_free(pathl);
+
+		g_free(compression);
+		g_free(mark_app);
+
+		g_free(tmp_path);
+		}
+
+	if (!success)
+		{
+		DEBUG_1("thumb save failed: %s", ts->thumb_path);
+		}
+
+	g_object_unref(G_OBJECT(ts->pixbuf));
+	g_free(ts->thumb_path);
+	g_free(ts->mark_uri);
+	g_free(ts->mark_mtime);
+	g_free(ts);
+}
+
+#ifdef HAVE_GTHREAD
+static void thumb_std_save_thread_cb(gpointer data, gpointer user_data)
+{
+	thumb_std_save_write(data);
+}
+#endif
+
+static void thumb_std_save_push(ThumbStdSave *ts)
+{
+#ifdef HAVE_GTHREAD
+	if (!thumb_std_save_pool)
+		{
+		thumb_std_save_pool = g_thread_pool_new(thumb_std_save_thread_cb, NULL, 1, FALSE, NULL);
+		}
+	if (thumb_std_save_pool)
+		{
+		g_thread_pool_push(thumb_std_save_pool, ts, NULL);
+		return;
+		}
+#endif
+	thumb_std_save_write(ts);
+}
+
+/* waits until all queued thumbnails are written */
+void thumb_std_save_flush(void)
+{
+#ifdef HAVE_GTHREAD
+	if (!thumb_std_save_pool) return;
+
+	g_thread_pool_free(thumb_std_save_pool, FALSE, TRUE);
+	thumb_std_save_pool = NULL;
+#endif
+}
+
 static void thumb_loader_std_save(ThumbLoaderStd *tl, GdkPixbuf *pixbuf)
 {
 	gchar *base_path;
-	gchar *tmp_path;
 	gboolean fail;
+	ThumbStdSave *ts;
 
 	if (!tl->cache_enable || tl->cache_hit) return;
 	if (tl->thumb_path) return;
@@ -335,47 +477,15 @@ static void thumb_loader_std_save(ThumbLoaderStd *tl, GdkPixbuf *pixbuf)
 	DEBUG_1("thumb saving: %s", tl->fd->path);
 	DEBUG_1("       saved: %s", tl->thumb_path);
 
-	/* save thumb, using a temp file then renaming into place */
-	tmp_path = unique_filename(tl->thumb_path, ".tmp", "_", 2);
-	if (tmp_path)
-		{
-		const gchar *mark_uri;
-		gchar *mark_app;
-		gchar *mark_mtime;
-		gchar *pathl;
-		gboolean success;
-
-		mark_uri = (tl->cache_local) ? tl->local_uri :tl->thumb_uri;
-
-		mark_app = g_strdup_printf("%s %s", GQ_APPNAME, VERSION);
-		mark_mtime = g_strdup_printf("%llu", (unsigned long long)tl->source_mtime);
-		pathl = path_from_utf8(tmp_path);
-		success = gdk_pixbuf_save(pixbuf, pathl, "png", NULL,
-					  THUMB_MARKER_URI, mark_uri,
-					  THUMB_MARKER_MTIME, mark_mtime,
-					  THUMB_MARKER_APP, mark_app,
-					  NULL);
-		if (success)
-			{
-			chmod(pathl, (tl->cache_local) ? tl->source_mode : THUMB_PERMS_THUMB);
-			success = rename_file(tmp_path, tl->thumb_path);
-			}
-
-		g_free(pathl);
-
-		g_free(mark_mtime);
-		g_free(mark_app);
-
-		g_free(tmp_path);
-		if (!success)
-			{
-			DEBUG_1("thumb save failed: %s", tl->fd->path);
-			DEBUG_1("            thumb: %s", tl->thumb_path);
-			}
-
-		}
+	ts = g_new0(ThumbStdSave, 1);
+	ts->pixbuf = pixbuf;
+	ts->thumb_path = g_strdup(tl->thumb_path);
+	ts->mark_uri = g_strdup((tl->cache_local) ? tl->local_uri : tl->thumb_uri);
+	ts->mark_mtime = g_strdup_printf("%llu", (unsigned long long)tl->source_mtime);
+	ts->mode = (tl->cache_local) ? tl->source_mode : THUMB_PERMS_THUMB;
+	ts->compression = options->thumbnails.png_compression;
 
-	g_object_unref(G_OBJECT(pixbuf));
+	thumb_std_save_push(ts);
 }
 
 static void thumb_loader_std_set_fallback(ThumbLoaderStd *tl)
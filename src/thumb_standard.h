@@ -96,6 +96,9 @@ ThumbLoaderStd *thumb_loader_std_thumb_file_validate(const gchar *thumb_path, gi
 void thumb_loader_std_thumb_file_validate_cancel(ThumbLoaderStd *tl);
 
 
+void thumb_std_save_flush(void);
+gboolean thumb_std_thumb_file_is_current(const gchar *source, gint width, gint height, gboolean local);
+
 void thumb_std_maint_removed(const gchar *source);
 void thumb_std_maint_moved(const gchar *source, const gchar *dest);
 
@@ -306,7 +306,9 @@ typedef struct _CollectWindow CollectWindow;
 typedef struct _ImageWindow ImageWindow;
 
 typedef struct _FileData FileData;
+typedef struct _FileListReader FileListReader;
 typedef struct _FileDataChangeInfo FileDataChangeInfo;
+typedef struct _MetadataPrefetch MetadataPrefetch;
 
 typedef struct _LayoutWindow LayoutWindow;
 typedef struct _LayoutOptions LayoutOptions;
@@ -329,6 +331,7 @@ typedef struct _HistMap HistMap;
 typedef struct _SecureSaveInfo SecureSaveInfo;
 
 typedef struct _ExifData ExifData;
+typedef struct _ExifCompact ExifCompact;
 
 typedef struct _EditorDescription EditorDescription;
 
@@ -554,6 +557,7 @@ struct _ImageWindow
 
 	FileData *read_ahead_fd;
 	ImageLoader *read_ahead_il;
+	GList *read_ahead_window; /* ImageReadAhead, further images decoded in parallel */
 
 	gint prev_color_row;
 
@@ -593,6 +597,8 @@ struct _FileData {
 	time_t date;
 	time_t cdate;
 	mode_t mode; /* this is needed at least for notification in view_dir because it is preserved after the file/directory is deleted */
+	uid_t uid;
+	gid_t gid;
 	gint sidecar_priority;
 
 	guint marks; /* each bit represents one mark */
@@ -618,6 +624,7 @@ struct _FileData {
 	gint exif_orientation;
 
 	ExifData *exif;
+	ExifCompact *exif_compact; /* decoded tags kept after exif is released */
 	time_t exifdate;
 	time_t exifdate_digitized;
 	GHashTable *modified_xmp; // hash table which contains unwritten xmp metadata in format: key->list of string values
@@ -924,8 +931,10 @@ struct _ViewFile
 
 	/* thumbs updates*/
 	gboolean thumbs_running;
-	ThumbLoader *thumbs_loader;
-	FileData *thumbs_filedata;
+	GList *thumbs_loaders; /* ThumbLoader, in flight */
+	GHashTable *thumbs_loading; /* FileData -> ThumbLoader */
+	GList *thumbs_batch; /* FileData with new thumbs, not yet shown */
+	guint thumbs_batch_id; /* event source id */
 
 	/* marks */
 	gboolean marks_enabled;
@@ -935,11 +944,16 @@ struct _ViewFile
 	/* refresh */
 	guint refresh_idle_id; /* event source id */
 	time_t time_refresh_set; /* time when refresh_idle_id was set */
+	FileListReader *refresh_reader; /* reading dir_fd in the background */
+	GList *refresh_list; /* files read by refresh_reader, for the next refresh */
+	time_t refresh_dir_mtime; /* of dir_fd when refresh_reader started */
+	gboolean refresh_snapshot; /* the next refresh may show the folder snapshot */
+	time_t refresh_snapshot_mtime; /* of the snapshot shown while refresh_reader runs, 0 if none */
 
 	/* file list for edit menu */
 	GList *editmenu_fd_list;
 
-	guint read_metadata_in_idle_id;
+	MetadataPrefetch *read_metadata; /* reading the metadata used for sorting */
 };
 
 struct _ViewFileInfoList
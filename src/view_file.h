@@ -69,11 +69,14 @@ void vf_mark_to_selection(ViewFile *vf, gint mark, MarkToSelectionMode mode);
 void vf_selection_to_mark(ViewFile *vf, gint mark, SelectionToMarkMode mode);
 
 void vf_refresh_idle_cancel(ViewFile *vf);
+void vf_refresh_read_cancel(ViewFile *vf);
+gboolean vf_refresh_read(ViewFile *vf, GList **files);
 void vf_notify_cb(FileData *fd, NotifyType type, gpointer data);
 
 void vf_thumb_update(ViewFile *vf);
 void vf_thumb_cleanup(ViewFile *vf);
 void vf_thumb_stop(ViewFile *vf);
+gboolean vf_thumb_is_loading(ViewFile *vf, FileData *fd);
 void vf_read_metadata_in_idle(ViewFile *vf);
 void vf_file_filter_set(ViewFile *vf, gboolean enable);
 GRegex *vf_file_filter_get_filter(ViewFile *vf);
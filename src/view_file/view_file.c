@@ -26,8 +26,10 @@
 #include "collect-table.h"
 #include "editors.h"
 #include "history_list.h"
+#include "image-load.h"
 #include "layout.h"
 #include "menu.h"
+#include "metadata-prefetch.h"
 #include "pixbuf_util.h"
 #include "thumb.h"
 #include "ui_menu.h"
@@ -715,6 +717,12 @@ gboolean vf_refresh(ViewFile *vf)
 
 gboolean vf_set_fd(ViewFile *vf, FileData *dir_fd)
 {
+	if (dir_fd != vf->dir_fd)
+		{
+		vf_refresh_read_cancel(vf);
+		vf->refresh_snapshot = TRUE;
+		}
+
 	switch (vf->type)
 	{
 	case FILEVIEW_LIST: return vflist_set_fd(vf, dir_fd);
@@ -739,10 +747,8 @@ static void vf_destroy_cb(GtkWidget *widget, gpointer data)
 		gtk_widget_destroy(vf->popup);
 		}
 
-	if (vf->read_metadata_in_idle_id)
-		{
-		g_idle_remove_by_data(vf);
-		}
+	metadata_prefetch_stop(vf->read_metadata);
+	vf_refresh_read_cancel(vf);
 	file_data_unref(vf->dir_fd);
 	g_free(vf->info);
 	g_free(vf);
@@ -1146,7 +1152,6 @@ ViewFile *vf_new(FileViewType type, FileData *dir_fd)
 	vf->type = type;
 	vf->sort_method = SORT_NAME;
 	vf->sort_ascend = TRUE;
-	vf->read_metadata_in_idle_id = 0;
 
 	vf->scrolled = gtk_scrolled_window_new(NULL, NULL);
 	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(vf->scrolled), GTK_SHADOW_IN);
@@ -1227,19 +1232,6 @@ static gdouble vf_thumb_progress(ViewFile *vf)
 	return (gdouble)done / count;
 }
 
-static gdouble vf_read_metadata_in_idle_progress(ViewFile *vf)
-{
-	gint count = 0;
-	gint done = 0;
-
-	switch (vf->type)
-		{
-		case FILEVIEW_LIST: vflist_read_metadata_progress_count(vf->list, &count, &done); break;
-		case FILEVIEW_ICON: vficon_read_metadata_progress_count(vf->list, &count, &done); break;
-		}
-
-	return (gdouble)done / count;
-}
 
 static void vf_set_thumb_fd(ViewFile *vf, FileData *fd)
 {
@@ -1258,12 +1250,67 @@ static void vf_thumb_status(ViewFile *vf, gdouble val, const gchar *text)
 		}
 }
 
+/* finished thumbnails are handed to the view in batches,
+ * this also limits how often the progress has to be counted
+ */
+#define VF_THUMB_BATCH_DELAY 50 /* ms */
+
+static void vf_thumb_flush(ViewFile *vf)
+{
+	GList *work;
+
+	if (vf->thumbs_batch_id)
+		{
+		g_source_remove(vf->thumbs_batch_id);
+		vf->thumbs_batch_id = 0;
+		}
+
+	if (!vf->thumbs_batch) return;
+
+	vf->thumbs_batch = g_list_reverse(vf->thumbs_batch);
+	for (work = vf->thumbs_batch; work; work = work->next)
+		{
+		vf_set_thumb_fd(vf, work->data);
+		}
+	filelist_free(vf->thumbs_batch);
+	vf->thumbs_batch = NULL;
+
+	if (vf->thumbs_running) vf_thumb_status(vf, vf_thumb_progress(vf), _("Loading thumbs..."));
+}
+
+static gboolean vf_thumb_flush_cb(gpointer data)
+{
+	ViewFile *vf = data;
+
+	vf->thumbs_batch_id = 0;
+	vf_thumb_flush(vf);
+
+	return FALSE;
+}
+
 static void vf_thumb_do(ViewFile *vf, FileData *fd)
 {
 	if (!fd) return;
 
-	vf_set_thumb_fd(vf, fd);
-	vf_thumb_status(vf, vf_thumb_progress(vf), _("Loading thumbs..."));
+	vf->thumbs_batch = g_list_prepend(vf->thumbs_batch, file_data_ref(fd));
+	if (!vf->thumbs_batch_id) vf->thumbs_batch_id = g_timeout_add(VF_THUMB_BATCH_DELAY, vf_thumb_flush_cb, vf);
+}
+
+static void vf_thumb_loaders_free(ViewFile *vf)
+{
+	GList *work;
+
+	if (!vf->thumbs_loading) return;
+
+	for (work = vf->thumbs_loaders; work; work = work->next)
+		{
+		thumb_loader_free(work->data);
+		}
+	g_list_free(vf->thumbs_loaders);
+	vf->thumbs_loaders = NULL;
+
+	g_hash_table_destroy(vf->thumbs_loading);
+	vf->thumbs_loading = NULL;
 }
 
 void vf_thumb_cleanup(ViewFile *vf)
@@ -1272,10 +1319,15 @@ void vf_thumb_cleanup(ViewFile *vf)
 
 	vf->thumbs_running = FALSE;
 
-	thumb_loader_free(vf->thumbs_loader);
-	vf->thumbs_loader = NULL;
+	vf_thumb_loaders_free(vf);
 
-	vf->thumbs_filedata = NULL;
+	if (vf->thumbs_batch_id)
+		{
+		g_source_remove(vf->thumbs_batch_id);
+		vf->thumbs_batch_id = 0;
+		}
+	filelist_free(vf->thumbs_batch);
+	vf->thumbs_batch = NULL;
 }
 
 void vf_thumb_stop(ViewFile *vf)
@@ -1283,15 +1335,39 @@ void vf_thumb_stop(ViewFile *vf)
 	if (vf->thumbs_running) vf_thumb_cleanup(vf);
 }
 
-static void vf_thumb_common_cb(ThumbLoader *tl, gpointer data)
+gboolean vf_thumb_is_loading(ViewFile *vf, FileData *fd)
 {
-	ViewFile *vf = data;
+	return vf->thumbs_loading && g_hash_table_lookup(vf->thumbs_loading, fd);
+}
 
-	if (vf->thumbs_filedata && vf->thumbs_loader == tl)
+static void vf_thumb_loader_finish(ViewFile *vf, ThumbLoader *tl)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init(&iter, vf->thumbs_loading);
+	while (g_hash_table_iter_next(&iter, &key, &value))
 		{
-		vf_thumb_do(vf, vf->thumbs_filedata);
+		if (value == tl)
+			{
+			vf_thumb_do(vf, key);
+			g_hash_table_iter_remove(&iter);
+			break;
+			}
 		}
 
+	vf->thumbs_loaders = g_list_remove(vf->thumbs_loaders, tl);
+	thumb_loader_free(tl);
+}
+
+static void vf_thumb_common_cb(ThumbLoader *tl, gpointer data)
+{
+	ViewFile *vf = data;
+
+	if (!vf->thumbs_loading || !g_list_find(vf->thumbs_loaders, tl)) return;
+
+	vf_thumb_loader_finish(vf, tl);
+
 	while (vf_thumb_next(vf));
 }
 
@@ -1305,9 +1381,19 @@ static void vf_thumb_done_cb(ThumbLoader *tl, gpointer data)
 	vf_thumb_common_cb(tl, data);
 }
 
+/* number of thumbnails loaded at the same time, enough to keep
+ * all image loader threads busy while finished ones are delivered
+ */
+static guint vf_thumb_loaders_max(void)
+{
+	return 2 * image_loader_get_thread_count();
+}
+
+/* starts the next thumbnail, returns TRUE if another one can be started now */
 static gboolean vf_thumb_next(ViewFile *vf)
 {
 	FileData *fd = NULL;
+	ThumbLoader *tl;
 
 	if (!gtk_widget_get_realized(vf->listview))
 		{
@@ -1315,6 +1401,9 @@ static gboolean vf_thumb_next(ViewFile *vf)
 		return FALSE;
 		}
 
+	if (g_list_length(vf->thumbs_loaders) >= vf_thumb_loaders_max()) return FALSE;
+
+	/* visible files first, see the view implementations */
 	switch (vf->type)
 	{
 	case FILEVIEW_LIST: fd = vflist_thumb_next_fd(vf); break;
@@ -1323,32 +1412,35 @@ static gboolean vf_thumb_next(ViewFile *vf)
 
 	if (!fd)
 		{
-		/* done */
-		vf_thumb_cleanup(vf);
+		if (!vf->thumbs_loaders)
+			{
+			/* done */
+			vf_thumb_flush(vf);
+			vf_thumb_cleanup(vf);
+			}
 		return FALSE;
 		}
 
-	vf->thumbs_filedata = fd;
+	if (!vf->thumbs_loading) vf->thumbs_loading = g_hash_table_new(g_direct_hash, g_direct_equal);
 
-	thumb_loader_free(vf->thumbs_loader);
-
-	vf->thumbs_loader = thumb_loader_new(options->thumbnails.max_width, options->thumbnails.max_height);
-	thumb_loader_set_callbacks(vf->thumbs_loader,
+	tl = thumb_loader_new(options->thumbnails.max_width, options->thumbnails.max_height);
+	thumb_loader_set_callbacks(tl,
 				   vf_thumb_done_cb,
 				   vf_thumb_error_cb,
 				   NULL,
 				   vf);
 
-	if (!thumb_loader_start(vf->thumbs_loader, fd))
+	vf->thumbs_loaders = g_list_prepend(vf->thumbs_loaders, tl);
+	g_hash_table_insert(vf->thumbs_loading, fd, tl);
+
+	if (!thumb_loader_start(tl, fd))
 		{
 		/* set icon to unknown, continue */
 		DEBUG_1("thumb loader start failed %s", fd->path);
-		vf_thumb_do(vf, fd);
-
-		return TRUE;
+		vf_thumb_loader_finish(vf, tl);
 		}
 
-	return FALSE;
+	return TRUE;
 }
 
 static void vf_thumb_reset_all(ViewFile *vf)
@@ -1499,15 +1591,105 @@ void vf_set_layout(ViewFile *vf, LayoutWindow *layout)
  *-----------------------------------------------------------------------------
  */
 
-static gboolean vf_refresh_idle_cb(gpointer data)
+static void vf_refresh_read_done_cb(FileListReader *fr, gboolean success, GList *files, GList *dirs, gpointer data)
 {
 	ViewFile *vf = data;
 
+	vf->refresh_reader = NULL;
+
+	filelist_free(vf->refresh_list);
+	vf->refresh_list = files;
+
 	vf_refresh(vf);
+}
+
+static time_t vf_refresh_dir_mtime(ViewFile *vf)
+{
+	struct stat st;
+
+	if (!options->cache_dir_lists || !stat_utf8(vf->dir_fd->path, &st)) return 0;
+
+	return st.st_mtime;
+}
+
+static gboolean vf_refresh_idle_cb(gpointer data)
+{
+	ViewFile *vf = data;
+
+	if (vf->refresh_reader)
+		{
+		/* the running read will refresh */
+		}
+	else if (vf->dir_fd)
+		{
+		/* large folders on network file systems take long to read, keep the view usable meanwhile */
+		vf->refresh_dir_mtime = vf_refresh_dir_mtime(vf);
+		vf->refresh_reader = filelist_read_async(vf->dir_fd, TRUE, FALSE, vf_refresh_read_done_cb, vf);
+		if (!vf->refresh_reader) vf_refresh(vf);
+		}
+	else
+		{
+		vf_refresh(vf);
+		}
 	vf->refresh_idle_id = 0;
 	return FALSE;
 }
 
+void vf_refresh_read_cancel(ViewFile *vf)
+{
+	filelist_read_async_cancel(vf->refresh_reader);
+	vf->refresh_reader = NULL;
+
+	filelist_free(vf->refresh_list);
+	vf->refresh_list = NULL;
+	vf->refresh_snapshot_mtime = 0;
+}
+
+/* reads the files of vf->dir_fd for a refresh, or takes the ones read in the background,
+ * a folder just entered is shown from its snapshot and read again in the background
+ */
+gboolean vf_refresh_read(ViewFile *vf, GList **files)
+{
+	gboolean snapshot = vf->refresh_snapshot;
+	time_t dir_mtime;
+
+	vf->refresh_snapshot = FALSE;
+
+	if (vf->refresh_list)
+		{
+		*files = vf->refresh_list;
+		vf->refresh_list = NULL;
+		/* the files are stat'ed now, the exif dates of the unchanged ones can be trusted */
+		if (vf->refresh_snapshot_mtime) filelist_apply_snapshot(vf->dir_fd, vf->refresh_snapshot_mtime, *files);
+		vf->refresh_snapshot_mtime = 0;
+		if (vf->refresh_dir_mtime) cache_dir_list_save(vf->dir_fd->path, vf->refresh_dir_mtime, *files);
+		return TRUE;
+		}
+
+	dir_mtime = vf_refresh_dir_mtime(vf);
+	if (!dir_mtime) return filelist_read(vf->dir_fd, files, NULL);
+
+	if (snapshot && !vf->refresh_reader && filelist_read_snapshot(vf->dir_fd, dir_mtime, files))
+		{
+		/* the differences are notified when the background read is done */
+		vf->refresh_dir_mtime = dir_mtime;
+		vf->refresh_reader = filelist_read_async(vf->dir_fd, TRUE, FALSE, vf_refresh_read_done_cb, vf);
+		if (vf->refresh_reader)
+			{
+			vf->refresh_snapshot_mtime = dir_mtime;
+			return TRUE;
+			}
+
+		filelist_free(*files);
+		*files = NULL;
+		}
+
+	if (!filelist_read(vf->dir_fd, files, NULL)) return FALSE;
+
+	cache_dir_list_save(vf->dir_fd->path, dir_mtime, *files);
+	return TRUE;
+}
+
 void vf_refresh_idle_cancel(ViewFile *vf)
 {
 	if (vf->refresh_idle_id)
@@ -1544,7 +1726,7 @@ void vf_notify_cb(FileData *fd, NotifyType type, gpointer data)
 	if (vf->marks_enabled) interested |= NOTIFY_MARKS | NOTIFY_METADATA;
 	/* FIXME: NOTIFY_METADATA should be checked by the keyword-to-mark functions and converted to NOTIFY_MARKS only if there was a change */
 
-	if (!(type & interested) || vf->refresh_idle_id || !vf->dir_fd) return;
+	if (!(type & interested) || vf->refresh_idle_id || vf->refresh_reader || !vf->dir_fd) return;
 
 	refresh = (fd == vf->dir_fd);
 
@@ -1579,74 +1761,33 @@ void vf_notify_cb(FileData *fd, NotifyType type, gpointer data)
 		}
 }
 
-static gboolean vf_read_metadata_in_idle_cb(gpointer data)
+static void vf_read_metadata_in_idle_cb(MetadataPrefetch *mp, gboolean done, gpointer data)
 {
-	FileData *fd;
 	ViewFile *vf = data;
-	GList *list_entry;
-	GList *work;
-
-	vf_thumb_status(vf, vf_read_metadata_in_idle_progress(vf), _("Loading meta..."));
 
-	work = vf->list;
-
-	while (work)
+	if (!done)
 		{
-		fd = work->data;
-
-		if (fd && !fd->metadata_in_idle_loaded)
-			{
-			if (!fd->exifdate)
-				{
-				read_exif_time_data(fd);
-				}
-			if (!fd->exifdate_digitized)
-				{
-				read_exif_time_digitized_data(fd);
-				}
-			if (fd->rating == STAR_RATING_NOT_READ)
-				{
-				read_rating_data(fd);
-				}
-			fd->metadata_in_idle_loaded = TRUE;
-			return TRUE;
-			}
-		work = work->next;
+		vf_thumb_status(vf, metadata_prefetch_get_progress(mp), _("Loading meta..."));
+		return;
 		}
 
 	vf_thumb_status(vf, 0.0, NULL);
-	vf->read_metadata_in_idle_id = 0;
+	vf->read_metadata = NULL;
 	vf_refresh(vf);
-	return FALSE;
-}
-
-static void vf_read_metadata_in_idle_finished_cb(gpointer data)
-{
-	ViewFile *vf = data;
-
-	vf_thumb_status(vf, 0.0, "Loading meta...");
-	vf->read_metadata_in_idle_id = 0;
 }
 
 void vf_read_metadata_in_idle(ViewFile *vf)
 {
-	GList *work;
-	FileData *fd;
-
 	if (!vf) return;
 
-	if (vf->read_metadata_in_idle_id)
-		{
-		g_idle_remove_by_data(vf);
-		}
-	vf->read_metadata_in_idle_id = 0;
+	metadata_prefetch_stop(vf->read_metadata);
+	vf->read_metadata = NULL;
 
 	if (vf->list)
 		{
-		vf->read_metadata_in_idle_id = g_idle_add_full(G_PRIORITY_LOW, vf_read_metadata_in_idle_cb, vf, vf_read_metadata_in_idle_finished_cb);
+		vf_thumb_status(vf, 0.0, _("Loading meta..."));
+		vf->read_metadata = metadata_prefetch_start(vf->list, vf_read_metadata_in_idle_cb, vf);
 		}
-
-	return;
 }
 
 /* vim: set shiftwidth=8 softtabstop=0 cindent cinoptions={1s: */
@@ -1727,19 +1727,6 @@ void vficon_thumb_progress_count(GList *list, gint *count, gint *done)
 		}
 }
 
-void vficon_read_metadata_progress_count(GList *list, gint *count, gint *done)
-{
-	GList *work = list;
-	while (work)
-		{
-		FileData *fd = work->data;
-		work = work->next;
-
-		if (fd->metadata_in_idle_loaded) (*done)++;
-		(*count)++;
-		}
-}
-
 void vficon_set_thumb_fd(ViewFile *vf, FileData *fd)
 {
 	GtkTreeModel *store;
@@ -1781,7 +1768,7 @@ FileData *vficon_thumb_next_fd(ViewFile *vf)
 			for (; list; list = list->next)
 				{
 				FileData *fd = list->data;
-				if (fd && !fd->thumb_pixbuf) return fd;
+				if (fd && !fd->thumb_pixbuf && !vf_thumb_is_loading(vf, fd)) return fd;
 				}
 
 			valid = gtk_tree_model_iter_next(store, &iter);
@@ -1796,7 +1783,7 @@ FileData *vficon_thumb_next_fd(ViewFile *vf)
 
 		// Note: This implementation differs from view_file_list.c because sidecar files are not
 		// distinct list elements here, as they are in the list view.
-		if (!fd->thumb_pixbuf) return fd;
+		if (!fd->thumb_pixbuf && !vf_thumb_is_loading(vf, fd)) return fd;
 		}
 
 	return NULL;
@@ -1846,7 +1833,7 @@ static gboolean vficon_refresh_real(ViewFile *vf, gboolean keep_position)
 
 	if (vf->dir_fd)
 		{
-		ret = filelist_read(vf->dir_fd, &new_filelist, NULL);
+		ret = vf_refresh_read(vf, &new_filelist);
 		new_filelist = file_data_filter_marks_list(new_filelist, vf_marks_get_filter(vf));
 		new_filelist = g_list_first(new_filelist);
 		new_filelist = file_data_filter_file_filter_list(new_filelist, vf_file_filter_get_filter(vf));
@@ -1173,24 +1173,6 @@ void vflist_thumb_progress_count(GList *list, gint *count, gint *done)
 		}
 }
 
-void vflist_read_metadata_progress_count(GList *list, gint *count, gint *done)
-{
-	GList *work = list;
-	while (work)
-		{
-		FileData *fd = work->data;
-		work = work->next;
-
-		if (fd->metadata_in_idle_loaded) (*done)++;
-
-		if (fd->sidecar_files)
-			{
-			vflist_read_metadata_progress_count(fd->sidecar_files, count, done);
-			}
-		(*count)++;
-		}
-}
-
 void vflist_set_thumb_fd(ViewFile *vf, FileData *fd)
 {
 	GtkTreeStore *store;
@@ -1226,7 +1208,7 @@ FileData *vflist_thumb_next_fd(ViewFile *vf)
 
 			gtk_tree_model_get(store, &iter, FILE_COLUMN_POINTER, &nfd, -1);
 
-			if (!nfd->thumb_pixbuf) fd = nfd;
+			if (!nfd->thumb_pixbuf && !vf_thumb_is_loading(vf, nfd)) fd = nfd;
 
 			valid = gtk_tree_model_iter_next(store, &iter);
 			}
@@ -1240,7 +1222,7 @@ FileData *vflist_thumb_next_fd(ViewFile *vf)
 		while (work && !fd)
 			{
 			FileData *fd_p = work->data;
-			if (!fd_p->thumb_pixbuf)
+			if (!fd_p->thumb_pixbuf && !vf_thumb_is_loading(vf, fd_p))
 				fd = fd_p;
 			else
 				{
@@ -1249,7 +1231,7 @@ FileData *vflist_thumb_next_fd(ViewFile *vf)
 				while (work2 && !fd)
 					{
 					fd_p = work2->data;
-					if (!fd_p->thumb_pixbuf) fd = fd_p;
+					if (!fd_p->thumb_pixbuf && !vf_thumb_is_loading(vf, fd_p)) fd = fd_p;
 					work2 = work2->next;
 					}
 				}
@@ -1791,7 +1773,7 @@ gboolean vflist_refresh(ViewFile *vf)
 		{
 		file_data_unregister_notify_func(vf_notify_cb, vf); /* we don't need the notification of changes detected by filelist_read */
 
-		ret = filelist_read(vf->dir_fd, &vf->list, NULL);
+		ret = vf_refresh_read(vf, &vf->list);
 
 		if (vf->marks_enabled)
 		        {